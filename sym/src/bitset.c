@@ -0,0 +1,144 @@
+/*-------------------------------------------------------------------*
+ *  bitset.c
+ *
+ *  Fixed-size sets of bits, used to represent a set's elements as
+ *  positions within some larger set.  Comparisons work a word at
+ *  a time.  Bits beyond nbits are always kept clear so that whole
+ *  words can be compared directly.
+ *-------------------------------------------------------------------*/
+
+#include "bitset.h"
+
+#include "error.h"
+#include "xmalloc.h"
+#include <stdio.h>
+#include <string.h>
+
+#define OBJ_bitset 1317
+
+typedef unsigned long Word;
+
+#define WORDBITS  ( 8*(int)sizeof(Word) )
+#define NWORDS(n) ( ((n)+WORDBITS-1)/WORDBITS )
+
+struct bitset
+   {
+   int obj;
+   int nbits;
+   int nwords;
+   Word *w;
+   };
+
+//
+//  Private methods
+//
+
+static void checkbit( Bitset *bits, int i, char *where )
+{
+   validate( bits, OBJ_bitset, where );
+   if( i < 0 || i >= bits->nbits )
+      FAULT("Bit index out of range");
+}
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  newbitset
+ *
+ *  Create an empty set able to hold bits 0 to nbits-1.
+ *-------------------------------------------------------------------*/
+Bitset *newbitset( int nbits )
+{
+   Bitset *new;
+
+   if( nbits < 0 )
+      FAULT("Negative size passed to newbitset");
+
+   new = (Bitset *) xmalloc( sizeof(Bitset) );
+   new->obj    = OBJ_bitset;
+   new->nbits  = nbits;
+   new->nwords = NWORDS(nbits);
+   new->w      = (Word *) xmalloc( (new->nwords+1)*sizeof(Word) );
+   memset( new->w, 0, (new->nwords+1)*sizeof(Word) );
+
+   return new;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  freebitset
+ *-------------------------------------------------------------------*/
+Bitset *freebitset( Bitset *bits )
+{
+   if( bits == 0 )return 0;
+   validate( bits, OBJ_bitset, "freebitset" );
+   xfree( bits->w );
+   xfree( bits );
+   return 0;
+}
+
+
+void putbit( Bitset *bits, int i )
+{
+   checkbit( bits, i, "putbit" );
+   bits->w[i/WORDBITS] |= (Word) 1 << (i%WORDBITS);
+}
+
+
+void clearbit( Bitset *bits, int i )
+{
+   checkbit( bits, i, "clearbit" );
+   bits->w[i/WORDBITS] &= ~( (Word) 1 << (i%WORDBITS) );
+}
+
+
+int getbit( Bitset *bits, int i )
+{
+   checkbit( bits, i, "getbit" );
+   return ( bits->w[i/WORDBITS] >> (i%WORDBITS) ) & 1;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  fillbitset
+ *
+ *  Turn on every bit.
+ *-------------------------------------------------------------------*/
+void fillbitset( Bitset *bits )
+{
+   int i,extra;
+
+   validate( bits, OBJ_bitset, "fillbitset" );
+
+   for( i=0 ; i < bits->nwords ; i++ )
+      bits->w[i] = ~(Word) 0;
+
+   extra = bits->nwords*WORDBITS - bits->nbits;
+   if( extra )
+      bits->w[bits->nwords-1] >>= extra;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  subbitset
+ *
+ *  Return 1 if every bit in 'small' is also in 'large'.  The sets
+ *  must be the same size.
+ *-------------------------------------------------------------------*/
+int subbitset( Bitset *small, Bitset *large )
+{
+   int i;
+
+   validate( small, OBJ_bitset, "subbitset" );
+   validate( large, OBJ_bitset, "subbitset" );
+
+   if( small->nbits != large->nbits )
+      FAULT("Bitsets of different sizes passed to subbitset");
+
+   for( i=0 ; i < small->nwords ; i++ )
+      if( small->w[i] & ~large->w[i] )return 0;
+
+   return 1;
+}
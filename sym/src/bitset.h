@@ -0,0 +1,23 @@
+/* bitset.h
+ *
+ * Header file for fixed-size sets of bits.
+ */
+
+#ifndef BITSET_H
+#define BITSET_H
+
+typedef struct bitset Bitset;
+
+//
+//  Function prototypes
+//
+
+Bitset* newbitset(int nbits);
+Bitset* freebitset(Bitset* bits);
+void    putbit(Bitset* bits, int i);
+void    clearbit(Bitset* bits, int i);
+int     getbit(Bitset* bits, int i);
+void    fillbitset(Bitset* bits);
+int     subbitset(Bitset* small, Bitset* large);
+
+#endif /* BITSET_H */
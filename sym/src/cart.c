@@ -2,26 +2,32 @@
  *  cart.c
  *  Dec 04 (PJW)
  *
- *  Convenience routines for generating and then walking through a
- *  Cartesian product of a list of sets.  
+ *  Convenience routines for walking through a Cartesian product of
+ *  a list of sets.  
  *
- *  The public functions are cart_build, which causes the internal
- *  table of tuples to be built; and cart_first and cart_next, 
- *  do exactly what one would expect.  The functions should be 
- *  used as follows:
+ *  A product is walked with an iterator, which behaves like an 
+ *  odometer over the positions of the elements in each set: the 
+ *  last set varies fastest.  An iterator needs memory only for its
+ *  position in each set, however large the product, and any number
+ *  can be in use at once.  The functions should be used as follows:
  *
- *     List *cur;
+ *     Cart *c;
  *     List *sets;
  *     
- *     cart_build(sets);
- *     for( cur=cart_first() ; cur ; cur=cart_next() )
+ *     c = cart_open(sets);
+ *     while( cart_step(c) )
  *        {
- *        ...
+ *        ... cart_subs(c), cart_sub(c,i) or cart_index(c,i) ...
  *        }
+ *     c = cart_close(c);
  *
- *  Everything else is handled internally via static buffers.
- *  Because static buffers are used, only one Cartesian product
- *  can be generated at a time.
+ *  cart_subs returns a list of the current subscripts that is 
+ *  updated in place as the iterator moves, so it remains valid only
+ *  until the next call to cart_step.
+ *
+ *  The older interface, cart_build, cart_first and cart_next, is
+ *  kept for existing callers.  It uses a single internal iterator
+ *  so only one product can be walked that way at a time.
  *  
  *  $Id: cart.c 57 2018-06-16 19:50:13Z wilcoxen $
  *-------------------------------------------------------------------*/
@@ -38,187 +44,236 @@
 
 #define  myDEBUG 1
 
-#define SUBTOBJ 2005
+#define CARTOBJ 2005
 
 //
-//  Internal objects used to keep track of what we're doing
+//  Iterator state.  'sets' holds the element list of each set, 
+//  which belongs to the set table and is not copied.
 //
 
-struct tuple {
+struct cart_iter {
    int obj;
-   List *subs;
-   struct tuple *next;
+   int dims;
+   List **sets;
+   int *pos;
+   List *subs;       // current subscripts, refreshed on demand
+   int stale;        // subs does not match pos
+   int state;        // 0 = not started, 1 = on a tuple, 2 = finished
    };
 
-static struct tuple *head=0;
-static struct tuple *last=0;
-static struct tuple *next=0;
-
-static void gen_sublist(List*,List*);
+static Cart *shim=0;
 
 
 //----------------------------------------------------------------------//
-//  cart_build
+//  cart_open
 //
-//  Initialize the list of tuples and then call gen_tuples to fill
-//  it recursively.
+//  Create an iterator over the product of a list of sets.  The 
+//  list itself is not kept and may be freed by the caller.
 //----------------------------------------------------------------------//
 
-void cart_build(List *setlist)
+Cart *cart_open(List *setlist)
 {
-   struct tuple *cur,*nxt;
-   List *myelements;
+   Cart *new;
+   Item *cur;
+   int i;
     
-   validate( setlist, LISTOBJ, "cart_build" );
+   validate( setlist, LISTOBJ, "cart_open" );
 
    if( DBG )
-      printf("cart_build on sets: %s\n",slprint(setlist));
-
-   //  
-   //  clear out the current table
-   //  
-
-   for( cur=head ; cur ; cur=nxt )
+      printf("cart_open on sets: %s\n",slprint(setlist));
+
+   new = (Cart *) xmalloc( sizeof(Cart) );
+   new->obj   = CARTOBJ;
+   new->dims  = setlist->n;
+   new->sets  = (List **) xmalloc( (new->dims+1)*sizeof(List *) );
+   new->pos   = (int *) xmalloc( (new->dims+1)*sizeof(int) );
+   new->subs  = newsequence();
+   new->stale = 0;
+   new->state = 0;
+
+   for( i=0, cur=setlist->first ; cur ; i++, cur=cur->next )
       {
-      validate( cur, SUBTOBJ, "build_sublist" );
-      nxt = cur->next;
-      freelist( cur->subs );
-      free(cur);
+      new->sets[i] = setmembers(cur->str);
+      new->pos[i]  = 0;
+      if( new->sets[i]->n )
+         addlist( new->subs, new->sets[i]->first->str );
       }
-      
-   //
-   //  build the table recursively
-   //
-
-   head = (struct tuple *) xmalloc( sizeof(struct tuple) );
-   head->subs = 0;
-   head->obj  = SUBTOBJ;
-   head->next = 0;
-   last = head;
-    
-   myelements = newsequence();
-   gen_sublist(myelements,setlist);
-   freelist(myelements);
-
-   if( head==0 )
-      FAULT("Failed to build subscript list in build_sublist");
 
-   next = head->next;
+   return new;
 }
 
 
 //----------------------------------------------------------------------//
-//  cart_next()
-//
-//  Get the next tuple.
+//  cart_close
 //----------------------------------------------------------------------//
 
-List *cart_next()
+Cart *cart_close(Cart *cart)
 {
-   List *thislist;
-   
-   if( head==0 )
-      FAULT("Cart before horse: cart_next called before cart_build");
+   if( cart==0 )return 0;
 
-   if( next == 0 )return 0;
-   
-   validate( next, SUBTOBJ, "get_element" );
+   validate( cart, CARTOBJ, "cart_close" );
 
-   thislist = next->subs;
-   next = next->next;
+   freelist( cart->subs );
+   xfree( cart->sets );
+   xfree( cart->pos );
+   cart->obj = 0;
+   xfree( cart );
 
-   return thislist;
+   return 0;
 }
 
+
 //----------------------------------------------------------------------//
-//  cart_first()
+//  cart_rewind
 //
-//  Reset the internal pointer to the first tuple and return it.
+//  Go back to before the first tuple.
 //----------------------------------------------------------------------//
 
-List *cart_first()
+void cart_rewind(Cart *cart)
 {
-   next = head->next;
-   return cart_next();
+   validate( cart, CARTOBJ, "cart_rewind" );
+   cart->state = 0;
 }
 
 
-
 //----------------------------------------------------------------------//
-//  gen_sublist
-//
-//  Recursively generates subscipts for consecutive elements of an 
-//  identifier.  
-//
-//  Given a list of subscripts already chosen from some of the sets 
-//  over which a variable is defined, and a list of remaining sets, 
-//  gen_sublist operates as follows:
+//  cart_step
 //
-//     * shift the first of the remaining sets off the list
-//     
-//     * for each element of the shifted set:
-//     
-//       - create a new element list with the element concatenated onto
-//         cur_elements;
-//         
-//       - call ourself on the new list and the tail of the set list
+//  Move to the next tuple, or to the first one on the first call 
+//  after cart_open or cart_rewind.  Returns 0 when there are no 
+//  more.  A product over no sets has a single, empty tuple, and a
+//  product involving an empty set has none.
 //----------------------------------------------------------------------//
 
-static void gen_sublist(List *cur_elements, List *remaining_sets )
+int cart_step(Cart *cart)
 {
-   struct tuple *new;
-   Item *first_set,*cur;
-   List *elements,*rest_sets,*new_elements;
-   
-   // check for stuffed arguments
-
-   validate( cur_elements,   LISTOBJ, "gen_varmap" );
-   validate( remaining_sets, LISTOBJ, "gen_varmap" );
-  
-   // check for an empty list; if so, we're at the bottom of the 
-   // recursion and have a complete list of subscripts.  add the 
-   // list to the table and return.
-   
-   if( remaining_sets->n == 0 )
+   int i;
+
+   validate( cart, CARTOBJ, "cart_step" );
+
+   switch( cart->state )
       {
-      validate( last, SUBTOBJ, "gen_sublist" );
-      
-      new = (struct tuple *) xmalloc( sizeof(struct tuple) );
-      new->subs = duplist( cur_elements );
-      new->obj  = SUBTOBJ;
-      new->next = 0;
-
-      last->next = new;
-      last = new;
-      return;
+      case 0:
+         for( i=0 ; i < cart->dims ; i++ )
+            {
+            if( cart->sets[i]->n == 0 )
+               {
+               cart->state = 2;
+               return 0;
+               }
+            cart->pos[i] = 0;
+            }
+         cart->state = 1;
+         cart->stale = 1;
+         return 1;
+
+      case 1:
+         cart->stale = 1;
+         for( i=cart->dims-1 ; i >= 0 ; i-- )
+            {
+            if( ++cart->pos[i] < cart->sets[i]->n )
+               return 1;
+            cart->pos[i] = 0;
+            }
+         cart->state = 2;
+         return 0;
+
+      default:
+         return 0;
       }
-   
-   // shift the first set off the list of remaining sets
-   
-   first_set = remaining_sets->first;
-   
-   rest_sets = newsequence();
-   for( cur=first_set->next ; cur ; cur=cur->next )
-      addlist( rest_sets, cur->str );
-
-   // get the elements of first_set
-   
-   elements = setelements(first_set->str);
-
-   // loop through the elements and call ourself
-   // recursively to process remaining sets.
-
-   for( cur=elements->first ; cur ; cur=cur->next )      
+}
+
+
+//----------------------------------------------------------------------//
+//  cart_subs
+//
+//  Return the current tuple as a list of subscripts.
+//----------------------------------------------------------------------//
+
+List *cart_subs(Cart *cart)
+{
+   int i;
+
+   validate( cart, CARTOBJ, "cart_subs" );
+
+   if( cart->state != 1 )
+      FAULT("cart_subs called without a current tuple");
+
+   if( cart->stale )
       {
-      new_elements = newsequence();
-      catlist( new_elements, cur_elements );
-      addlist( new_elements, cur->str );
-      gen_sublist( new_elements, rest_sets );
-      freelist( new_elements );
+      for( i=0 ; i < cart->dims ; i++ )
+         setitem( cart->subs, i, cart->sets[i]->vec[cart->pos[i]] );
+      cart->stale = 0;
       }
 
-   freelist(elements);
-   freelist(rest_sets);
+   return cart->subs;
 }
 
 
+//----------------------------------------------------------------------//
+//  cart_sub, cart_index
+//
+//  Return the subscript, or its position in its set, for one 
+//  dimension of the current tuple.
+//----------------------------------------------------------------------//
+
+char *cart_sub(Cart *cart, int i)
+{
+   validate( cart, CARTOBJ, "cart_sub" );
+   if( cart->state != 1 || i < 0 || i >= cart->dims )
+      FAULT("Invalid call to cart_sub");
+   return cart->sets[i]->vec[cart->pos[i]]->str;
+}
+
+int cart_index(Cart *cart, int i)
+{
+   validate( cart, CARTOBJ, "cart_index" );
+   if( cart->state != 1 || i < 0 || i >= cart->dims )
+      FAULT("Invalid call to cart_index");
+   return cart->pos[i];
+}
+
+
+//----------------------------------------------------------------------//
+//  cart_build
+//
+//  Set up the internal iterator used by cart_first and cart_next.
+//----------------------------------------------------------------------//
+
+void cart_build(List *setlist)
+{
+   shim = cart_close(shim);
+   shim = cart_open(setlist);
+}
+
+
+//----------------------------------------------------------------------//
+//  cart_next()
+//
+//  Get the next tuple.
+//----------------------------------------------------------------------//
+
+List *cart_next()
+{
+   if( shim==0 )
+      FAULT("Cart before horse: cart_next called before cart_build");
+
+   if( cart_step(shim) == 0 )return 0;
+
+   return cart_subs(shim);
+}
+
+//----------------------------------------------------------------------//
+//  cart_first()
+//
+//  Reset the internal iterator to the first tuple and return it.
+//----------------------------------------------------------------------//
+
+List *cart_first()
+{
+   if( shim==0 )
+      FAULT("Cart before horse: cart_first called before cart_build");
+
+   cart_rewind(shim);
+   return cart_next();
+}
@@ -9,6 +9,16 @@
 
 #include "lists.h"
 
+typedef struct cart_iter Cart;
+
+Cart* cart_open(List *);
+Cart* cart_close(Cart *);
+void  cart_rewind(Cart *);
+int   cart_step(Cart *);
+List* cart_subs(Cart *);
+char* cart_sub(Cart *, int);
+int   cart_index(Cart *, int);
+
 List* cart_first(void);
 List* cart_next(void);
 void  cart_build(List *);
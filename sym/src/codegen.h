@@ -11,7 +11,7 @@ extern void  (*codegen_declare    )();
 extern void  (*codegen_end_eqn    )();
 extern void  (*codegen_end_file   )();
 extern void  (*codegen_show_eq    )();
-extern char *(*codegen_show_node  )();
+extern void  (*codegen_show_node  )();
 extern void  (*codegen_write_file )();
 extern void  (*codegen_wrap_write )();
 extern char *(*codegen_spprint    )();
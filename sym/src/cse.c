@@ -0,0 +1,1699 @@
+/*-------------------------------------------------------------------*
+ *  cse.c
+ *
+ *  Common subexpression elimination for scalar equations.  A
+ *  language module hands the right side of each scalar equation in
+ *  a scope to cse_add, which builds it into a graph in which each
+ *  distinct subexpression appears only once.  Two subexpressions
+ *  are the same exactly when show_node would write them out the
+ *  same way and evaluate them in the same order.  cse_end then
+ *  gives a numbered temporary to each one used more than once,
+ *  which the caller writes ahead of the equations.  A scope is a
+ *  single equation or, where the language evaluates every equation
+ *  from the same values, a run of the equations in one block.
+ *
+ *  The same graph serves the other passes: -simplify folds numbers
+ *  and drops identities, -reduce makes exp, log and pow calls
+ *  cheaper, -hoist moves subexpressions of parameters alone into
+ *  derived constants, and cse_linear splits an equation into linear
+ *  terms.  Temporaries are only given out with -cse, so the others
+ *  can be used alone.  cse_report adds up what each one saved.
+ *-------------------------------------------------------------------*/
+
+#include "cse.h"
+
+#include "codegen.h"
+#include "dict.h"
+#include "error.h"
+#include "intern.h"
+#include "options.h"
+#include "output.h"
+#include "sets.h"
+#include "sym.h"
+#include "symtable.h"
+#include "xmalloc.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define myDEBUG 1
+
+//
+//  A distinct subexpression.  Names and numbers are num nodes
+//  holding their text, groupings are dom nodes, and everything
+//  else holds its operator or function and its children, which
+//  are 0 if absent.
+//
+
+typedef struct
+   {
+   Nodetype type;
+   char *str;              // text or operator, interned
+   int l,r;                // children
+   int uses;               // references from nodes and equations
+   int temp;               // number of its temporary, or 0
+   int simp;               // its simplified form, or 0 if not known
+   int pre;                // its derived constant plus 1, or 0
+   char param;             // 1 if only parameters and numbers,
+                           // which build clears for other names
+   int slot;               // position in the hash table
+   long size;              // nodes in it when written in full
+   long calls;             // exp, log and pow calls likewise
+   }
+   Cnode;
+
+#define isfunc(c) ((c)->type == exp || (c)->type == log || (c)->type == pow)
+
+//
+//  The subexpressions of the current scope, numbered from 1, and
+//  an open-addressed hash table of their numbers.  roots holds the
+//  right side of each equation and tempid the subexpression held
+//  by each temporary.
+//
+
+static Cnode *nodes = 0;
+static int nnodes = 0;
+static int maxnodes = 0;
+
+static int *tab = 0;
+static int tabsize = 0;
+
+static int *roots = 0;
+static int nroots = 0;
+static int maxroots = 0;
+
+static int *tempid = 0;
+static char **tempname = 0;
+static int ntemps = 0;
+static int maxtemps = 0;
+
+static char *prefix = "t";
+
+//
+//  Derived constants for the whole model.  predict gives the slot
+//  plus 1 for the text of each definition, prename the reference
+//  to each slot and predef its definition.  Hoisting is on if
+//  prevector is set, and nopre writes and counts subexpressions as
+//  if it weren't.
+//
+
+static void *predict = 0;
+static char **prename = 0;
+static char **predef = 0;
+static int npre = 0;
+static int maxpre = 0;
+
+static char *prevector = 0;
+static int nopre = 0;
+
+//
+//  Terms found by cse_linear: a variable, or 0 for the constant
+//  term, and its coefficient, or 0 for one.  nonlin holds the
+//  vectors used nonlinearly, after a space and each followed by
+//  one.
+//
+
+typedef struct
+   {
+   int var;
+   int coef;
+   }
+   Linterm;
+
+static Linterm *lin = 0;
+static int nlin = 0;
+static int maxlin = 0;
+static Strbuf nonlin = SB_INIT;
+
+//
+//  Nodes built for show_node
+//
+
+static Node *pool = 0;
+static long npool = 0;
+static long maxpool = 0;
+static List *none = 0;
+
+//
+//  Totals for the model
+//
+
+#define CSE_NSTATS 12
+
+static long stats[CSE_NSTATS];
+
+#define ST_NODES    0
+#define ST_WRITTEN  1
+#define ST_CALLS    2
+#define ST_CALLED   3
+#define ST_TEMPS    4
+#define ST_PLAIN    5
+#define ST_CONST    6
+#define ST_FUNCS    7
+#define ST_HOISTED  8
+#define ST_HCALLED  9
+#define ST_PRESIZE  10
+#define ST_PRECALLS 11
+
+//
+//  Private methods
+//
+
+/*-------------------------------------------------------------------*
+ *  hash
+ *
+ *  Mix the fields that identify a subexpression.
+ *-------------------------------------------------------------------*/
+static unsigned long hash( Nodetype type, char *str, int l, int r )
+{
+   unsigned long h;
+
+   h = (unsigned long) type;
+   h = h*1000003UL ^ (unsigned long) (size_t) str;
+   h = h*1000003UL ^ (unsigned long) l;
+   h = h*1000003UL ^ (unsigned long) r;
+   return h ^ (h >> 15);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  rehash
+ *
+ *  Double the size of the hash table and put every subexpression
+ *  back into it.
+ *-------------------------------------------------------------------*/
+static void rehash( void )
+{
+   Cnode *c;
+   int i,k,mask;
+
+   if( tab )xfree( tab );
+
+   tabsize = tabsize ? 2*tabsize : 1024 ;
+   tab = (int *) xmalloc( tabsize*sizeof(int) );
+   memset( tab, 0, tabsize*sizeof(int) );
+   mask = tabsize-1;
+
+   for( i=1 ; i <= nnodes ; i++ )
+      {
+      c = &nodes[i];
+      for( k=(int) (hash(c->type,c->str,c->l,c->r) & mask) ; tab[k] ; k=(k+1) & mask );
+      tab[k]  = i;
+      c->slot = k;
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  make
+ *
+ *  Return the number of a subexpression, adding it if it is new.
+ *-------------------------------------------------------------------*/
+static int make( Nodetype type, char *str, int l, int r )
+{
+   Cnode *c,*bigger;
+   int k,mask;
+
+   str = intern(str);
+
+   if( 2*(nnodes+1) >= tabsize )rehash();
+   mask = tabsize-1;
+
+   for( k=(int) (hash(type,str,l,r) & mask) ; tab[k] ; k=(k+1) & mask )
+      {
+      c = &nodes[tab[k]];
+      if( c->type == type && c->str == str && c->l == l && c->r == r )
+         return tab[k];
+      }
+
+   if( nnodes+1 >= maxnodes )
+      {
+      maxnodes = maxnodes ? 2*maxnodes : 1024 ;
+      bigger = (Cnode *) xmalloc( maxnodes*sizeof(Cnode) );
+      if( nodes )
+         {
+         memcpy( bigger, nodes, (nnodes+1)*sizeof(Cnode) );
+         xfree( nodes );
+         }
+      nodes = bigger;
+      }
+
+   c = &nodes[++nnodes];
+   c->type  = type;
+   c->str   = str;
+   c->l     = l;
+   c->r     = r;
+   c->uses  = 0;
+   c->temp  = 0;
+   c->simp  = 0;
+   c->pre   = 0;
+   c->param = 1;
+   c->slot  = k;
+   c->size  = 1;
+   c->calls = isfunc(c);
+
+   if( type == dom )
+      {
+      c->size  = nodes[r].size;
+      c->calls = nodes[r].calls;
+      c->param = nodes[r].param;
+      tab[k] = nnodes;
+      return nnodes;
+      }
+
+   if( l )
+      {
+      c->size  += nodes[l].size;
+      c->calls += nodes[l].calls;
+      c->param  = c->param && nodes[l].param;
+      }
+   if( r )
+      {
+      c->size  += nodes[r].size;
+      c->calls += nodes[r].calls;
+      c->param  = c->param && nodes[r].param;
+      }
+
+   tab[k] = nnodes;
+   return nnodes;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  group
+ *
+ *  Return a subexpression in parentheses.  Names and numbers are
+ *  left alone.
+ *-------------------------------------------------------------------*/
+static int group( int id )
+{
+   if( nodes[id].type == num )return id;
+   return make(dom,"",0,id);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  build
+ *
+ *  Add the subexpressions of the tree at cur.  Returns the number
+ *  of the whole.  Sums and products are expanded into chains in the
+ *  order show_node writes their terms, and names are identified by
+ *  the text show_symbol gives them.  show_node's parentheses fix the
+ *  order of evaluation, so they are kept as dom nodes and the
+ *  values computed don't change in the last bit.
+ *-------------------------------------------------------------------*/
+static int build( Node *cur, List *setlist, List *sublist )
+{
+   List *augsets,*augsubs,*sumover;
+   Item *ele;
+   Context mycontext;
+   char *str;
+   int l,r,id;
+
+   validate( cur, NODEOBJ, "cse_add" );
+
+   switch( cur->type )
+      {
+      case nam:
+         mycontext.lhs  = cur->lhs;
+         mycontext.dt   = cur->dt;
+         mycontext.tsub = 0;
+         str = show_symbol(cur->str,cur->domain,setlist,sublist,mycontext);
+         id  = make(num,str,0,0);
+         xrelease(str);
+         if( !istype(lookup(cur->str),par) )
+            nodes[id].param = 0;
+         return id;
+
+      case num:
+         return make(num,cur->str,0,0);
+
+      case lag:
+      case led:
+         return build(cur->r,setlist,sublist);
+
+      case dom:
+         return build(cur->l,setlist,sublist);
+
+      case sum:
+      case prd:
+         if( !is_sum_scalar() )
+            FAULT("Common subexpressions can only be found with scalar sums");
+
+         augsets = tmpsequence(XA_EQUATION);
+         catlist(augsets,setlist);
+         addlist(augsets,cur->l->str);
+
+         sumover = setmembers(cur->l->str);
+
+         augsubs = tmpsequence(XA_EQUATION);
+         catlist(augsubs,sublist);
+         addlist(augsubs,sumover->n ? sumover->first->str : "");
+
+         id = 0;
+         for( ele=sumover->first ; ele ; ele=ele->next )
+            {
+            setitem(augsubs,augsubs->n-1,ele);
+            r = build(cur->r,augsets,augsubs);
+            if( cur->type == prd )
+               r = group(r);
+            if( id == 0 )
+               id = r;
+            else if( cur->type == sum )
+               id = make(add,"+",id,r);
+            else
+               id = make(mul,"*",id,r);
+            }
+
+         if( id == 0 )
+            return make(num,cur->type == sum ? "0" : "1",0,0);
+         return group(id);
+
+      case neg:
+      case log:
+      case exp:
+         r = build(cur->r,setlist,sublist);
+         return make(cur->type,cur->str,0,r);
+
+      case add:
+      case sub:
+      case mul:
+      case dvd:
+      case pow:
+         l = build(cur->l,setlist,sublist);
+         r = build(cur->r,setlist,sublist);
+         return make(cur->type,cur->str,l,r);
+
+      default:
+         FAULT("Unexpected node type in cse_add");
+      }
+
+   return 0;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  finite_value
+ *
+ *  Return 1 if a value is finite: subtracting it from itself gives
+ *  zero.  Tested directly since math.h's exp, log and pow would
+ *  collide with the node types.
+ *-------------------------------------------------------------------*/
+static int finite_value( double v )
+{
+   return v - v == 0.0;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  constant
+ *
+ *  Return 1 and set *v if a subexpression is a number, possibly
+ *  negated or in parentheses.  Names are never numbers: only text
+ *  starting with a digit or a point is read.
+ *-------------------------------------------------------------------*/
+static int constant( int id, double *v )
+{
+   Cnode *c;
+   char *end;
+
+   c = &nodes[id];
+   switch( c->type )
+      {
+      case num:
+         if( !isdigit((unsigned char) c->str[0]) && c->str[0] != '.' )
+            return 0;
+         *v = strtod(c->str,&end);
+         return *end == '\0' && finite_value(*v);
+
+      case neg:
+         if( !constant(c->r,v) )return 0;
+         *v = -*v;
+         return 1;
+
+      case dom:
+         return constant(c->r,v);
+
+      default:
+         return 0;
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  number
+ *
+ *  Return the subexpression for a finite value, written with the
+ *  fewest digits that read back as the same value.  Negative values
+ *  are negated numbers.
+ *-------------------------------------------------------------------*/
+static int number( double v )
+{
+   char buf[64];
+   int digits;
+
+   if( !finite_value(v) )
+      FAULT("Infinite value passed to number in cse");
+
+   if( v == 0.0 )
+      return make(num,"0",0,0);
+
+   if( v < 0 )
+      return make(neg,"-",0,number(-v));
+
+   for( digits=1 ; digits < 17 ; digits++ )
+      {
+      sprintf(buf,"%.*g",digits,v);
+      if( strtod(buf,0) == v )break;
+      }
+   sprintf(buf,"%.*g",digits,v);
+
+   return make(num,buf,0,0);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  negate
+ *
+ *  Return minus a simplified subexpression.
+ *-------------------------------------------------------------------*/
+static int negate( int id )
+{
+   double v;
+
+   if( constant(id,&v) )return number(-v);
+   if( nodes[id].type == neg )return nodes[id].r;
+   return make(neg,"-",0,id);
+}
+
+
+//
+//  Terms of a run of additions and subtractions for chain.  Each
+//  is the simplified subexpression and its sign.
+//
+
+typedef struct
+   {
+   int id;
+   int sign;
+   }
+   Term;
+
+static Term *terms = 0;
+static int nterms = 0;
+static int maxterms = 0;
+
+static int simplify( int id );
+
+
+/*-------------------------------------------------------------------*
+ *  addterms
+ *
+ *  Add the terms of a run of additions and subtractions, descending
+ *  through negations and groupings of them, and simplifying each
+ *  term.  Returns 1 if any term simplified to something else.
+ *-------------------------------------------------------------------*/
+static int addterms( int id, int sign )
+{
+   Term *bigger;
+   int s,type,changed;
+
+   type = nodes[id].type;
+
+   if( type == dom )
+      {
+      s = nodes[id].r;
+      if( nodes[s].type == add || nodes[s].type == sub || nodes[s].type == neg )
+         return addterms(s,sign);
+      }
+
+   switch( type )
+      {
+      case add:
+         changed = addterms(nodes[id].l,sign);
+         return addterms(nodes[id].r,sign) || changed;
+
+      case sub:
+         changed = addterms(nodes[id].l,sign);
+         return addterms(nodes[id].r,-sign) || changed;
+
+      case neg:
+         return addterms(nodes[id].r,-sign);
+
+      default:
+         break;
+      }
+
+   s = simplify(id);
+   if( s != id )
+      {
+      type = nodes[s].type;
+      if( type == add || type == sub || type == neg || type == dom )
+         {
+         addterms(s,sign);
+         return 1;
+         }
+      }
+
+   if( nterms == maxterms )
+      {
+      maxterms = maxterms ? 2*maxterms : 256 ;
+      bigger = (Term *) xmalloc( maxterms*sizeof(Term) );
+      if( terms )
+         {
+         memcpy( bigger, terms, nterms*sizeof(Term) );
+         xfree( terms );
+         }
+      terms = bigger;
+      }
+
+   terms[nterms].id   = s;
+   terms[nterms].sign = sign;
+   nterms++;
+
+   return s != id;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  chain
+ *
+ *  Simplify a run of additions and subtractions: add up its numbers
+ *  in place of the last of them, and cancel terms that are both
+ *  added and subtracted.  Only the terms themselves are simplified
+ *  without -simplify.  If nothing changes, the run is returned as
+ *  it was so that it is evaluated in the same order.
+ *-------------------------------------------------------------------*/
+static int chain( int id )
+{
+   double v,total;
+   int first,last,i,j,n,changed,nconst,zero,sum;
+
+   first = nterms;
+   changed = addterms(id,1);
+   last = nterms;
+
+   //
+   //  numbers
+   //
+
+   nconst = 0;
+   zero   = 0;
+   total  = 0.0;
+   for( i=first ; i < last && do_simplify ; i++ )
+      if( constant(terms[i].id,&v) )
+         {
+         nconst++;
+         if( v == 0.0 )zero = 1;
+         total += terms[i].sign*v;
+         }
+
+   if( nconst > 1 || zero )
+      {
+      changed = 1;
+      for( i=first, j=0 ; i < last ; i++ )
+         if( constant(terms[i].id,&v) )
+            {
+            terms[i].id = 0;
+            if( ++j == nconst && total != 0.0 && finite_value(total) )
+               {
+               terms[i].id   = number(total < 0 ? -total : total);
+               terms[i].sign = total < 0 ? -1 : 1 ;
+               }
+            }
+      }
+
+   //
+   //  terms that cancel
+   //
+
+   for( i=first ; i < last && do_simplify ; i++ )
+      {
+      if( terms[i].id == 0 )continue;
+      for( j=i+1 ; j < last ; j++ )
+         if( terms[j].id == terms[i].id && terms[j].sign == -terms[i].sign )
+            {
+            terms[i].id = 0;
+            terms[j].id = 0;
+            changed = 1;
+            break;
+            }
+      }
+
+   if( !changed )
+      {
+      nterms = first;
+      return id;
+      }
+
+   //
+   //  rebuild what's left in order
+   //
+
+   sum = 0;
+   for( i=first, n=0 ; i < last ; i++ )
+      {
+      if( terms[i].id == 0 )continue;
+      if( n++ == 0 )
+         sum = terms[i].sign > 0 ? terms[i].id : negate(terms[i].id) ;
+      else if( terms[i].sign > 0 )
+         sum = make(add,"+",sum,terms[i].id);
+      else
+         sum = make(sub,"-",sum,terms[i].id);
+      }
+
+   nterms = first;
+   return n ? sum : number(0.0) ;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  fold
+ *
+ *  Return a simplified multiplication, division or power of two
+ *  simplified subexpressions.
+ *-------------------------------------------------------------------*/
+static int fold( Nodetype type, char *str, int l, int r )
+{
+   double a,b,v;
+   int ka,kb;
+
+   ka = constant(l,&a);
+   kb = constant(r,&b);
+
+   switch( type )
+      {
+      case mul:
+         if( ka && kb )
+            {
+            v = a*b;
+            if( finite_value(v) )return number(v);
+            }
+         if( (ka && a == 0.0) || (kb && b == 0.0) )return number(0.0);
+         if( ka && a ==  1.0 )return r;
+         if( kb && b ==  1.0 )return l;
+         if( ka && a == -1.0 )return negate(r);
+         if( kb && b == -1.0 )return negate(l);
+         break;
+
+      case dvd:
+         if( ka && kb && b != 0.0 )
+            {
+            v = a/b;
+            if( finite_value(v) )return number(v);
+            }
+         if( kb && b ==  1.0 )return l;
+         if( kb && b == -1.0 )return negate(l);
+         break;
+
+      case pow:
+         if( kb && b == 1.0 )return l;
+         if( kb && b == 0.0 )return number(1.0);
+         break;
+
+      default:
+         break;
+      }
+
+   return make(type,str,l,r);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  reduce
+ *
+ *  Return a cheaper equivalent of an operation on two simplified
+ *  subexpressions for -reduce, or 0 if there isn't one:
+ *
+ *     log(exp(x))    x
+ *     exp(a)^b       exp(a*b)
+ *     exp(a)*exp(b)  exp(a+b), also with a product to the left
+ *     exp(a)/exp(b)  exp(a-b)
+ *     x/exp(a)       x*exp(-a)
+ *     x^n            x*x... for whole n from 2 to 4, and 1/(x*x...)
+ *                    for -2 to -4
+ *
+ *  Powers are only multiplied out if x is a name or number or if
+ *  -cse will give it a temporary, so that nothing is evaluated more
+ *  than once.  The results need simplifying in turn.
+ *-------------------------------------------------------------------*/
+static int reduce( Nodetype type, int l, int r )
+{
+   Nodetype lt,rt;
+   char *ex;
+   double v;
+   int la,ra,i,n,prod;
+
+   //
+   //  make can move the nodes, so take what's needed first
+   //
+
+   lt = nodes[l].type;
+   rt = nodes[r].type;
+   la = lt == exp ? nodes[l].r : 0 ;
+   ra = rt == exp ? nodes[r].r : 0 ;
+   ex = intern("exp");
+
+   switch( type )
+      {
+      case log:
+         if( ra )
+            return ra;
+         break;
+
+      case pow:
+         if( la )
+            return make(exp,ex,0,make(mul,"*",la,r));
+
+         if( !constant(r,&v) || v != (int) v )break;
+         n = v < 0 ? -(int) v : (int) v ;
+         if( n < 2 || n > 4 )break;
+         if( lt != num && !do_cse )break;
+
+         for( prod=l, i=1 ; i < n ; i++ )
+            prod = make(mul,"*",prod,l);
+         if( v < 0 )
+            prod = make(dvd,"/",make(num,"1",0,0),prod);
+         return prod;
+
+      case mul:
+         if( la && ra )
+            return make(exp,ex,0,make(add,"+",la,ra));
+         if( ra && lt == mul && nodes[ nodes[l].r ].type == exp )
+            {
+            prod = nodes[l].l;
+            la   = nodes[ nodes[l].r ].r;
+            return make(mul,"*",prod,make(exp,ex,0,make(add,"+",la,ra)));
+            }
+         break;
+
+      case dvd:
+         if( la && ra )
+            return make(exp,ex,0,make(sub,"-",la,ra));
+         if( ra )
+            return make(mul,"*",l,make(exp,ex,0,negate(ra)));
+         break;
+
+      default:
+         break;
+      }
+
+   return 0;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  simplify
+ *
+ *  Return the simplified form of a subexpression, and with -reduce
+ *  the cheaper form of anything strength reduction applies to.
+ *  Numbers are worked on as values, so "0.0" is as much a zero as
+ *  "0".  Arithmetic on numbers is carried out, but exp, log and
+ *  powers are left to the target's library, which needn't agree
+ *  with this one in the last bit.  Nothing is folded that would
+ *  give an infinity, and anything not simplified is left exactly as
+ *  it was, groupings and all.
+ *-------------------------------------------------------------------*/
+static int simplify( int id )
+{
+   double v;
+   int l,r,s;
+
+   if( nodes[id].simp )return nodes[id].simp;
+
+   if( nodes[id].type == add || nodes[id].type == sub )
+      {
+      s = chain(id);
+      nodes[id].simp = s;
+      nodes[s].simp  = s;
+      return s;
+      }
+
+   l = nodes[id].l ? simplify(nodes[id].l) : 0 ;
+   r = nodes[id].r ? simplify(nodes[id].r) : 0 ;
+
+   if( do_reduce && (s = reduce(nodes[id].type,l,r)) )
+      {
+      s = simplify(s);
+      nodes[id].simp = s;
+      return s;
+      }
+
+   switch( nodes[id].type )
+      {
+      case neg:
+         s = id;
+         if( do_simplify || r != nodes[id].r )
+            s = negate(r);
+         break;
+
+      case dom:
+         s = id;
+         if( r != nodes[id].r )
+            s = nodes[r].type == num || constant(r,&v) ? r : make(dom,"",0,r) ;
+         break;
+
+      case exp:
+      case log:
+         s = make(nodes[id].type,nodes[id].str,0,r);
+         break;
+
+      case mul:
+      case dvd:
+      case pow:
+         if( do_simplify )
+            s = fold(nodes[id].type,nodes[id].str,l,r);
+         else
+            s = make(nodes[id].type,nodes[id].str,l,r);
+         break;
+
+      default:
+         s = id;
+      }
+
+   nodes[id].simp = s;
+   nodes[s].simp  = s;
+   return s;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  istrivial
+ *
+ *  Return 1 if a subexpression isn't worth a temporary.
+ *-------------------------------------------------------------------*/
+static int istrivial( Cnode *c )
+{
+   if( c->type == num || c->type == dom )return 1;
+   if( c->type == neg && nodes[c->r].type == num )return 1;
+   return 0;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  written
+ *
+ *  Count the nodes and calls written for a subexpression.  It is
+ *  written in full if top is set and otherwise may just be the
+ *  name of its temporary or derived constant.
+ *-------------------------------------------------------------------*/
+static long written( int id, int top, long *calls )
+{
+   Cnode *c;
+   long n;
+
+   c = &nodes[id];
+   if( c->type == num || (c->temp && !top) )return 1;
+   if( c->pre && !nopre && !top )return 1;
+   if( c->type == dom )return written(c->r,0,calls);
+
+   n = 1;
+   if( isfunc(c) )(*calls)++;
+   if( c->l )n += written(c->l,0,calls);
+   if( c->r )n += written(c->r,0,calls);
+   return n;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  tonode
+ *
+ *  Build the nodes show_node needs to write a subexpression.  Each
+ *  temporary, name and number is a num node holding its text, so
+ *  each language keeps its own notation, and groupings are calls to
+ *  a function with an empty name, which the default begin_func
+ *  writes as bare parentheses.
+ *-------------------------------------------------------------------*/
+static Node *tonode( int id, int top )
+{
+   Cnode *c;
+   Node *nde;
+
+   c = &nodes[id];
+
+   if( c->type == dom )
+      if( nodes[c->r].type == num || nodes[c->r].temp || (nodes[c->r].pre && !nopre) )
+         return tonode(c->r,0);
+
+   nde = &pool[npool++];
+
+   nde->obj    = NODEOBJ;
+   nde->type   = c->type;
+   nde->str    = c->str;
+   nde->l      = 0;
+   nde->r      = 0;
+   nde->domain = 0;
+   nde->undec  = 0;
+   nde->lhs    = 0;
+   nde->dt     = 0;
+
+   if( c->temp && !top )
+      {
+      nde->type = num;
+      nde->str  = tempname[c->temp];
+      return nde;
+      }
+
+   if( c->pre && !nopre && !top )
+      {
+      nde->type = num;
+      nde->str  = prename[c->pre-1];
+      return nde;
+      }
+
+   if( c->type == dom )
+      nde->type = exp;
+
+   if( c->l )nde->l = tonode(c->l,0);
+   if( c->r )nde->r = tonode(c->r,0);
+   return nde;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  render
+ *
+ *  Write a subexpression with the language module's show_node.
+ *-------------------------------------------------------------------*/
+static void render( Strbuf *out, int id, int top )
+{
+   long need,calls;
+
+   //
+   //  each grouping adds a node to at least one that is counted
+   //
+
+   calls = 0;
+   need  = 2*written(id,top,&calls);
+
+   if( need > maxpool )
+      {
+      if( pool )xfree( pool );
+      maxpool = need > 2*maxpool ? need : 2*maxpool ;
+      pool = (Node *) xmalloc( (int) (maxpool*sizeof(Node)) );
+      }
+
+   if( none == 0 )none = newsequence();
+
+   npool = 0;
+   codegen_show_node(out,nul,tonode(id,top),none,none);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  hoist
+ *
+ *  Give a subexpression of parameters and numbers a derived
+ *  constant, looking through groupings.  It shares the slot of any
+ *  earlier one written the same way.  Names, numbers and negated
+ *  numbers are left as they are.
+ *-------------------------------------------------------------------*/
+static void hoist( int id )
+{
+   Strbuf text = SB_INIT;
+   char **bigger;
+   char buf[64];
+   long slot,calls;
+
+   while( nodes[id].type == dom )
+      id = nodes[id].r;
+
+   if( !nodes[id].param || nodes[id].pre || istrivial(&nodes[id]) )
+      return;
+
+   nopre = 1;
+   render(&text,id,1);
+
+   if( predict == 0 )predict = newdict(1024);
+
+   slot = (long) getdict(predict,text.str);
+   if( slot == 0 )
+      {
+      if( npre == maxpre )
+         {
+         maxpre = maxpre ? 2*maxpre : 256 ;
+         bigger = (char **) xmalloc( 2*maxpre*sizeof(char *) );
+         if( prename )
+            {
+            memcpy( bigger, prename, npre*sizeof(char *) );
+            memcpy( bigger+maxpre, predef, npre*sizeof(char *) );
+            xfree( prename );
+            }
+         prename = bigger;
+         predef  = bigger+maxpre;
+         }
+
+      sprintf(buf,"%.40s[%d]",prevector,npre);
+      prename[npre] = intern(buf);
+      predef[npre]  = intern(text.str);
+      slot = ++npre;
+      putdict(predict,text.str,(void *) slot);
+
+      calls = 0;
+      stats[ST_PRESIZE]  += written(id,1,&calls);
+      stats[ST_PRECALLS] += calls;
+      }
+
+   nopre = 0;
+   nodes[id].pre = (int) slot;
+   sb_free(&text);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  vector
+ *
+ *  Copy the text of a variable before its subscript into buf, which
+ *  holds at least 64 characters, with a space on either side.
+ *-------------------------------------------------------------------*/
+static char *vector( char *buf, int var )
+{
+   char *str;
+   int n;
+
+   str = nodes[var].str;
+   n = (int) strcspn(str,"[");
+   if( n > 60 )n = 60;
+   sprintf(buf," %.*s ",n,str);
+   return buf;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  scale, divide, opposite
+ *
+ *  Multiply, divide and negate a coefficient, with 0 standing for
+ *  one, grouping anything that isn't a name or number.
+ *-------------------------------------------------------------------*/
+static int scale( int coef, int id )
+{
+   if( coef == 0 )return id;
+   return make(mul,"*",group(coef),group(id));
+}
+
+static int divide( int coef, int id )
+{
+   if( coef == 0 )coef = make(num,"1",0,0);
+   return make(dvd,"/",group(coef),group(id));
+}
+
+static int opposite( int coef )
+{
+   if( coef == 0 )return number(-1.0);
+   return make(neg,"-",0,group(coef));
+}
+
+
+/*-------------------------------------------------------------------*
+ *  addlin
+ *
+ *  Add a term to those found by cse_linear, adding its coefficient
+ *  to that of an earlier term for the same variable.
+ *-------------------------------------------------------------------*/
+static void addlin( int var, int coef )
+{
+   Linterm *bigger;
+   int i,old;
+
+   for( i=0 ; i < nlin ; i++ )
+      if( lin[i].var == var )
+         {
+         old = lin[i].coef ? lin[i].coef : make(num,"1",0,0) ;
+         if( coef == 0 )coef = make(num,"1",0,0);
+         lin[i].coef = make(add,"+",group(old),group(coef));
+         return;
+         }
+
+   if( nlin == maxlin )
+      {
+      maxlin = maxlin ? 2*maxlin : 64 ;
+      bigger = (Linterm *) xmalloc( maxlin*sizeof(Linterm) );
+      if( lin )
+         {
+         memcpy( bigger, lin, nlin*sizeof(Linterm) );
+         xfree( lin );
+         }
+      lin = bigger;
+      }
+
+   lin[nlin].var  = var;
+   lin[nlin].coef = coef;
+   nlin++;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  nonlinear
+ *
+ *  Note the vector of every variable in a subexpression as used
+ *  nonlinearly.
+ *-------------------------------------------------------------------*/
+static void nonlinear( int id )
+{
+   char buf[64];
+   Cnode *c;
+
+   c = &nodes[id];
+   if( c->param )return;
+
+   if( c->type == num )
+      {
+      if( !strstr(nonlin.str,vector(buf,id)) )
+         sb_add(&nonlin,buf+1);
+      return;
+      }
+
+   if( c->l )nonlinear(c->l);
+   if( c->r )nonlinear(c->r);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  linear
+ *
+ *  Add the terms of a subexpression multiplied by a coefficient.
+ *-------------------------------------------------------------------*/
+static void linear( int id, int coef )
+{
+   Nodetype type;
+   int l,r;
+
+   //
+   //  make can move the nodes, so take what's needed first
+   //
+
+   type = nodes[id].type;
+   l = nodes[id].l;
+   r = nodes[id].r;
+
+   if( nodes[id].param )
+      {
+      addlin(0,scale(coef,id));
+      return;
+      }
+
+   switch( type )
+      {
+      case num:
+         addlin(id,coef);
+         return;
+
+      case dom:
+         linear(r,coef);
+         return;
+
+      case add:
+         linear(l,coef);
+         linear(r,coef);
+         return;
+
+      case sub:
+         linear(l,coef);
+         linear(r,opposite(coef));
+         return;
+
+      case neg:
+         linear(r,opposite(coef));
+         return;
+
+      case mul:
+         if( nodes[l].param )
+            {
+            linear(r,scale(coef,l));
+            return;
+            }
+         if( nodes[r].param )
+            {
+            linear(l,scale(coef,r));
+            return;
+            }
+         break;
+
+      case dvd:
+         if( nodes[r].param )
+            {
+            linear(l,divide(coef,r));
+            return;
+            }
+         break;
+
+      default:
+         break;
+      }
+
+   nonlinear(id);
+}
+
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  cse_used
+ *
+ *  Return 1 if equations are to be written through this module,
+ *  which is the case with any of -cse, -simplify, -reduce and
+ *  -hoist.
+ *-------------------------------------------------------------------*/
+int cse_used( void )
+{
+   return do_cse || do_simplify || do_reduce || do_hoist;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_hoist
+ *
+ *  Turn on derived constants for the rest of the model, written as
+ *  the given vector subscripted from 0.  They are numbered over the
+ *  whole model, so the caller writes their definitions at the end.
+ *-------------------------------------------------------------------*/
+void cse_hoist( char *vector )
+{
+   prevector = vector;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_begin
+ *
+ *  Start a new scope.  Temporaries will be named with the given
+ *  prefix followed by their numbers.
+ *-------------------------------------------------------------------*/
+void cse_begin( char *pfx )
+{
+   int i;
+
+   for( i=1 ; i <= nnodes ; i++ )
+      tab[ nodes[i].slot ] = 0;
+
+   nnodes = 0;
+   nroots = 0;
+   ntemps = 0;
+   prefix = pfx;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_add
+ *
+ *  Add the right side of an equation to the current scope and
+ *  return a number identifying it for cse_show.
+ *-------------------------------------------------------------------*/
+int cse_add( Node *cur, List *setlist, List *sublist )
+{
+   int *bigger;
+   int id;
+
+   if( cur == 0 )
+      FAULT("Null pointer passed to cse_add");
+
+   validate( setlist, LISTOBJ, "cse_add for setlist" );
+   validate( sublist, LISTOBJ, "cse_add for sublist" );
+
+   id = build(cur,setlist,sublist);
+   stats[ST_PLAIN] += nodes[id].size;
+   stats[ST_FUNCS] += nodes[id].calls;
+   if( do_simplify || do_reduce )
+      id = simplify(id);
+
+   if( nroots == maxroots )
+      {
+      maxroots = maxroots ? 2*maxroots : 256 ;
+      bigger = (int *) xmalloc( maxroots*sizeof(int) );
+      if( roots )
+         {
+         memcpy( bigger, roots, nroots*sizeof(int) );
+         xfree( roots );
+         }
+      roots = bigger;
+      }
+   roots[nroots++] = id;
+
+   return id;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_end
+ *
+ *  With hoisting, replace the largest subexpressions of parameters
+ *  and numbers alone with derived constants.  With -cse, give a
+ *  temporary to each other subexpression in the scope that is used
+ *  more than once and return the number of temporaries.  They are
+ *  numbered from 1 so that each uses only those before it.
+ *-------------------------------------------------------------------*/
+int cse_end( void )
+{
+   Cnode *c;
+   char buf[64];
+   double value;
+   long calls;
+   int i;
+
+   if( nnodes >= maxtemps )
+      {
+      maxtemps = nnodes+1 > 2*maxtemps ? nnodes+1 : 2*maxtemps ;
+      if( tempid )xfree( tempid );
+      if( tempname )xfree( tempname );
+      tempid   = (int *) xmalloc( maxtemps*sizeof(int) );
+      tempname = (char **) xmalloc( maxtemps*sizeof(char *) );
+      }
+
+   //
+   //  count the uses of each subexpression still in an equation,
+   //  parents first, and with a grouping used wherever it is
+   //
+
+   for( i=1 ; i <= nnodes ; i++ )
+      nodes[i].uses = 0;
+
+   for( i=0 ; i < nroots ; i++ )
+      nodes[ roots[i] ].uses++;
+
+   for( i=nnodes ; i >= 1 ; i-- )
+      {
+      c = &nodes[i];
+      if( c->uses == 0 )continue;
+      if( c->type == dom )
+         nodes[c->r].uses += c->uses;
+      else
+         {
+         if( c->l )nodes[c->l].uses++;
+         if( c->r )nodes[c->r].uses++;
+         }
+      }
+
+   //
+   //  a subexpression of parameters is hoisted if it is a whole
+   //  right side or is used by something that isn't one
+   //
+
+   if( prevector )
+      {
+      for( i=0 ; i < nroots ; i++ )
+         if( nodes[ roots[i] ].param )
+            hoist(roots[i]);
+
+      for( i=1 ; i <= nnodes ; i++ )
+         {
+         c = &nodes[i];
+         if( c->uses == 0 || c->param || c->type == dom )continue;
+         if( c->l )hoist(c->l);
+         if( c->r )hoist(c->r);
+         }
+      }
+
+   ntemps = 0;
+   for( i=1 ; i <= nnodes ; i++ )
+      {
+      c = &nodes[i];
+      c->temp = 0;
+      if( !do_cse || c->uses < 2 || istrivial(c) )continue;
+      if( prevector && c->param )continue;
+
+      c->temp = ++ntemps;
+      tempid[ntemps] = i;
+      sprintf(buf,"%.40s%d",prefix,ntemps);
+      tempname[ntemps] = intern(buf);
+      }
+
+   //
+   //  add up what was saved, with and without derived constants
+   //
+
+   for( i=0 ; i < nroots ; i++ )
+      {
+      if( constant(roots[i],&value) )
+         stats[ST_CONST]++;
+      stats[ST_NODES] += nodes[roots[i]].size;
+      stats[ST_CALLS] += nodes[roots[i]].calls;
+      nopre = 1;
+      calls = 0;
+      stats[ST_WRITTEN] += written(roots[i],0,&calls);
+      stats[ST_CALLED]  += calls;
+      nopre = 0;
+      calls = 0;
+      stats[ST_HOISTED] += written(roots[i],0,&calls);
+      stats[ST_HCALLED] += calls;
+      }
+
+   for( i=1 ; i <= ntemps ; i++ )
+      {
+      nopre = 1;
+      calls = 0;
+      stats[ST_WRITTEN] += written(tempid[i],1,&calls);
+      stats[ST_CALLED]  += calls;
+      nopre = 0;
+      calls = 0;
+      stats[ST_HOISTED] += written(tempid[i],1,&calls);
+      stats[ST_HCALLED] += calls;
+      }
+
+   stats[ST_TEMPS] += ntemps;
+
+   if( DBG )
+      printf("cse_end: %d equations, %d nodes, %d temporaries\n",nroots,nnodes,ntemps);
+
+   return ntemps;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_name, cse_temp
+ *
+ *  Return the name of the k'th temporary and write the expression
+ *  it holds, for k from 1 to the number returned by cse_end.
+ *-------------------------------------------------------------------*/
+char *cse_name( int k )
+{
+   if( k < 1 || k > ntemps )
+      FAULT("Invalid index passed to cse_name");
+   return tempname[k];
+}
+
+void cse_temp( Strbuf *out, int k )
+{
+   if( k < 1 || k > ntemps )
+      FAULT("Invalid index passed to cse_temp");
+   render(out,tempid[k],1);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_show
+ *
+ *  Write the right side of an equation, as returned by cse_add,
+ *  using the temporaries.
+ *-------------------------------------------------------------------*/
+void cse_show( Strbuf *out, int root )
+{
+   if( root < 1 || root > nnodes )
+      FAULT("Invalid equation passed to cse_show");
+   render(out,root,0);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_constant
+ *
+ *  Return 1 if the right side of an equation, as returned by
+ *  cse_add, is just a number.
+ *-------------------------------------------------------------------*/
+int cse_constant( int root )
+{
+   double v;
+
+   if( root < 1 || root > nnodes )
+      FAULT("Invalid equation passed to cse_constant");
+   return constant(root,&v);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_linear
+ *
+ *  Split the right side of an equation into linear terms in a new
+ *  scope, so anything needed from the current one must already
+ *  have been written.  Returns the number of terms with nonzero
+ *  coefficients.
+ *
+ *  Each term is a variable times a coefficient of parameters and
+ *  numbers alone.  A variable is linear if it is reached only
+ *  through additions, subtractions, negations, and multiplications
+ *  and divisions by parameters.  Vectors are identified by the text
+ *  of their elements before the subscript, and a vector with any
+ *  element used in some other way loses all its terms, so the right
+ *  side is exactly the terms plus a constant plus an expression in
+ *  the nonlinear vectors alone.
+ *-------------------------------------------------------------------*/
+int cse_linear( Node *cur, List *setlist, List *sublist )
+{
+   char buf[64];
+   double v;
+   int i,n,was;
+
+   if( cur == 0 )
+      FAULT("Null pointer passed to cse_linear");
+
+   validate( setlist, LISTOBJ, "cse_linear for setlist" );
+   validate( sublist, LISTOBJ, "cse_linear for sublist" );
+
+   cse_begin(prefix);
+   nlin = 0;
+   sb_reset(&nonlin);
+   sb_add(&nonlin," ");
+
+   linear(build(cur,setlist,sublist),0);
+
+   //
+   //  drop the nonlinear vectors and simplify the coefficients as
+   //  -simplify would, dropping any that come to zero
+   //
+
+   was = do_simplify;
+   do_simplify = 1;
+
+   for( i=0, n=0 ; i < nlin ; i++ )
+      {
+      if( lin[i].var && strstr(nonlin.str,vector(buf,lin[i].var)) )
+         continue;
+      if( lin[i].coef )
+         lin[i].coef = simplify(lin[i].coef);
+      if( lin[i].coef && constant(lin[i].coef,&v) && v == 0.0 )
+         continue;
+      lin[n++] = lin[i];
+      }
+   nlin = n;
+
+   do_simplify = was;
+
+   return nlin;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_lin_wrt, cse_lin_coef, cse_lin_nonlinear
+ *
+ *  Return the variable of the k'th term found by cse_linear, for k
+ *  from 0, or "" for the constant term; write its coefficient; and
+ *  return the vectors used nonlinearly, each followed by a space.
+ *-------------------------------------------------------------------*/
+char *cse_lin_wrt( int k )
+{
+   if( k < 0 || k >= nlin )
+      FAULT("Invalid index passed to cse_lin_wrt");
+   return lin[k].var ? nodes[ lin[k].var ].str : "" ;
+}
+
+void cse_lin_coef( Strbuf *out, int k )
+{
+   if( k < 0 || k >= nlin )
+      FAULT("Invalid index passed to cse_lin_coef");
+   if( lin[k].coef == 0 )
+      sb_add(out,"1");
+   else
+      render(out,lin[k].coef,1);
+}
+
+char *cse_lin_nonlinear( void )
+{
+   return nonlin.str ? nonlin.str+1 : "" ;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_derived, cse_definition
+ *
+ *  Return the number of derived constants in the model so far and
+ *  the text of the k'th, for k from 0, written from the parameters
+ *  by the language module's show_node.
+ *-------------------------------------------------------------------*/
+int cse_derived( void )
+{
+   return npre;
+}
+
+char *cse_definition( int k )
+{
+   if( k < 0 || k >= npre )
+      FAULT("Invalid index passed to cse_definition");
+   return predef[k];
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_save, cse_load
+ *
+ *  Pass the totals from a worker process back to its parent:
+ *  cse_save appends them to a stream and clears them, and
+ *  cse_load adds in every set in a stream and closes it.
+ *-------------------------------------------------------------------*/
+void cse_save( FILE *out )
+{
+   fwrite( stats, sizeof(long), CSE_NSTATS, out );
+   memset( stats, 0, sizeof(stats) );
+}
+
+void cse_load( FILE *in )
+{
+   long rec[CSE_NSTATS];
+   int i;
+
+   if( fflush(in) || ferror(in) )
+      fatal_error("%s","could not write subexpression counts");
+   rewind( in );
+
+   while( fread(rec,sizeof(long),CSE_NSTATS,in) == CSE_NSTATS )
+      for( i=0 ; i < CSE_NSTATS ; i++ )
+         stats[i] += rec[i];
+
+   fclose( in );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  cse_report
+ *
+ *  Write the totals to the listing file: the nodes and exp, log and
+ *  pow calls before and after each pass, added up over the model.
+ *-------------------------------------------------------------------*/
+void cse_report( FILE *info )
+{
+   long change;
+
+   if( do_simplify || do_reduce )
+      {
+      fprintf(info,"\nSimplification:\n\n");
+      change = stats[ST_PLAIN]-stats[ST_NODES];
+      fprintf(info,"   Expression nodes:        %ld simplified to %ld, %ld %s\n",
+         stats[ST_PLAIN],stats[ST_NODES],change < 0 ? -change : change,
+         change < 0 ? "added" : "removed");
+      fprintf(info,"   exp, log and pow calls:  %ld simplified to %ld, %ld removed\n",
+         stats[ST_FUNCS],stats[ST_CALLS],stats[ST_FUNCS]-stats[ST_CALLS]);
+      fprintf(info,"   Constant equations:      %ld\n",stats[ST_CONST]);
+      }
+
+   if( do_cse )
+      {
+      fprintf(info,"\nCommon Subexpressions:\n\n");
+      fprintf(info,"   Expression nodes:        %ld written as %ld, %ld removed\n",
+         stats[ST_NODES],stats[ST_WRITTEN],stats[ST_NODES]-stats[ST_WRITTEN]);
+      fprintf(info,"   exp, log and pow calls:  %ld written as %ld, %ld removed\n",
+         stats[ST_CALLS],stats[ST_CALLED],stats[ST_CALLS]-stats[ST_CALLED]);
+      fprintf(info,"   Temporaries:             %ld\n",stats[ST_TEMPS]);
+      }
+
+   if( prevector )
+      {
+      fprintf(info,"\nParameter Hoisting:\n\n");
+      fprintf(info,"   Expression nodes:        %ld written as %ld, %ld removed per evaluation\n",
+         stats[ST_WRITTEN],stats[ST_HOISTED],stats[ST_WRITTEN]-stats[ST_HOISTED]);
+      fprintf(info,"   exp, log and pow calls:  %ld written as %ld, %ld removed per evaluation\n",
+         stats[ST_CALLED],stats[ST_HCALLED],stats[ST_CALLED]-stats[ST_HCALLED]);
+      fprintf(info,"   Derived constants:       %d, computed once with %ld nodes and %ld calls\n",
+         npre,stats[ST_PRESIZE],stats[ST_PRECALLS]);
+      }
+}
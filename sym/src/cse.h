@@ -0,0 +1,39 @@
+/* cse.h
+ *
+ * Header file for common subexpression elimination,
+ * simplification, strength reduction, hoisting of parameters and
+ * linear terms of scalar equations.
+ */
+
+#ifndef CSE_H
+#define CSE_H
+
+#include <stdio.h>
+#include "lists.h"
+#include "nodes.h"
+#include "str.h"
+
+//
+//  Function prototypes
+//
+
+int   cse_used(void);
+void  cse_begin(char *prefix);
+int   cse_add(Node *cur, List *setlist, List *sublist);
+int   cse_end(void);
+char* cse_name(int k);
+void  cse_temp(Strbuf *out, int k);
+void  cse_show(Strbuf *out, int root);
+int   cse_constant(int root);
+void  cse_hoist(char *vector);
+int   cse_derived(void);
+char* cse_definition(int k);
+int   cse_linear(Node *cur, List *setlist, List *sublist);
+char* cse_lin_wrt(int k);
+void  cse_lin_coef(Strbuf *out, int k);
+char* cse_lin_nonlinear(void);
+void  cse_save(FILE *stats);
+void  cse_load(FILE *stats);
+void  cse_report(FILE *info);
+
+#endif /* CSE_H */
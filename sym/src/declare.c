@@ -7,6 +7,8 @@
   
 #include "declare.h"
 
+#include "bitset.h"
+#include "dict.h"
 #include "error.h"
 #include "lists.h"
 #include "nodes.h"
@@ -27,6 +29,29 @@
 void symdeclare(Symboltype,char*,List*,char*,List*);
 
 
+//----------------------------------------------------------------------
+//  index_set()
+//
+//  Map each element of a set to its position plus one, so that a
+//  null pointer means "not a member".  Room is left for 'extra'
+//  elements to be added later.
+//----------------------------------------------------------------------
+
+static void *index_set(List *set, int extra)
+{
+   void *index;
+   Item *e;
+   long i;
+
+   index = newdict( set->n + extra );
+   for( i=1, e=set->first ; e ; i++, e=e->next )
+      if( getdict(index,e->str) == 0 )
+         putdict( index, e->str, (void *) i );
+
+   return index;
+}
+
+
 //----------------------------------------------------------------------
 //  declare()
 //  
@@ -42,6 +67,8 @@ Node *type,*name,*defn,*label,*attr;
    List *values,*attribs;
    char *labelstr;
    Item *e;
+   void *seen;
+   int  n;
    
    // 
    //  the name and type arguments are required for all declarations
@@ -89,12 +116,20 @@ Node *type,*name,*defn,*label,*attr;
    if( symtype==set )
       validate( defn, NODEOBJ, "declare @ set" );
    
+   for( n=0, cur=defn ; cur ; cur=cur->r )n++;
+   seen = newdict(n);
+
    values = newsequence();
    for( cur=defn ; cur ; cur=cur->r )
-      if( ismember( cur->str, values ) )
+      if( getdict( seen, cur->str ) )
          error_front("Declaration of '%s': duplicate element(s)",name->str);
       else
+         {
          addlist( values, cur->str );
+         putdict( seen, cur->str, values );
+         }
+
+   freedict( seen );
       
    //
    //  check set elements for backend problems.  note that we won't 
@@ -163,14 +198,17 @@ void decset(Node *name, Node *source, Nodetype op, Node *mods, Node *desc)
 {
    List *newset,*srcset,*altset;
    Node *m;
-   int  alias=0;
+   int  alias=0,extra;
    char *labelstr,*decfmt,*altname;
    Item *e;
-   void *sym;
+   void *sym,*index;
+   Bitset *keep;
+   long pos,next;
 
    newset = 0;
    srcset = 0;
    altset = 0;
+   keep   = 0;
 
    //
    //  defining an alias?
@@ -207,7 +245,9 @@ void decset(Node *name, Node *source, Nodetype op, Node *mods, Node *desc)
    srcset = symvalue(sym);
 
    //
-   //  set up operation
+   //  set up operation.  subtractions record the surviving elements
+   //  of the source set in a bitset over their positions and build
+   //  the new set from it at the end.
    //
 
    switch( op )
@@ -218,11 +258,16 @@ void decset(Node *name, Node *source, Nodetype op, Node *mods, Node *desc)
          break;
 
       case add:
-      case sub:
          newset = duplist( srcset );
          validate( mods, NODEOBJ, "decset" );
          break;
 
+      case sub:
+         keep = newbitset( srcset->n );
+         fillbitset( keep );
+         validate( mods, NODEOBJ, "decset" );
+         break;
+
       case equ:
          newset = newsequence();
          validate( mods, NODEOBJ, "decset" );
@@ -230,7 +275,13 @@ void decset(Node *name, Node *source, Nodetype op, Node *mods, Node *desc)
 
       case sad:
       case ssu:
-         newset = duplist( srcset );
+         if( op == sad )
+            newset = duplist( srcset );
+         else
+            {
+            keep = newbitset( srcset->n );
+            fillbitset( keep );
+            }
          validate( mods, NODEOBJ, "decset" );
          altname = lookup(mods->str);
          if( altname==0 )
@@ -244,6 +295,19 @@ void decset(Node *name, Node *source, Nodetype op, Node *mods, Node *desc)
       default:
          FAULT("Invalid operation in decset" );
       }
+
+   //
+   //  index the source set by position.  elements added to the set
+   //  go into the index too, after the source elements.
+   //
+
+   if( altset )
+      extra = altset->n;
+   else
+      for( extra=0, m=mods ; m ; m=m->r )extra++;
+
+   index = index_set( srcset, extra );
+   next  = srcset->n;
   
    // 
    //  make any modifications
@@ -254,21 +318,25 @@ void decset(Node *name, Node *source, Nodetype op, Node *mods, Node *desc)
       switch( op )
          {
          case add: 
-            if( ismember(m->str,newset)==0 )
+            if( getdict(index,m->str)==0 )
+               {
                addlist( newset, m->str );
+               putdict( index, m->str, (void *) ++next );
+               }
             else 
                error_front(decfmt,name->str,m->str,"is already",source->str);
             break;
 
          case sub:
-            if( ismember(m->str,newset) )
-               freeitem( newset, m->str );
+            pos = (long) getdict(index,m->str);
+            if( pos && getbit(keep,pos-1) )
+               clearbit( keep, pos-1 );
             else
                error_front(decfmt,name->str,m->str,"is not",source->str);
             break;
          
          case equ:
-            if( ismember(m->str,srcset) )
+            if( getdict(index,m->str) )
                addlist( newset, m->str );
             else
                error_front(decfmt,name->str,m->str,"is not",source->str);
@@ -276,24 +344,41 @@ void decset(Node *name, Node *source, Nodetype op, Node *mods, Node *desc)
 
          case sad:
             for( e=altset->first ; e ; e=e->next )
-               if( ismember(e->str,newset)==0 )
+               if( getdict(index,e->str)==0 )
+                  {
                   addlist( newset, e->str );
+                  putdict( index, e->str, (void *) ++next );
+                  }
                else
                   error_front(decfmt,name->str,e->str,"is already",source->str);
             break;
 
          case ssu:
             for( e=altset->first ; e ; e=e->next )
-               if( ismember(e->str,newset) )
-                  freeitem( newset, e->str );
+               {
+               pos = (long) getdict(index,e->str);
+               if( pos && getbit(keep,pos-1) )
+                  clearbit( keep, pos-1 );
                else
                   error_front(decfmt,name->str,e->str,"is not",source->str);
+               }
             break;
 
          default:
             FAULT("unexpected state in decset");
          }
 
+   if( keep )
+      {
+      newset = newsequence();
+      for( pos=0, e=srcset->first ; e ; pos++, e=e->next )
+         if( getbit(keep,pos) )
+            addlist( newset, e->str );
+      keep = freebitset( keep );
+      }
+
+   freedict( index );
+
    //
    //  is the resulting set nonempty?
    //
@@ -365,7 +450,7 @@ void decunion(Node *name, Node *srcs, Node *desc)
    Node *s;
    char *labelstr;
    Item *e;
-   void *sym;
+   void *sym,*seen;
 
    newset = 0;
    srcset = 0;
@@ -390,6 +475,7 @@ void decunion(Node *name, Node *srcs, Node *desc)
    //
 
    newset = newlist();
+   seen   = newdict(0);
 
    for( s=srcs ; s ; s=s->r )
       {
@@ -403,13 +489,18 @@ void decunion(Node *name, Node *srcs, Node *desc)
       srcset = symvalue(sym);
 
       for( e=srcset->first ; e ; e=e->next )
-         if( ismember(e->str,newset)==0 )
+         if( getdict(seen,e->str)==0 )
+            {
             addlist( newset, e->str );
+            putdict( seen, e->str, newset );
+            }
 
       setsubset(s->str,name->str);
 
       freelist(srcset);
       }
+
+   freedict( seen );
       
    //
    //  create the new symbol table entry
@@ -11,6 +11,7 @@
 #include "error.h"
 #include "lang.h"
 #include "options.h"
+#include "outfile.h"
 #include "output.h"
 #include "str.h"
 #include "sym.h"
@@ -386,8 +387,8 @@ void Default_write_file(char *basename)
    if (DBG)
       xcheck("after end_file");
 
-   fclose(code);
-   fclose(info);
+   outfile_close(code);
+   outfile_close(info);
 }
 
 /*--------------------------------------------------------------------*
@@ -398,36 +399,24 @@ void Default_write_file(char *basename)
 *--------------------------------------------------------------------*/
 void Default_show_eq(void *eq, List *setlist, List *sublist)
 {
+   static Strbuf all = SB_INIT;
    Node *getlhs(), *getrhs();
-   char *lstr, *rstr, *all;
    char *head, *tail;
 
-   lstr = codegen_show_node(nul, getlhs(eq), setlist, sublist);
-   rstr = codegen_show_node(nul, getrhs(eq), setlist, sublist);
-
-   codegen_begin_eqn(eq);
-
+   sb_reset(&all);
+   codegen_show_node(&all, nul, getlhs(eq), setlist, sublist);
+   sb_add(&all, is_eqn_normalized() ? " - (" : " = ");
+   codegen_show_node(&all, nul, getrhs(eq), setlist, sublist);
    if (is_eqn_normalized())
-      all = concat(4, lstr, " - (", rstr, ")");
-   else
-      all = concat(3, lstr, " = ", rstr);
-
-   free(lstr);
-   free(rstr);
+      sb_add(&all, ")");
 
-   if (get_line_length() == 0)
-   {
-      fprintf(code, "%s", all);
-      free(all);
-      codegen_end_eqn(eq);
-      return;
-   }
+   codegen_begin_eqn(eq);
 
-   if (strlen(all) <= get_line_length())
-      fprintf(code, "%s", all);
+   if (get_line_length() == 0 || all.len <= get_line_length())
+      fprintf(code, "%s", all.str);
    else
    {
-      for (head = all; (tail = strchr(head, '\n')); head = tail)
+      for (head = all.str; (tail = strchr(head, '\n')); head = tail)
       {
          *tail++ = '\0';
          codegen_wrap_write(head, 1, 0);
@@ -435,33 +424,36 @@ void Default_show_eq(void *eq, List *setlist, List *sublist)
       codegen_wrap_write(head, 0, 0);
    }
 
-   free(all);
+   xarena_reset(XA_EQUATION);
    codegen_end_eqn(eq);
 }
 
 /*--------------------------------------------------------------------*
    *  show_node
    *
-   *  Generate the node recursively.  This allocates and frees a
-   *  lot of small chunks of memory as it constructs nodes from the
-   *  bottom up.  Avoids having any fixed buffer sizes but is a
-   *  bit tedious as a result.
+   *  Generate the node recursively, appending it to a string builder.
+   *  A binary operator's line break depends on the lengths of both
+   *  operands, so it is inserted once the right operand is done.
+   *  Strings from the language module, like those from show_symbol,
+   *  are copied in and released with xrelease.  Subscript lists for
+   *  sums come from the equation arena, which show_eq resets once
+   *  the equation has been written.
    *--------------------------------------------------------------------*/
-char *Default_show_node(Nodetype prevtype, Node *cur, List *setlist, List *sublist)
+void Default_show_node(Strbuf *out, Nodetype prevtype, Node *cur, List *setlist, List *sublist)
 {
    int parens, wrap_right;
-   char *buf, *newbuf;
    List *augsets, *augsubs, *sumover;
-   char *beginfunc, *endfunc;
-   char *lstr, *rstr, *cr;
+   char *endfunc;
+   char *lstr, *cr;
    char *lpar, *rpar;
    char *op, *thisop;
    int isfunc;
+   int start, mid, llen, rlen;
    char *side;
    Context mycontext;
 
    if (cur == 0)
-      return strdup("");
+      return;
 
    mycontext.lhs = cur->lhs;
    mycontext.dt = cur->dt;
@@ -564,14 +556,17 @@ char *Default_show_node(Nodetype prevtype, Node *cur, List *setlist, List *subli
    switch (cur->type)
    {
    case nam:
-      return show_symbol(cur->str, cur->domain, setlist, sublist, mycontext);
+      sb_take(out, show_symbol(cur->str, cur->domain, setlist, sublist, mycontext));
+      return;
 
    case lag:
    case led:
-      return codegen_show_node(cur->type, cur->r, setlist, sublist);
+      codegen_show_node(out, cur->type, cur->r, setlist, sublist);
+      return;
 
    case dom:
-      return codegen_show_node(cur->type, cur->l, setlist, sublist);
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      return;
 
    case lst:
       FAULT("Unexpected lst state in show_node");
@@ -594,7 +589,7 @@ char *Default_show_node(Nodetype prevtype, Node *cur, List *setlist, List *subli
 
          lstr = (cur->l)->str;
 
-         augsets = newsequence();
+         augsets = tmpsequence(XA_EQUATION);
          catlist(augsets, setlist);
          addlist(augsets, lstr);
 
@@ -602,15 +597,22 @@ char *Default_show_node(Nodetype prevtype, Node *cur, List *setlist, List *subli
          lpar = (cur->type == prd) ? "(" : "";
          rpar = (cur->type == prd) ? ")" : "";
 
-         buf = strdup("(");
+         sb_add(out, "(");
          thisop = " ";
 
-         sumover = setelements(lstr);
+         //
+         //  the subscripts for each term differ only in the last
+         //  one, which is replaced in place for each element
+         //
+
+         sumover = setmembers(lstr);
+         augsubs = tmpsequence(XA_EQUATION);
+         catlist(augsubs, sublist);
+         addlist(augsubs, sumover->n ? sumover->first->str : "");
+
          for (ele = sumover->first; ele; ele = ele->next)
          {
-            augsubs = newsequence();
-            catlist(augsubs, sublist);
-            addlist(augsubs, ele->str);
+            setitem(augsubs, augsubs->n - 1, ele);
 
             if (DBG)
             {
@@ -618,25 +620,17 @@ char *Default_show_node(Nodetype prevtype, Node *cur, List *setlist, List *subli
                printf("augsets = %s\n", slprint(augsets));
             }
 
-            rstr = codegen_show_node(cur->type, cur->r, augsets, augsubs);
-            newbuf = concat(6, buf, "\n      ", thisop, lpar, rstr, rpar);
+            sb_add(out, "\n      ");
+            sb_add(out, thisop);
+            sb_add(out, lpar);
+            codegen_show_node(out, cur->type, cur->r, augsets, augsubs);
+            sb_add(out, rpar);
 
             thisop = op;
-
-            free(buf);
-            free(rstr);
-            freelist(augsubs);
-
-            buf = newbuf;
          }
 
-         newbuf = concat(2, buf, ")");
-         free(buf);
-
-         freelist(augsets);
-         freelist(sumover);
-
-         return newbuf;
+         sb_add(out, ")");
+         return;
       }
 
    //
@@ -650,82 +644,79 @@ char *Default_show_node(Nodetype prevtype, Node *cur, List *setlist, List *subli
 
       lstr = (cur->l)->str;
 
-      augsets = newsequence();
+      augsets = tmpsequence(XA_EQUATION);
       catlist(augsets, setlist);
       addlist(augsets, lstr);
 
-      augsubs = newsequence();
+      augsubs = tmpsequence(XA_EQUATION);
       catlist(augsubs, sublist);
       addlist(augsubs, "*");
 
-      beginfunc = codegen_begin_func(cur->str, lstr);
-      rstr = codegen_show_node(cur->type, cur->r, augsets, augsubs);
-      endfunc = codegen_end_func();
-
-      buf = concat(3, beginfunc, rstr, endfunc);
-
-      free(beginfunc);
-      free(rstr);
-      free(endfunc);
-
-      freelist(augsubs);
-      freelist(augsets);
-
-      return buf;
+      sb_take(out, codegen_begin_func(cur->str, lstr));
+      codegen_show_node(out, cur->type, cur->r, augsets, augsubs);
+      sb_take(out, codegen_end_func());
+      return;
    }
 
    //
    //  case 4: everything else
    //
 
+   isfunc = now(log) || now(exp);
+
+   lpar = (parens && isfunc == 0) ? "(" : "";
+   rpar = (parens && isfunc == 0) ? ")" : "";
+
+   start = out->len;
+   sb_add(out, lpar);
+
    switch (cur->type)
    {
    case log:
    case exp:
-      isfunc = 1;
-      lstr = codegen_begin_func(cur->str, 0);
+      sb_take(out, codegen_begin_func(cur->str, 0));
       endfunc = codegen_end_func();
       op = "";
       break;
 
    case pow:
-      isfunc = 0;
-      lstr = codegen_show_node(cur->type, cur->l, setlist, sublist);
-      endfunc = strdup("");
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      endfunc = 0;
       op = "^";
       break;
 
    default:
-      isfunc = 0;
-      lstr = codegen_show_node(cur->type, cur->l, setlist, sublist);
-      endfunc = strdup("");
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      endfunc = 0;
       op = cur->str;
    }
 
-   rstr = codegen_show_node(cur->type, cur->r, setlist, sublist);
+   mid = out->len;
+   codegen_show_node(out, cur->type, cur->r, setlist, sublist);
+
+   llen = mid - start - strlen(lpar);
+   rlen = out->len - mid;
 
    cr = "";
-   if (strlen(lstr) + strlen(rstr) > 70 || strlen(lstr) > 40 || strlen(rstr) > 40)
+   if (llen + rlen > 70 || llen > 40 || rlen > 40)
       cr = " \n        ";
 
-   lpar = (parens && isfunc == 0) ? "(" : "";
-   rpar = (parens && isfunc == 0) ? ")" : "";
-
    wrap_right = 0;
    if (cur->type == sub)
       if (cur->r->type == add || cur->r->type == sub)
          wrap_right = 1;
 
+   mid = sb_insert(out, mid, cr);
+   mid = sb_insert(out, mid, op);
    if (wrap_right)
-      buf = concat(9, lpar, lstr, cr, op, "(", rstr, ")", rpar, endfunc);
-   else
-      buf = concat(7, lpar, lstr, cr, op, rstr, rpar, endfunc);
-
-   free(lstr);
-   free(rstr);
-   free(endfunc);
+   {
+      sb_insert(out, mid, "(");
+      sb_add(out, ")");
+   }
 
-   return buf;
+   sb_add(out, rpar);
+   if (endfunc)
+      sb_take(out, endfunc);
 }
 
 //
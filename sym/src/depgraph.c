@@ -0,0 +1,555 @@
+/*-------------------------------------------------------------------*
+ *  depgraph.c
+ *
+ *  Find the block structure of a model's scalar equations.  Each
+ *  scalar equation is matched to the variable element on its left
+ *  side, and it depends on every other equation whose left side
+ *  element it uses on its right.  The strongly connected components
+ *  of that graph, found with Tarjan's algorithm, are the blocks:
+ *  a block of one equation that doesn't use its own left side can
+ *  be evaluated directly once the blocks before it are done, and
+ *  is called recursive; any other block has to be solved as a set
+ *  of simultaneous equations.  Tarjan's algorithm finishes each
+ *  block only after every block it depends on, so taking the
+ *  blocks in the order they are found puts the equations in block
+ *  lower triangular form.
+ *
+ *  Scalar equations are numbered from 1 in the order the code
+ *  generators write them.  Variable elements are identified by
+ *  name, subscripts and time offset, so lead(CAP) and CAP are
+ *  different elements and an equation for lead(CAP) doesn't feed
+ *  one using CAP.  Where a variable has a time subscript the
+ *  offset is applied to the subscript instead, and references
+ *  before the first period or after the last are dropped.
+ *  Parameters never link equations.
+ *
+ *  The blocks are written to <basename>_blocks.csv with one line
+ *  for each equation:
+ *
+ *     block,equation,lhs,dt,kind
+ *
+ *  where block numbers the blocks from 1 in evaluation order, lhs
+ *  is the left side element and dt its time offset, and kind is
+ *  either recursive or simultaneous.  Equations within a block are
+ *  listed in ascending order.  An equation whose left side isn't a
+ *  variable, or is an element defined by an earlier equation, is
+ *  unmatched: it still has its place in the ordering but no other
+ *  equation depends on it.  A summary goes in the listing file.
+ *-------------------------------------------------------------------*/
+
+#include "depgraph.h"
+
+#include "cart.h"
+#include "dict.h"
+#include "eqns.h"
+#include "error.h"
+#include "lists.h"
+#include "nodes.h"
+#include "outfile.h"
+#include "output.h"
+#include "sets.h"
+#include "str.h"
+#include "sym.h"
+#include "symtable.h"
+#include "xmalloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+//  A variable element: the text of its name and subscripts, its
+//  time offset, and the equation that defines it, or -1
+//
+
+typedef struct
+   {
+   char *text;
+   int   dt;
+   long  defby;
+   }
+   Element;
+
+//
+//  Elements seen so far, with a dictionary mapping each key to one
+//  plus its position in ele
+//
+
+static void    *elekeys = 0;
+static Element *ele     = 0;
+static long     nele    = 0;
+static long     maxele  = 0;
+
+//
+//  Right side references of each equation, as element numbers:
+//  those of equation e are refs[refptr[e]] to refs[refptr[e+1]-1]
+//
+
+static long *refs    = 0;
+static long  nrefs   = 0;
+static long  maxrefs = 0;
+
+static long *refptr  = 0;
+static long *lhsele  = 0;
+static long  neqs    = 0;
+static long  maxptr  = 0;
+static long  maxlhs  = 0;
+
+static Strbuf key = SB_INIT;
+
+//
+//  Private methods
+//
+
+/*-------------------------------------------------------------------*
+ *  grow
+ *
+ *  Make room for at least one more element at position n of an
+ *  array, doubling its size when it is full.
+ *-------------------------------------------------------------------*/
+static void *grow( void *old, long n, long *max, int size )
+{
+   void *new;
+
+   if( n < *max )return old;
+
+   *max = *max ? 2*(*max) : 1024 ;
+   new = xmalloc( (int) (*max*size) );
+   if( old )
+      {
+      memcpy( new, old, n*size );
+      xfree( old );
+      }
+   return new;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  element
+ *
+ *  Return the number of the variable element a name node refers to
+ *  in the scalar equation with subscripts esubs over the sets
+ *  esets, adding it if it is new.  Returns -1 for a parameter or
+ *  for a time offset that falls outside the time set.  Subscripts
+ *  are found the same way show_symbol finds them.
+ *-------------------------------------------------------------------*/
+static long element( Node *cur, List *esets, List *esubs )
+{
+   void *sym;
+   List *time;
+   Item *vset,*eset,*esub;
+   char *sub,buf[32];
+   int dt,n,t,len;
+   long id;
+
+   sym = lookup( cur->str );
+   if( !istype(sym,var) )
+      return -1;
+
+   dt = cur->dt;
+   n  = 0;
+
+   sb_reset( &key );
+   sb_add( &key, ((Symbol *) sym)->str );
+
+   for( vset=cur->domain->first ; vset ; vset=vset->next )
+      for( eset=esets->first, esub=esubs->first ; eset ; eset=eset->next, esub=esub->next )
+         if( strcasecmp(vset->str,eset->str)==0 || isaliasof(eset->str,vset->str) )
+            {
+            sub = esub->str;
+            if( dt && (issubset(vset->str,"time") || isaliasof(vset->str,"time")) )
+               {
+               time = setmembers("time");
+               t = setindex("time",sub) + dt;
+               if( t < 0 || t >= time->n )
+                  return -1;
+               sub = time->vec[t]->str;
+               dt  = 0;
+               }
+            sb_add( &key, n++ ? "," : "(" );
+            sb_add( &key, sub );
+            }
+
+   if( n != cur->domain->n )
+      FAULT("Inconsistent number of subscripts in depgraph");
+   if( n )
+      sb_add( &key, ")" );
+
+   len = key.len;
+   sprintf( buf, "@%d", dt );
+   sb_add( &key, buf );
+
+   id = (long) getdict( elekeys, key.str );
+   if( id )
+      return id-1;
+
+   ele = (Element *) grow( ele, nele, &maxele, sizeof(Element) );
+   key.str[len] = '\0';
+   ele[nele].text  = xstrdup( key.str );
+   ele[nele].dt    = dt;
+   ele[nele].defby = -1;
+   key.str[len] = '@';
+
+   putdict( elekeys, key.str, (void *) (nele+1) );
+   return nele++;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  walk
+ *
+ *  Record the variable elements used by the right side of an
+ *  equation.  Sums and products are expanded over their sets.
+ *-------------------------------------------------------------------*/
+static void walk( Node *cur, List *setlist, List *sublist )
+{
+   List *augsets,*augsubs,*sumover;
+   Item *item;
+   long id;
+
+   validate( cur, NODEOBJ, "depgraph" );
+
+   switch( cur->type )
+      {
+      case nam:
+         id = element( cur, setlist, sublist );
+         if( id >= 0 )
+            {
+            refs = (long *) grow( refs, nrefs, &maxrefs, sizeof(long) );
+            refs[nrefs++] = id;
+            }
+         break;
+
+      case num:
+         break;
+
+      case lag:
+      case led:
+      case neg:
+      case log:
+      case exp:
+         walk( cur->r, setlist, sublist );
+         break;
+
+      case dom:
+         walk( cur->l, setlist, sublist );
+         break;
+
+      case sum:
+      case prd:
+         augsets = tmpsequence(XA_EQUATION);
+         catlist(augsets,setlist);
+         addlist(augsets,cur->l->str);
+
+         sumover = setmembers(cur->l->str);
+
+         augsubs = tmpsequence(XA_EQUATION);
+         catlist(augsubs,sublist);
+         addlist(augsubs,sumover->n ? sumover->first->str : "");
+
+         for( item=sumover->first ; item ; item=item->next )
+            {
+            setitem(augsubs,augsubs->n-1,item);
+            walk( cur->r, augsets, augsubs );
+            }
+         break;
+
+      case add:
+      case sub:
+      case mul:
+      case dvd:
+      case pow:
+         walk( cur->l, setlist, sublist );
+         walk( cur->r, setlist, sublist );
+         break;
+
+      default:
+         FAULT("Unexpected node type in depgraph");
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  lhs
+ *
+ *  Return the element on the left side of an equation, or -1 if it
+ *  isn't a variable.
+ *-------------------------------------------------------------------*/
+static long lhs( Node *cur, List *setlist, List *sublist )
+{
+   while( cur->type == lag || cur->type == led || cur->type == dom )
+      cur = cur->type == dom ? cur->l : cur->r ;
+
+   if( cur->type != nam )
+      return -1;
+
+   return element( cur, setlist, sublist );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  bynumber
+ *
+ *  Order equation numbers, for qsort.
+ *-------------------------------------------------------------------*/
+static int bynumber( const void *a, const void *b )
+{
+   long x = *(const long *) a;
+   long y = *(const long *) b;
+
+   return x < y ? -1 : x > y ;
+}
+
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  depgraph_write
+ *
+ *  Build the dependency graph of the scalar equations, find its
+ *  blocks and write them out.
+ *-------------------------------------------------------------------*/
+void depgraph_write( char *basename )
+{
+   List *eqnsets(),*eqsets;
+   Cart *cart;
+   FILE *out;
+   void *eq;
+   char *fname;
+   long *index,*low,*next,*call,*stack,*members,*blockptr;
+   char *onstack;
+   long e,f,i,j,v,w,top,sp,nmem,counter,nedges,nblocks;
+   long nrecursive,nsimblocks,nsimeqs,largest,unmatched;
+   int simultaneous;
+
+   elekeys = newdict(0);
+
+   //
+   //  first pass: the elements each scalar equation defines and
+   //  uses
+   //
+
+   for( eq=firsteqn() ; eq ; eq=nexteqn(eq) )
+      {
+      if( hasundec(eq) || !istimeok(eq) )
+         continue;
+
+      eqsets = eqnsets(eq);
+      cart = cart_open(eqsets);
+      while( cart_step(cart) )
+         {
+         refptr = (long *) grow( refptr, neqs+1, &maxptr, sizeof(long) );
+         lhsele = (long *) grow( lhsele, neqs, &maxlhs, sizeof(long) );
+         refptr[neqs] = nrefs;
+         lhsele[neqs] = lhs( getlhs(eq), eqsets, cart_subs(cart) );
+         walk( getrhs(eq), eqsets, cart_subs(cart) );
+         neqs++;
+         xarena_reset(XA_EQUATION);
+         }
+      cart = cart_close(cart);
+      }
+   refptr = (long *) grow( refptr, neqs+1, &maxptr, sizeof(long) );
+   refptr[neqs] = nrefs;
+
+   //
+   //  match each element to the first equation defining it
+   //
+
+   unmatched = 0;
+   for( e=0 ; e<neqs ; e++ )
+      if( lhsele[e] >= 0 && ele[lhsele[e]].defby < 0 )
+         ele[lhsele[e]].defby = e;
+      else
+         unmatched++;
+
+   //
+   //  turn the references into edges in place, dropping elements
+   //  no equation defines and repeated edges
+   //
+
+   next = (long *) xmalloc( (int) ((neqs+1)*sizeof(long)) );
+   for( e=0 ; e<neqs ; e++ )
+      next[e] = -1;
+
+   nedges = 0;
+   for( e=0 ; e<neqs ; e++ )
+      {
+      i = refptr[e];
+      refptr[e] = nedges;
+      for( ; i<refptr[e+1] ; i++ )
+         {
+         f = ele[refs[i]].defby;
+         if( f < 0 || next[f] == e )
+            continue;
+         next[f] = e;
+         refs[nedges++] = f;
+         }
+      }
+   refptr[neqs] = nedges;
+
+   //
+   //  Tarjan's algorithm, with an explicit call stack: next holds
+   //  the position of the next edge to follow from each equation
+   //  on the call stack
+   //
+
+   index    = (long *) xmalloc( (int) ((neqs+1)*sizeof(long)) );
+   low      = (long *) xmalloc( (int) ((neqs+1)*sizeof(long)) );
+   call     = (long *) xmalloc( (int) ((neqs+1)*sizeof(long)) );
+   stack    = (long *) xmalloc( (int) ((neqs+1)*sizeof(long)) );
+   members  = (long *) xmalloc( (int) ((neqs+1)*sizeof(long)) );
+   blockptr = (long *) xmalloc( (int) ((neqs+1)*sizeof(long)) );
+   onstack  = (char *) xmalloc( (int) (neqs+1) );
+
+   for( e=0 ; e<neqs ; e++ )
+      {
+      index[e]   = -1;
+      onstack[e] = 0;
+      }
+
+   counter = 0;
+   nmem    = 0;
+   nblocks = 0;
+   sp      = 0;
+
+   for( e=0 ; e<neqs ; e++ )
+      {
+      if( index[e] >= 0 )
+         continue;
+
+      index[e] = low[e] = counter++;
+      next[e] = refptr[e];
+      stack[sp++] = e;
+      onstack[e] = 1;
+      call[0] = e;
+      top = 1;
+
+      while( top )
+         {
+         v = call[top-1];
+
+         if( next[v] < refptr[v+1] )
+            {
+            w = refs[next[v]++];
+            if( index[w] < 0 )
+               {
+               index[w] = low[w] = counter++;
+               next[w] = refptr[w];
+               stack[sp++] = w;
+               onstack[w] = 1;
+               call[top++] = w;
+               }
+            else if( onstack[w] && index[w] < low[v] )
+               low[v] = index[w];
+            continue;
+            }
+
+         top--;
+         if( top && low[v] < low[call[top-1]] )
+            low[call[top-1]] = low[v];
+
+         if( low[v] == index[v] )
+            {
+            blockptr[nblocks++] = nmem;
+            do
+               {
+               w = stack[--sp];
+               onstack[w] = 0;
+               members[nmem++] = w;
+               }
+            while( w != v );
+            }
+         }
+      }
+   blockptr[nblocks] = nmem;
+
+   //
+   //  write the blocks
+   //
+
+   fname = concat(2, basename, "_blocks.csv");
+   out = outfile_open(fname);
+   if( out == 0 )
+      fatal_error("Could not open blocks file %s\n", fname);
+   free(fname);
+
+   fprintf(out,"block,equation,lhs,dt,kind\n");
+
+   nrecursive = 0;
+   nsimblocks = 0;
+   nsimeqs    = 0;
+   largest    = 0;
+
+   for( i=0 ; i<nblocks ; i++ )
+      {
+      v = blockptr[i+1] - blockptr[i];
+      qsort( &members[blockptr[i]], v, sizeof(long), bynumber );
+
+      simultaneous = v > 1;
+      if( !simultaneous )
+         {
+         e = members[blockptr[i]];
+         for( j=refptr[e] ; j<refptr[e+1] ; j++ )
+            if( refs[j] == e )
+               simultaneous = 1;
+         }
+
+      if( simultaneous )
+         {
+         nsimblocks++;
+         nsimeqs += v;
+         }
+      else
+         nrecursive++;
+
+      if( v > largest )
+         largest = v;
+
+      for( j=blockptr[i] ; j<blockptr[i+1] ; j++ )
+         {
+         e = members[j];
+         if( lhsele[e] >= 0 )
+            fprintf(out,"%ld,%ld,\"%s\",%d,%s\n",i+1,e+1,
+               ele[lhsele[e]].text,ele[lhsele[e]].dt,
+               simultaneous ? "simultaneous" : "recursive");
+         else
+            fprintf(out,"%ld,%ld,,,%s\n",i+1,e+1,
+               simultaneous ? "simultaneous" : "recursive");
+         }
+      }
+
+   outfile_close(out);
+
+   fprintf(info,"\nBlock Structure:\n\n");
+   fprintf(info,"   Scalar equations:        %ld\n",neqs);
+   fprintf(info,"   Blocks:                  %ld\n",nblocks);
+   fprintf(info,"   Recursive equations:     %ld\n",nrecursive);
+   fprintf(info,"   Simultaneous blocks:     %ld, with %ld equations\n",nsimblocks,nsimeqs);
+   fprintf(info,"   Largest block:           %ld equations\n",largest);
+   fprintf(info,"   Unmatched left sides:    %ld\n",unmatched);
+
+   //
+   //  tidy up
+   //
+
+   for( i=0 ; i<nele ; i++ )
+      xfree( ele[i].text );
+   if( ele )xfree( ele );
+   if( refs )xfree( refs );
+   xfree( refptr );
+   if( lhsele )xfree( lhsele );
+   xfree( index );
+   xfree( low );
+   xfree( next );
+   xfree( call );
+   xfree( stack );
+   xfree( members );
+   xfree( blockptr );
+   xfree( onstack );
+   freedict( elekeys );
+   sb_free( &key );
+
+   ele = 0; refs = 0; refptr = 0; lhsele = 0; elekeys = 0;
+   nele = maxele = nrefs = maxrefs = neqs = maxptr = maxlhs = 0;
+}
@@ -0,0 +1,16 @@
+/* depgraph.h
+ *
+ * Header file for finding the block structure of a model's
+ * scalar equations.
+ */
+
+#ifndef DEPGRAPH_H
+#define DEPGRAPH_H
+
+//
+//  Function prototypes
+//
+
+void depgraph_write(char *basename);
+
+#endif /* DEPGRAPH_H */
@@ -0,0 +1,702 @@
+/*-------------------------------------------------------------------*
+ *  deriv.c
+ *
+ *  Symbolic differentiation of scalar equations.  deriv_eqn walks
+ *  the node tree of an expression with the same sets and subscripts
+ *  show_node would be given for one scalar equation and works out
+ *  the partial derivative of the expression with respect to every
+ *  element of every variable in it.  Parameters are constants.
+ *  Variable elements are identified by the strings the language
+ *  module's show_symbol produces for them.
+ *
+ *  The derivatives are accumulated in reverse, from the top of the
+ *  tree down, so the tree is only walked once however many variables
+ *  it contains.  Each node is handed the derivative of the whole
+ *  expression with respect to its own value, and passes on to its
+ *  children that times the derivative of its value with respect to
+ *  theirs.  When a variable is reached, what it was handed is added
+ *  to its partial.  Derivatives handed to anything other than a
+ *  variable are stored in numbered temporaries, d1, d2 and so on,
+ *  so no piece of the expression is written out more than a few
+ *  times however deep the tree is.  The caller writes out the
+ *  temporaries, in order, ahead of the partials that use them.
+ *
+ *  Everything is built from pieces of the expression written by the
+ *  language module's show_node, each one in parentheses so that
+ *  precedence never needs to be considered.  Powers and logs are
+ *  written through show_node as well, using nodes built on the
+ *  stack, so that each language gets its own notation.  Factors of
+ *  one are dropped, terms that don't involve any variable are never
+ *  generated, and the numbers added to a partial are summed so that
+ *  terms that cancel leave 0, but nothing else is simplified.
+ *-------------------------------------------------------------------*/
+
+#include "deriv.h"
+
+#include "codegen.h"
+#include "dict.h"
+#include "error.h"
+#include "intern.h"
+#include "options.h"
+#include "output.h"
+#include "sets.h"
+#include "str.h"
+#include "sym.h"
+#include "symtable.h"
+#include "xmalloc.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define myDEBUG 1
+
+//
+//  The temporaries of the current equation, one expression per
+//  line, and its variables and their partials in the order they
+//  were first reached.  wrtdict maps a variable to its position
+//  plus one.  Terms that are plain numbers are summed separately
+//  and put back, where the first of them was, by deriv_eqn.
+//
+
+typedef struct
+   {
+   double value;           // sum of the numbers
+   int n;                  // how many there were
+   int at;                 // length of the partial at the first
+   }
+   Numsum;
+
+static Strbuf temps = SB_INIT;
+static int ntemps = 0;
+
+static char **wrt = 0;
+static Strbuf *part = 0;
+static Numsum *nums = 0;
+static int nwrt = 0;
+static int maxwrt = 0;
+static void *wrtdict = 0;
+
+static void radj(Node *, List *, List *, char *);
+
+//
+//  Private methods
+//
+
+/*-------------------------------------------------------------------*
+ *  cut
+ *
+ *  Drop everything written to a string builder after position len.
+ *-------------------------------------------------------------------*/
+static void cut( Strbuf *out, int len )
+{
+   out->len = len;
+   out->str[len] = '\0';
+}
+
+
+/*-------------------------------------------------------------------*
+ *  stacknode
+ *
+ *  Fill in a node that only lives long enough to be shown.
+ *-------------------------------------------------------------------*/
+static Node *stacknode( Node *nde, Nodetype type, char *str, Node *l, Node *r )
+{
+   nde->obj    = NODEOBJ;
+   nde->str    = str;
+   nde->type   = type;
+   nde->l      = l;
+   nde->r      = r;
+   nde->domain = 0;
+   nde->undec  = 0;
+   nde->lhs    = 0;
+   nde->dt     = 0;
+   return nde;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  inner
+ *
+ *  Look through lag(), lead() and domain nodes.
+ *-------------------------------------------------------------------*/
+static Node *inner( Node *cur )
+{
+   while( cur->type == lag || cur->type == led || cur->type == dom )
+      cur = cur->type == dom ? cur->l : cur->r ;
+   return cur;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  hasvars
+ *
+ *  Return 1 if an expression refers to any variable.
+ *-------------------------------------------------------------------*/
+static int hasvars( Node *cur )
+{
+   void *sym;
+
+   if( cur == 0 )return 0;
+
+   switch( cur->type )
+      {
+      case nam:
+         sym = lookup(cur->str);
+         return sym && istype(sym,var);
+
+      case num:
+         return 0;
+
+      case dom:
+         return hasvars(cur->l);
+
+      case sum:
+      case prd:
+         return hasvars(cur->r);
+
+      default:
+         return hasvars(cur->l) || hasvars(cur->r);
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  isatomic
+ *
+ *  Return 1 if a string is a name, number or vector element, with
+ *  or without a minus sign, and so can be used anywhere without
+ *  parentheses.
+ *-------------------------------------------------------------------*/
+static int isatomic( char *str )
+{
+   char *c;
+
+   c = *str == '-' ? str+1 : str ;
+   if( *c == '\0' )return 0;
+
+   for( ; *c ; c++ )
+      if( !isalnum((unsigned char)*c) && strchr("_.[]",*c) == 0 )
+         return 0;
+
+   return 1;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  show
+ *
+ *  Write an expression, in parentheses unless it is a name, number
+ *  or function call.
+ *-------------------------------------------------------------------*/
+static void show( Strbuf *out, Node *cur, List *setlist, List *sublist )
+{
+   int bare;
+
+   switch( inner(cur)->type )
+      {
+      case nam:
+      case num:
+      case log:
+      case exp:
+      case sum:
+      case prd:
+         bare = 1;
+         break;
+
+      default:
+         bare = 0;
+      }
+
+   if( !bare )sb_add(out,"(");
+   codegen_show_node(out,nul,cur,setlist,sublist);
+   if( !bare )sb_add(out,")");
+}
+
+
+/*-------------------------------------------------------------------*
+ *  term, negterm, times, divide
+ *
+ *  Build the term handed to a child: the derivative handed to its
+ *  parent, possibly negated, times or divided by other pieces of
+ *  the expression.  A term is a product, optionally with a leading
+ *  minus sign, so it can follow a plus or minus without parentheses.
+ *-------------------------------------------------------------------*/
+static void term( Strbuf *e, char *adj )
+{
+   sb_reset(e);
+   sb_add(e,adj);
+}
+
+static void negterm( Strbuf *e, char *adj )
+{
+   sb_reset(e);
+   if( *adj == '-' )
+      sb_add(e,adj+1);
+   else
+      {
+      sb_add(e,"-");
+      sb_add(e,adj);
+      }
+}
+
+static void times( Strbuf *e, Node *cur, List *setlist, List *sublist )
+{
+   if( strcmp(e->str,"1") == 0 )
+      cut(e,0);
+   else if( strcmp(e->str,"-1") == 0 )
+      cut(e,1);
+   else
+      sb_add(e,"*");
+   show(e,cur,setlist,sublist);
+}
+
+static void divide( Strbuf *e, Node *cur, List *setlist, List *sublist )
+{
+   sb_add(e,"/");
+   show(e,cur,setlist,sublist);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  pass
+ *
+ *  Hand a term to a child.  A variable takes it as it is; anything
+ *  else is given a temporary holding it, unless it is atomic.
+ *-------------------------------------------------------------------*/
+static void pass( Node *cur, List *setlist, List *sublist, Strbuf *e )
+{
+   char name[32];
+
+   if( inner(cur)->type == nam || isatomic(e->str) )
+      {
+      radj(cur,setlist,sublist,e->str);
+      return;
+      }
+
+   sb_add(&temps,e->str);
+   sb_add(&temps,"\n");
+   sprintf(name,"d%d",++ntemps);
+
+   radj(cur,setlist,sublist,name);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  numvalue
+ *
+ *  Return 1 and set *v if a string is a number, with or without a
+ *  minus sign.
+ *-------------------------------------------------------------------*/
+static int numvalue( char *str, double *v )
+{
+   char *c,*end;
+
+   c = *str == '-' ? str+1 : str ;
+   if( !isdigit((unsigned char) *c) && *c != '.' )
+      return 0;
+
+   *v = strtod(c,&end);
+   if( *end != '\0' )
+      return 0;
+
+   if( *str == '-' )*v = -*v;
+   return 1;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  accumulate
+ *
+ *  Add a term to the partial with respect to a variable element.
+ *  Numbers are added to its sum rather than written out.
+ *-------------------------------------------------------------------*/
+static void accumulate( char *ref, char *adj )
+{
+   char **bigwrt;
+   Strbuf *bigpart,*p;
+   Numsum *bignums,*q;
+   double v;
+   long k;
+
+   k = (long) getdict(wrtdict,ref);
+   if( k == 0 )
+      {
+      if( nwrt == maxwrt )
+         {
+         maxwrt = maxwrt ? 2*maxwrt : 64 ;
+         bigwrt  = (char **) xmalloc( maxwrt*sizeof(char *) );
+         bigpart = (Strbuf *) xmalloc( maxwrt*sizeof(Strbuf) );
+         bignums = (Numsum *) xmalloc( maxwrt*sizeof(Numsum) );
+         for( k=0 ; k < maxwrt ; k++ )
+            bigpart[k] = k < nwrt ? part[k] : (Strbuf) SB_INIT ;
+         if( nwrt )
+            {
+            memcpy( bigwrt, wrt, nwrt*sizeof(char *) );
+            memcpy( bignums, nums, nwrt*sizeof(Numsum) );
+            xfree( wrt );
+            xfree( part );
+            xfree( nums );
+            }
+         wrt  = bigwrt;
+         part = bigpart;
+         nums = bignums;
+         }
+      wrt[nwrt] = intern(ref);
+      sb_reset(&part[nwrt]);
+      nums[nwrt].value = 0.0;
+      nums[nwrt].n = 0;
+      nums[nwrt].at = 0;
+      k = ++nwrt;
+      putdict(wrtdict,ref,(void *) k);
+      }
+
+   p = &part[k-1];
+   q = &nums[k-1];
+
+   if( numvalue(adj,&v) )
+      {
+      if( q->n++ == 0 )q->at = p->len;
+      q->value += v;
+      }
+   else if( p->len == 0 && q->n == 0 )
+      sb_add(p,adj);
+   else if( *adj == '-' )
+      {
+      sb_add(p," - ");
+      sb_add(p,adj+1);
+      }
+   else
+      {
+      sb_add(p," + ");
+      sb_add(p,adj);
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  addnumbers
+ *
+ *  Put the sum of the numbers in each partial back where the first
+ *  of them was, written with as few digits as give the same value.
+ *  A sum of zero is left out, or is the whole partial if there is
+ *  nothing else.
+ *-------------------------------------------------------------------*/
+static void addnumbers( void )
+{
+   char buf[64],*sign;
+   Strbuf *p;
+   double v;
+   int k,digits,minus;
+
+   for( k=0 ; k < nwrt ; k++ )
+      {
+      if( nums[k].n == 0 )
+         continue;
+
+      p = &part[k];
+      v = nums[k].value;
+
+      if( v != 0.0 )
+         {
+         if( nums[k].at == 0 )
+            sign = v < 0 ? "-" : "" ;
+         else
+            sign = v < 0 ? " - " : " + " ;
+         if( v < 0 )v = -v;
+         for( digits=1 ; digits < 17 ; digits++ )
+            {
+            sprintf(buf,"%.*g",digits,v);
+            if( strtod(buf,0) == v )break;
+            }
+         sprintf(buf,"%s%.*g",sign,digits,v);
+         sb_insert(p,nums[k].at,buf);
+         }
+      else if( p->len == 0 )
+         sb_add(p,"0");
+      else if( nums[k].at == 0 )
+         {
+         //
+         //  drop the " + " or " - " ahead of what is now the
+         //  first term, keeping a minus sign
+         //
+         minus = p->str[1] == '-';
+         memmove(p->str,p->str+3,p->len-2);
+         p->len -= 3;
+         if( minus )sb_insert(p,0,"-");
+         }
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  sumprd
+ *
+ *  Hand a derivative to the terms of a sum or product.  Each term of
+ *  a product gets it times all of the other terms.
+ *-------------------------------------------------------------------*/
+static void sumprd( Node *cur, List *setlist, List *sublist, char *adj )
+{
+   Strbuf e = SB_INIT;
+   List *augsets,*augsubs,*othsubs,*sumover;
+   Item *ele,*oth;
+   char *lstr;
+
+   if( !is_sum_scalar() )
+      FAULT("Derivatives can only be taken with scalar sums");
+
+   lstr = (cur->l)->str;
+
+   augsets = tmpsequence(XA_EQUATION);
+   catlist(augsets,setlist);
+   addlist(augsets,lstr);
+
+   sumover = setmembers(lstr);
+
+   augsubs = tmpsequence(XA_EQUATION);
+   catlist(augsubs,sublist);
+   addlist(augsubs,sumover->n ? sumover->first->str : "");
+
+   othsubs = tmpsequence(XA_EQUATION);
+   catlist(othsubs,augsubs);
+
+   for( ele=sumover->first ; ele ; ele=ele->next )
+      {
+      setitem(augsubs,augsubs->n-1,ele);
+
+      if( cur->type == sum )
+         {
+         radj(cur->r,augsets,augsubs,adj);
+         continue;
+         }
+
+      term(&e,adj);
+      for( oth=sumover->first ; oth ; oth=oth->next )
+         if( oth != ele )
+            {
+            setitem(othsubs,othsubs->n-1,oth);
+            times(&e,cur->r,augsets,othsubs);
+            }
+      pass(cur->r,augsets,augsubs,&e);
+      }
+
+   sb_free(&e);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  radj
+ *
+ *  Hand the derivative of the whole expression with respect to the
+ *  value of cur down to cur's children.  adj is a term as described
+ *  under term if cur is a variable and is atomic otherwise.
+ *-------------------------------------------------------------------*/
+static void radj( Node *cur, List *setlist, List *sublist, char *adj )
+{
+   Strbuf e = SB_INIT;
+   Node tmp1,tmp2,one;
+   Context mycontext;
+   char *str;
+
+   validate( cur, NODEOBJ, "radj" );
+
+   switch( cur->type )
+      {
+      case num:
+         return;
+
+      case nam:
+         if( !hasvars(cur) )return;
+         mycontext.lhs  = cur->lhs;
+         mycontext.dt   = cur->dt;
+         mycontext.tsub = 0;
+         str = show_symbol(cur->str,cur->domain,setlist,sublist,mycontext);
+         accumulate(str,adj);
+         xrelease(str);
+         return;
+
+      case lag:
+      case led:
+         radj(cur->r,setlist,sublist,adj);
+         return;
+
+      case dom:
+         radj(cur->l,setlist,sublist,adj);
+         return;
+
+      case add:
+      case sub:
+         radj(cur->l,setlist,sublist,adj);
+         if( cur->type == add )
+            radj(cur->r,setlist,sublist,adj);
+         else if( hasvars(cur->r) )
+            {
+            negterm(&e,adj);
+            radj(cur->r,setlist,sublist,e.str);
+            }
+         break;
+
+      case neg:
+         if( hasvars(cur->r) )
+            {
+            negterm(&e,adj);
+            radj(cur->r,setlist,sublist,e.str);
+            }
+         break;
+
+      case mul:
+         if( hasvars(cur->l) )
+            {
+            term(&e,adj);
+            times(&e,cur->r,setlist,sublist);
+            pass(cur->l,setlist,sublist,&e);
+            }
+         if( hasvars(cur->r) )
+            {
+            term(&e,adj);
+            times(&e,cur->l,setlist,sublist);
+            pass(cur->r,setlist,sublist,&e);
+            }
+         break;
+
+      case dvd:
+         if( hasvars(cur->l) )
+            {
+            term(&e,adj);
+            divide(&e,cur->r,setlist,sublist);
+            pass(cur->l,setlist,sublist,&e);
+            }
+         if( hasvars(cur->r) )
+            {
+            negterm(&e,adj);
+            times(&e,cur->l,setlist,sublist);
+            stacknode(&one,num,"2",0,0);
+            divide(&e,stacknode(&tmp1,pow,"^",cur->r,&one),setlist,sublist);
+            pass(cur->r,setlist,sublist,&e);
+            }
+         break;
+
+      case pow:
+
+         //
+         //  d(u^v) = v*u^(v-1)*du + u^v*log(u)*dv
+         //
+
+         if( hasvars(cur->l) )
+            {
+            term(&e,adj);
+            times(&e,cur->r,setlist,sublist);
+            stacknode(&one,num,"1",0,0);
+            stacknode(&tmp2,sub,"-",cur->r,&one);
+            times(&e,stacknode(&tmp1,pow,"^",cur->l,&tmp2),setlist,sublist);
+            pass(cur->l,setlist,sublist,&e);
+            }
+         if( hasvars(cur->r) )
+            {
+            term(&e,adj);
+            times(&e,cur,setlist,sublist);
+            times(&e,stacknode(&tmp1,log,"log",0,cur->l),setlist,sublist);
+            pass(cur->r,setlist,sublist,&e);
+            }
+         break;
+
+      case log:
+         if( hasvars(cur->r) )
+            {
+            term(&e,adj);
+            divide(&e,cur->r,setlist,sublist);
+            pass(cur->r,setlist,sublist,&e);
+            }
+         break;
+
+      case exp:
+         if( hasvars(cur->r) )
+            {
+            term(&e,adj);
+            times(&e,cur,setlist,sublist);
+            pass(cur->r,setlist,sublist,&e);
+            }
+         break;
+
+      case sum:
+      case prd:
+         if( hasvars(cur->r) )
+            sumprd(cur,setlist,sublist,adj);
+         break;
+
+      default:
+         FAULT("Unexpected node type in radj");
+      }
+
+   sb_free(&e);
+}
+
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  deriv_eqn
+ *
+ *  Differentiate the expression at cur with respect to each of the
+ *  variable elements in it.  The results can be retrieved with the
+ *  functions below until deriv_eqn is called again.
+ *-------------------------------------------------------------------*/
+void deriv_eqn( Node *cur, List *setlist, List *sublist )
+{
+   if( cur == 0 )
+      FAULT("Null pointer passed to deriv_eqn");
+
+   validate( setlist, LISTOBJ, "deriv_eqn for setlist" );
+   validate( sublist, LISTOBJ, "deriv_eqn for sublist" );
+
+   sb_reset(&temps);
+   ntemps = 0;
+   nwrt = 0;
+
+   if( wrtdict )freedict(wrtdict);
+   wrtdict = newdict(64);
+
+   radj(cur,setlist,sublist,"1");
+   addnumbers();
+}
+
+
+/*-------------------------------------------------------------------*
+ *  deriv_temps
+ *
+ *  Return the expressions for the temporaries, one per line; the
+ *  first line is d1.  Each may use the temporaries before it.
+ *-------------------------------------------------------------------*/
+char *deriv_temps( void )
+{
+   if( temps.str == 0 )sb_reset(&temps);
+   return temps.str;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  deriv_count, deriv_wrt, deriv_partial
+ *
+ *  Return the number of variable elements found by deriv_eqn, the
+ *  string for the k'th of them and the partial with respect to it.
+ *-------------------------------------------------------------------*/
+int deriv_count( void )
+{
+   return nwrt;
+}
+
+char *deriv_wrt( int k )
+{
+   if( k < 0 || k >= nwrt )
+      FAULT("Invalid index passed to deriv_wrt");
+   return wrt[k];
+}
+
+char *deriv_partial( int k )
+{
+   if( k < 0 || k >= nwrt )
+      FAULT("Invalid index passed to deriv_partial");
+   return part[k].str;
+}
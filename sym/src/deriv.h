@@ -0,0 +1,22 @@
+/* deriv.h
+ *
+ * Header file for symbolic differentiation of scalar equations.
+ */
+
+#ifndef DERIV_H
+#define DERIV_H
+
+#include "lists.h"
+#include "nodes.h"
+
+//
+//  Function prototypes
+//
+
+void  deriv_eqn(Node *cur, List *setlist, List *sublist);
+char* deriv_temps(void);
+int   deriv_count(void);
+char* deriv_wrt(int k);
+char* deriv_partial(int k);
+
+#endif /* DERIV_H */
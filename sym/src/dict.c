@@ -4,36 +4,56 @@
  *
  *  Build and manage a hash table that works more or less like
  *  a Python dictionary.
+ *
+ *  The table uses open addressing with linear probing.  The number
+ *  of slots is always a power of two and the table doubles in size
+ *  whenever the fraction of slots in use would exceed the load
+ *  factor, so the size passed to newdict() is only a hint about
+ *  the number of keys expected.  Keys are compared without regard
+ *  to case, like everything else in the program.
  *-------------------------------------------------------------------*/
 
+#include "dict.h"
+
 #include "error.h"
-#include "assoc.h"
+#include "intern.h"
+#include "lists.h"
 #include "str.h"
 #include "xmalloc.h"
+#include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-#define OBJ_entry 1272
 #define OBJ_table 1273
 
+//
+//  Default maximum load factor, in percent, and the smallest
+//  table that will be allocated
+//
+
+#define DICT_LOAD    70
+#define DICT_MINSIZE 8
 
-typedef unsigned long Hashcode;
+typedef unsigned long long Hashcode;
 
 typedef struct Entry {
-   int obj;
+   Hashcode hash;
    char *key;
    void *object;
-   Array *list;
    } Entry;
 
 typedef struct Table
    {
    int obj;
-   int size;
+   int size;         // number of slots, a power of two
+   int load;         // maximum load factor in percent
    Entry *table;
-   int objects;
-   int nlists;
+   int objects;      // number of keys stored
+   int resizes;      // number of times the table has grown
+   long lookups;     // calls to getdict
+   long probes;      // slots examined by getdict
+   int maxprobe;     // longest probe sequence seen by getdict
    } Table;
 
 //
@@ -43,46 +63,106 @@ typedef struct Table
 /*-------------------------------------------------------------------*
  *  hash_code
  *
- *  Loosely derived from lookup2.c by Bob Jenkins.  Maps about 
- *  18,000 IGEM parameters into 11,000 distinct hash codes.
+ *  64-bit FNV-1a over the key folded to lower case, followed by
+ *  the MurmurHash3 finalizer to spread the low-order bits used
+ *  to pick a slot.
+ *-------------------------------------------------------------------*/
+static Hashcode hash_code( char *str )
+{
+   Hashcode h;
+   unsigned char *c;
+
+   h = 0xcbf29ce484222325ULL;
+   for( c=(unsigned char *) str ; *c ; c++ )
+      {
+      h ^= (Hashcode) tolower(*c);
+      h *= 0x100000001b3ULL;
+      }
+
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdULL;
+   h ^= h >> 33;
+   h *= 0xc4ceb9fe1a85ec53ULL;
+   h ^= h >> 33;
+
+   return h;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  alloc_slots
+ *
+ *  Allocate and clear a vector of slots.
  *-------------------------------------------------------------------*/
-static int hash_code( Table *table, char *str )
+static Entry *alloc_slots( int size )
 {
-   Hashcode a,b,c,code;
-   int slen,i;
+   Entry *table;
+   int i;
+
+   table = (Entry *) xmalloc( size*sizeof(Entry) );
+   for( i=0 ; i < size ; i++ )
+      {
+      table[i].hash   = 0;
+      table[i].key    = 0;
+      table[i].object = 0;
+      }
+
+   return table;
+}
 
-   validate( table, OBJ_table, "hash_code" );
 
-   slen = strlen(str);
+/*-------------------------------------------------------------------*
+ *  find_slot
+ *
+ *  Return the slot holding the key or, if it isn't present, the
+ *  empty slot where it would be stored.
+ *-------------------------------------------------------------------*/
+static Entry *find_slot( Table *tab, char *key, Hashcode hash, int *nprobe )
+{
+   Entry *cur;
+   unsigned int mask,i;
+   int n;
 
-   a = 0x9e3779b9;
-   b = 0;
-   c = 0;
+   mask = tab->size - 1;
+   i = (unsigned int) hash & mask;
 
-   for( i=0 ; i<slen ; i=i+8 )
+   for( n=1 ; ; n++, i=(i+1) & mask )
       {
-      b = str[i];
-      if( i+1 < slen )b = b<<8 | str[i+1];
-      if( i+2 < slen )b = b<<8 | str[i+2];
-      if( i+3 < slen )b = b<<8 | str[i+3];
-      if( i+4 < slen )c =        str[i+4];
-      if( i+5 < slen )c = c<<8 | str[i+5];
-      if( i+6 < slen )c = c<<8 | str[i+6];
-      if( i+7 < slen )c = c<<8 | str[i+7];
-      a = (a-b-c) ^ (c>>13);
-      b = (b-c-a) ^ (a<<8 );
-      c = (c-a-b) ^ (b>>13);
-      a = (a-b-c) ^ (c>>12);
-      b = (b-c-a) ^ (a<<16);
-      c = (c-a-b) ^ (b>>5 );
-      a = (a-b-c) ^ (c>>3 );
-      b = (b-c-a) ^ (a<<10);
-      c = (c-a-b) ^ (b>>15);
+      cur = &tab->table[i];
+      if( cur->key == 0 )break;
+      if( cur->hash == hash && isequal(key,cur->key) )break;
       }
 
-   code = c % table->size;
+   if( nprobe )*nprobe = n;
+   return cur;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  grow
+ *
+ *  Double the number of slots and reinsert every key.
+ *-------------------------------------------------------------------*/
+static void grow( Table *tab )
+{
+   Entry *old,*slot;
+   int oldsize,i;
 
-   return code;
+   old     = tab->table;
+   oldsize = tab->size;
+
+   tab->size  = 2*oldsize;
+   tab->table = alloc_slots( tab->size );
+   tab->resizes++;
+
+   for( i=0 ; i < oldsize ; i++ )
+      if( old[i].key )
+         {
+         slot = find_slot( tab, old[i].key, old[i].hash, 0 );
+         *slot = old[i];
+         }
+
+   xfree( old );
 }
 
 
@@ -103,142 +183,141 @@ static int qcmp( const void *v1, const void *v2 )
 
 /*-------------------------------------------------------------------*
  *  newdict
+ *
+ *  Create a dictionary with room for about 'size' keys before
+ *  it first needs to grow.
  *-------------------------------------------------------------------*/
 void *newdict( int size )
 {
    Table *new;
-   Entry *table;
-   int i;
+   int slots;
 
-   new = (Table *) xmalloc( sizeof(Table) );
-   new->obj       = OBJ_table;
-   new->size      = size;
-   new->table     = (Entry *) xmalloc( size*sizeof(Entry) );
-   new->objects   = 0;
-   new->nlists    = 0;
+   slots = DICT_MINSIZE;
+   while( slots*DICT_LOAD < size*100 )
+      slots *= 2;
 
-   table = new->table;
-   for( i=0 ; i < size ; i++ )
-      {
-      table[i].obj     = OBJ_entry;
-      table[i].key     = 0;
-      table[i].object  = 0;
-      table[i].list    = 0;
-      }
+   new = (Table *) xmalloc( sizeof(Table) );
+   new->obj      = OBJ_table;
+   new->size     = slots;
+   new->load     = DICT_LOAD;
+   new->table    = alloc_slots( slots );
+   new->objects  = 0;
+   new->resizes  = 0;
+   new->lookups  = 0;
+   new->probes   = 0;
+   new->maxprobe = 0;
 
    return new;
 }
 
 
+/*-------------------------------------------------------------------*
+ *  freedict
+ *
+ *  Release a dictionary.  The objects it refers to are untouched.
+ *-------------------------------------------------------------------*/
+void freedict( void *dict )
+{
+   Table *tab;
+
+   tab = (Table *) dict;
+   validate( tab, OBJ_table, "freedict" );
+
+   tab->obj = 0;
+   xfree( tab->table );
+   xfree( tab );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  dictload
+ *
+ *  Set the maximum load factor, in percent, at which the table
+ *  is grown.  Low values trade memory for shorter probes.
+ *-------------------------------------------------------------------*/
+void dictload( void *dict, int percent )
+{
+   Table *tab;
+
+   tab = (Table *) dict;
+   validate( tab, OBJ_table, "dictload" );
+
+   if( percent < 10 || percent > 95 )
+      FAULT("Invalid load factor in dictload");
+
+   tab->load = percent;
+   while( tab->objects*100 > tab->size*tab->load )
+      grow( tab );
+}
+
+
 /*-------------------------------------------------------------------*
  *  putdict
- *  
- *  hash a string and store the associated value in the table.  
- *  note that collisions cause the value to be converted to -1.
+ *
+ *  hash a string and store the associated value in the table.
+ *  each key may only be stored once.
  *-------------------------------------------------------------------*/
-void putdict( Table *tab, char *key, void *object )
+void putdict( void *dict, char *key, void *object )
 {
+   Table *tab;
    Hashcode hash;
-   char *curkey;
-   void *curobj;
-   void *list;
+   Entry *slot;
 
-//  
+//
 //  check for problems
-//  
+//
 
+   tab = (Table *) dict;
    validate( tab, OBJ_table, "putdict" );
    validate( key, 0 , "putdict" );
 
-   tab->objects++;
-
 //
-//  compute the hash code
+//  make room if this key would push the table past its load factor
 //
 
-   hash = hash_code(tab,key);
-      
-//
-//  if no object is there, store this one
-//
+   if( (tab->objects+1)*100 > tab->size*tab->load )
+      grow( tab );
 
-   curkey = tab->table[hash].key;
-   curobj = tab->table[hash].object;
-   if( curkey == 0 )
-      {
-      tab->table[hash].key = xstrdup(key);
-      tab->table[hash].object = object;
-      return;
-      }
-    
 //
-//  there was an object; check for a list and build one if necessary
+//  find the key's slot
 //
 
-   list = tab->table[hash].list;
-   if( list == 0 )
-      {
-      list = newarray();
-      addvalue(list,curkey,curobj);
-      tab->table[hash].list = list;
-      tab->nlists++;
-      }
+   hash = hash_code(key);
+   slot = find_slot( tab, key, hash, 0 );
 
-//
-//  add this object to the list for this code
-//
+   if( slot->key )
+      FAULT("Element already exists when putdict called");
+
+   slot->hash   = hash;
+   slot->key    = intern(key);
+   slot->object = object;
 
-   addvalue(list,key,object);
+   tab->objects++;
 }
 
 
 /*-------------------------------------------------------------------*
  *  getdict
- *  
+ *
  *  Find a string in the table.
  *-------------------------------------------------------------------*/
-void *getdict( Table *tab, char *key )
+void *getdict( void *dict, char *key )
 {
-   Hashcode hash;
-   void *list;
-   char *curkey;
-   void *curobj;
+   Table *tab;
+   Entry *slot;
+   int nprobe;
 
+   tab = (Table *) dict;
    validate( tab, OBJ_table, "getdict" );
    validate( key, 0 , "getdict" );
 
-//
-//  generate the hash code
-//  
-      
-   hash = hash_code(tab,key);
-
-//
-//  look for a list
-//
-
-   list = tab->table[hash].list;
-   if( list )return getvalue(list,key);
+   slot = find_slot( tab, key, hash_code(key), &nprobe );
 
-//
-//  no list; look for a single entry
-//
-
-   curkey = tab->table[hash].key;
-   if( curkey == 0 )return 0;
-
-//
-//  did it match?
-//
-
-   curobj = tab->table[hash].object;
-   if( strcmp(key,curkey)==0 )return curobj;
-   
-//
-//  no match at all
-//
+   tab->lookups++;
+   tab->probes += nprobe;
+   if( nprobe > tab->maxprobe )tab->maxprobe = nprobe;
 
-   return 0;
+   return slot->key ? slot->object : 0;
 }
 
 
@@ -249,14 +328,14 @@ void *getdict( Table *tab, char *key )
  *  qsort for efficiency but then return them via a sequence for
  *  external convenience.
  *-------------------------------------------------------------------*/
-List *getkeys( Table *tab )
+List *getkeys( void *dict )
 {
+   Table *tab;
    List *keys_out;
-   Entry cur;
-   Element *item;
    int i,k;
    char **keys_vec;
 
+   tab = (Table *) dict;
    validate( tab, OBJ_table, "getkeys" );
 
    keys_out = newsequence();
@@ -265,20 +344,11 @@ List *getkeys( Table *tab )
    //  collect the keys into a vector of pointers
    //
 
-   keys_vec = (char **) xmalloc( tab->objects * sizeof(char *) );
+   keys_vec = (char **) xmalloc( (tab->objects+1) * sizeof(char *) );
 
    for( i=0,k=0 ; i < tab->size ; i++ )
-      {
-      cur = tab->table[i];
-      if( cur.list )
-         {
-         for( item=cur.list->first ; item ; item=item->next )
-            keys_vec[k++] = item->name;
-         continue;
-         }
-      if( cur.key )
-         keys_vec[k++] = cur.key;
-      }
+      if( tab->table[i].key )
+         keys_vec[k++] = tab->table[i].key;
 
    if( k != tab->objects )
       FAULT("inconsistent number of keys in getkeys");
@@ -287,7 +357,7 @@ List *getkeys( Table *tab )
    //  sort the pointers
    //
 
-   qsort( keys_vec, k, sizeof(char *), qcmp ); 
+   qsort( keys_vec, k, sizeof(char *), qcmp );
 
    //
    //  load them into a list but without resorting
@@ -296,7 +366,7 @@ List *getkeys( Table *tab )
    for( i=0 ; i<k ; i++ )
       addlist(keys_out,keys_vec[i]);
 
-   // 
+   //
    //  clean up and return
    //
 
@@ -308,13 +378,41 @@ List *getkeys( Table *tab )
 
 /*-------------------------------------------------------------------*
  *  dictinfo
+ *
+ *  Print the size of the table and statistics on probe lengths:
+ *  the distance of each stored key from its home slot, and the
+ *  number of slots examined by lookups so far.
  *-------------------------------------------------------------------*/
-void dictinfo( void *table )
+void dictinfo( void *dict )
 {
    Table *tab;
-   tab = (Table *) table;
-   printf( "Hash size:        %d\n",tab->size    ); 
-   printf( "Hash entries:     %d\n",tab->objects ); 
-   printf( "Hash collisions:  %d\n",tab->nlists  );
-}
+   unsigned int mask,home;
+   long total,dist,maxdist;
+   int i;
 
+   tab = (Table *) dict;
+   validate( tab, OBJ_table, "dictinfo" );
+
+   mask = tab->size - 1;
+   total = 0;
+   maxdist = 0;
+   for( i=0 ; i < tab->size ; i++ )
+      if( tab->table[i].key )
+         {
+         home = (unsigned int) tab->table[i].hash & mask;
+         dist = 1 + (((unsigned int) i - home) & mask);
+         total += dist;
+         if( dist > maxdist )maxdist = dist;
+         }
+
+   printf( "Hash size:        %d\n",tab->size    );
+   printf( "Hash entries:     %d\n",tab->objects );
+   printf( "Hash load:        %.1f%% (max %d%%, grown %d times)\n",
+      100.0*tab->objects/tab->size, tab->load, tab->resizes );
+   if( tab->objects )
+      printf( "Probe length:     %.2f average, %ld max for stored keys\n",
+         (double) total/tab->objects, maxdist );
+   if( tab->lookups )
+      printf( "Lookup probes:    %.2f average, %d max over %ld lookups\n",
+         (double) tab->probes/tab->lookups, tab->maxprobe, tab->lookups );
+}
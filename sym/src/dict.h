@@ -14,9 +14,11 @@
 //
 
 void* newdict(int size);
+void  freedict(void* dict);
 void  putdict(void* dict, char* key, void* obj);
 void* getdict(void* dict, char* key);
 void  dictinfo(void* dict);
+void  dictload(void* dict, int percent);
 List* getkeys(void* dict);
 
 #endif /* DICT_H */
@@ -0,0 +1,94 @@
+/*-------------------------------------------------------------------*
+ *  dictbench.c
+ *
+ *  Micro-benchmark for the dictionary in dict.c.  Builds names
+ *  shaped like the scalar names collected by saw_scalar() in the
+ *  debug module, e.g. "QX(r12,g3,r7)", stores them in a dictionary
+ *  and then times lookups of keys that are present and keys that
+ *  are not.  Not part of sym itself; build it with "make dictbench".
+ *
+ *  Usage: dictbench [number of keys] [load factor in percent]
+ *-------------------------------------------------------------------*/
+
+#include "dict.h"
+#include "xmalloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+FILE *info = 0;
+
+static char *stems[] = {
+   "QX", "PX", "QM", "PM", "YD", "INV", "CAP", "LAB", "WAGE", "EXPORTS"
+   };
+
+#define NSTEMS (int)(sizeof(stems)/sizeof(stems[0]))
+
+static double elapsed( clock_t start )
+{
+   return (double)(clock()-start)/CLOCKS_PER_SEC;
+}
+
+int main( int argc, char *argv[] )
+{
+   void *dict;
+   char **keys,buf[80];
+   int nkeys,load,i,found,reps,r;
+   clock_t start;
+
+   info = stdout;
+
+   nkeys = argc > 1 ? atoi(argv[1]) : 300000 ;
+   load  = argc > 2 ? atoi(argv[2]) : 0 ;
+   reps  = 5;
+
+   if( nkeys <= 0 )
+      {
+      fprintf(stderr,"dictbench: invalid number of keys\n");
+      return 1;
+      }
+
+   //
+   //  build the names in advance so only the dictionary is timed
+   //
+
+   keys = (char **) xmalloc( 2*nkeys*sizeof(char *) );
+   for( i=0 ; i < 2*nkeys ; i++ )
+      {
+      sprintf(buf,"%s(r%d,g%d,r%d)",
+         stems[i % NSTEMS], (i/NSTEMS) % 40, (i/(NSTEMS*40)) % 60,
+         i/(NSTEMS*40*60) );
+      keys[i] = xstrdup(buf);
+      }
+
+   //
+   //  start from a small hint so the timing includes growth
+   //
+
+   dict = newdict(100);
+   if( load )dictload(dict,load);
+
+   start = clock();
+   for( i=0 ; i < nkeys ; i++ )
+      putdict(dict,keys[i],keys[i]);
+   printf("Inserted %d keys: %.3f sec\n",nkeys,elapsed(start));
+
+   start = clock();
+   found = 0;
+   for( r=0 ; r < reps ; r++ )
+      for( i=0 ; i < nkeys ; i++ )
+         if( getdict(dict,keys[i]) )found++;
+   printf("Looked up %d present keys: %.3f sec (%d found)\n",
+      reps*nkeys,elapsed(start),found);
+
+   start = clock();
+   found = 0;
+   for( r=0 ; r < reps ; r++ )
+      for( i=nkeys ; i < 2*nkeys ; i++ )
+         if( getdict(dict,keys[i]) )found++;
+   printf("Looked up %d absent keys: %.3f sec (%d found)\n",
+      reps*nkeys,elapsed(start),found);
+
+   dictinfo(dict);
+   return 0;
+}
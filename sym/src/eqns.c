@@ -141,6 +141,35 @@ void *nexteqn(void *vcur)
 }
 
 
+/*-------------------------------------------------------------------*
+ *  dropeqn
+ *
+ *  Remove an equation from the list so that firsteqn and nexteqn
+ *  no longer return it.  Its number is left unchanged.
+ *-------------------------------------------------------------------*/
+void dropeqn(void *vcur)
+{
+   Equation *eq;
+
+   validate( vcur, EQSIG, "dropeqn");
+
+   if( first == vcur )
+      {
+      first = first->next;
+      return;
+      }
+
+   for( eq = first ; eq ; eq = eq->next )
+      if( eq->next == vcur )
+         {
+         eq->next = eq->next->next;
+         return;
+         }
+
+   FAULT("Equation not found in dropeqn");
+}
+
+
 /*-------------------------------------------------------------------*
  *  getnode
  *-------------------------------------------------------------------*/
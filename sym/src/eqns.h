@@ -19,6 +19,7 @@ int   istimeok(void*);
 int   num_eqns(void);
 void  build_context(void);
 void  check_equations();
+void  dropeqn(void*);
 void  neweqn(Node*,Node*,Node*,Node*,Node*,Node*);
 void* firsteqn(void);
 void* nexteqn(void*);
@@ -0,0 +1,144 @@
+"""
+Benchmark for the C target: time a full evaluation of a model's
+equations with the python target's Equations class and with the
+shared library built from the C target's output, and check that
+both give the same results.  Not part of sym itself.
+
+Usage:
+
+    sym -python model.sym eqs.py
+    sym -c model.sym eqs_c.c
+    make -f <sym's makefile> eqs_c.so
+    python3 evalbench.py eqs.py eqs_c_ctypes.py [repetitions]
+
+The right side vectors and parameters are filled with values
+between 0.5 and 1.5, and the derived constants of files written
+with -hoist are computed once, outside the timings.  gcubed and
+numpy aren't needed: if they can't be imported, empty stand-ins
+are used, which is enough for the equations themselves, and the
+vectors are always arrays from the standard array module.
+"""
+
+import array
+import importlib.util
+import math
+import random
+import sys
+import time
+import types
+
+
+def load(path, name):
+    spec = importlib.util.spec_from_file_location(name, path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def stub_imports():
+    try:
+        import numpy  # noqa: F401
+    except ImportError:
+        sys.modules["numpy"] = types.ModuleType("numpy")
+
+    try:
+        import gcubed.base_equations  # noqa: F401
+        return
+    except ImportError:
+        pass
+
+    class BaseEquations:
+        pass
+
+    gcubed = types.ModuleType("gcubed")
+    base = types.ModuleType("gcubed.base_equations")
+    base.BaseEquations = BaseEquations
+    gcubed.base_equations = base
+    sys.modules["gcubed"] = gcubed
+    sys.modules["gcubed.base_equations"] = base
+
+
+class Vectors:
+    pass
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+
+    reps = int(sys.argv[3]) if len(sys.argv) > 3 else 5
+
+    stub_imports()
+    equations = load(sys.argv[1], "bench_equations").Equations
+    native = load(sys.argv[2], "bench_ctypes").NativeEquations()
+
+    random.seed(1)
+    vectors = Vectors()
+    for name, n in native.lengths.items():
+        values = [random.uniform(0.5, 1.5) for _ in range(max(n, 1))]
+        setattr(vectors, name, array.array("d", values))
+
+    outputs = ("x1l", "j1l", "zel", "z1l")
+    functions = [
+        f for name, f in vars(equations).items()
+        if callable(f) and name.split("_")[0] in outputs and name.split("_")[-1].isdigit()
+    ]
+
+    #
+    #  the python target's equations, with the vectors as attributes
+    #  of the instance as BaseEquations would make them
+    #
+
+    model = object.__new__(equations)
+    for name in native.lengths:
+        try:
+            setattr(model, name, getattr(vectors, name))
+        except AttributeError:
+            setattr(model, "_" + name.upper(), getattr(vectors, name))
+    if hasattr(model, "precompute_parameters"):
+        model.precompute_parameters()
+
+    failed = 0
+    start = time.perf_counter()
+    for _ in range(reps):
+        for f in functions:
+            try:
+                f(model)
+            except (ValueError, OverflowError, ZeroDivisionError):
+                failed += 1
+    python_time = (time.perf_counter() - start) / reps
+    expected = {name: list(getattr(vectors, name)) for name in outputs}
+
+    #
+    #  the shared library, writing to fresh left side vectors
+    #
+
+    for name in outputs:
+        setattr(vectors, name, array.array("d", [math.nan] * max(native.lengths[name], 1)))
+
+    if hasattr(native, "precompute_parameters"):
+        native.precompute_parameters(vectors)
+    start = time.perf_counter()
+    for _ in range(reps):
+        native.evaluate(vectors)
+    native_time = (time.perf_counter() - start) / reps
+
+    worst = 0.0
+    compared = 0
+    for name in outputs:
+        for a, b in zip(expected[name][:native.lengths[name]], getattr(vectors, name)):
+            if math.isfinite(a) and math.isfinite(b):
+                worst = max(worst, abs(a - b) / max(1.0, abs(a)))
+                compared += 1
+
+    print(f"equations:        {len(functions)} python, {native.equation_count} native")
+    print(f"python target:    {python_time * 1000:10.3f} ms per evaluation")
+    print(f"shared library:   {native_time * 1000:10.3f} ms per evaluation")
+    print(f"speedup:          {python_time / native_time:10.1f}x")
+    print(f"largest relative difference over {compared} values: {worst:.3g}")
+    if failed:
+        print(f"python raised math errors in {failed // reps} equations")
+
+
+if __name__ == "__main__":
+    main()
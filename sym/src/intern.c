@@ -0,0 +1,246 @@
+/*-------------------------------------------------------------------*
+ *  intern.c
+ *
+ *  String interning.  intern() returns a single canonical copy of
+ *  each distinct string and internkey() a single canonical copy of
+ *  each string folded to lower case, so two names are equal, ignoring
+ *  case, exactly when their keys are the same pointer.  Interned
+ *  strings live until the program ends and must never be modified
+ *  or freed.
+ *
+ *  The strings themselves are packed into large blocks and are
+ *  found through an open-addressed hash table of pointers that
+ *  doubles when it is more than 70% full.
+ *-------------------------------------------------------------------*/
+
+#include "intern.h"
+
+#include "error.h"
+#include "xmalloc.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_BLOCK  65536
+#define POOL_MINTAB 4096
+#define POOL_LOAD   70
+
+typedef unsigned long long Hashcode;
+
+static char **pool_tab  = 0;
+static int   pool_size  = 0;
+static int   pool_used  = 0;
+
+static char *pool_block = 0;
+static int   pool_free  = 0;
+static long  pool_bytes = 0;
+static long  pool_calls = 0;
+
+static char *keybuf  = 0;
+static int   keysize = 0;
+
+//
+//  Private methods
+//
+
+/*-------------------------------------------------------------------*
+ *  hash_string
+ *
+ *  64-bit FNV-1a, case sensitive.
+ *-------------------------------------------------------------------*/
+static Hashcode hash_string( char *str )
+{
+   Hashcode h;
+   unsigned char *c;
+
+   h = 0xcbf29ce484222325ULL;
+   for( c=(unsigned char *) str ; *c ; c++ )
+      {
+      h ^= (Hashcode) *c;
+      h *= 0x100000001b3ULL;
+      }
+
+   return h ^ (h >> 29);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  find_slot
+ *
+ *  Return the slot holding the string or the empty slot where it
+ *  belongs.
+ *-------------------------------------------------------------------*/
+static char **find_slot( char **tab, int size, char *str )
+{
+   unsigned int mask,i;
+   char **cur;
+
+   mask = size - 1;
+   for( i=(unsigned int) hash_string(str) & mask ; ; i=(i+1) & mask )
+      {
+      cur = &tab[i];
+      if( *cur == 0 || strcmp(*cur,str) == 0 )break;
+      }
+
+   return cur;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  grow_table
+ *-------------------------------------------------------------------*/
+static void grow_table( void )
+{
+   char **old,**slot;
+   int oldsize,i;
+
+   old     = pool_tab;
+   oldsize = pool_size;
+
+   pool_size = oldsize ? 2*oldsize : POOL_MINTAB ;
+   pool_tab  = (char **) xmalloc( pool_size*sizeof(char *) );
+   memset( pool_tab, 0, pool_size*sizeof(char *) );
+
+   for( i=0 ; i < oldsize ; i++ )
+      if( old[i] )
+         {
+         slot = find_slot( pool_tab, pool_size, old[i] );
+         *slot = old[i];
+         }
+
+   if( old )xfree( old );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  store
+ *
+ *  Copy a string into the current block, starting a new block when
+ *  it won't fit.  Strings longer than a block get their own.
+ *-------------------------------------------------------------------*/
+static char *store( char *str )
+{
+   char *new;
+   int len;
+
+   len = strlen(str) + 1;
+
+   if( len > POOL_BLOCK/4 )
+      new = (char *) xmalloc( len );
+   else
+      {
+      if( len > pool_free )
+         {
+         pool_block = (char *) xmalloc( POOL_BLOCK );
+         pool_free  = POOL_BLOCK;
+         }
+      new = pool_block;
+      pool_block += len;
+      pool_free  -= len;
+      }
+
+   memcpy( new, str, len );
+   pool_bytes += len;
+   return new;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  fold
+ *
+ *  Copy a string to a scratch buffer in lower case.
+ *-------------------------------------------------------------------*/
+static char *fold( char *str )
+{
+   char *k;
+   int len;
+
+   len = strlen(str) + 1;
+   if( len > keysize )
+      {
+      if( keybuf )xfree( keybuf );
+      keysize = len > 256 ? 2*len : 256 ;
+      keybuf  = (char *) xmalloc( keysize );
+      }
+
+   for( k=keybuf ; *str ; str++ )
+      *k++ = tolower( (unsigned char) *str );
+   *k = 0;
+
+   return keybuf;
+}
+
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  intern
+ *
+ *  Return the canonical copy of a string, adding it if necessary.
+ *-------------------------------------------------------------------*/
+char *intern( char *str )
+{
+   char **slot;
+
+   if( str == 0 )
+      fatal_error("Null pointer passed to %s","intern");
+   pool_calls++;
+
+   if( (pool_used+1)*100 > pool_size*POOL_LOAD )
+      grow_table();
+
+   slot = find_slot( pool_tab, pool_size, str );
+
+   if( *slot == 0 )
+      {
+      *slot = store(str);
+      pool_used++;
+      }
+
+   return *slot;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  internkey
+ *
+ *  Return the canonical lower case copy of a string.
+ *-------------------------------------------------------------------*/
+char *internkey( char *str )
+{
+   if( str == 0 )
+      fatal_error("Null pointer passed to %s","internkey");
+   return intern( fold(str) );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  findkey
+ *
+ *  Like internkey but returns 0, and adds nothing, if no string
+ *  folding to the same key has been interned.
+ *-------------------------------------------------------------------*/
+char *findkey( char *str )
+{
+   if( str == 0 )
+      fatal_error("Null pointer passed to %s","findkey");
+   pool_calls++;
+
+   if( pool_size == 0 )return 0;
+
+   return *find_slot( pool_tab, pool_size, fold(str) );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  intern_stats
+ *-------------------------------------------------------------------*/
+void intern_stats( void )
+{
+   printf("Interned strings: %d (%ld bytes, %d slots)\n",
+      pool_used, pool_bytes, pool_size );
+   printf("Intern calls:     %ld\n",pool_calls);
+}
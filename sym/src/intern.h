@@ -0,0 +1,9 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+char *intern(char*);
+char *internkey(char*);
+char *findkey(char*);
+void  intern_stats(void);
+
+#endif /* INTERN_H */
@@ -20,7 +20,7 @@ char* (*codegen_show_symbol)();
 void  (*codegen_wrap_write )();
 void  (*codegen_write_file )();
 void  (*codegen_show_eq    )();
-char *(*codegen_show_node  )();
+void  (*codegen_show_node  )();
 char* (*codegen_spprint    )();
 
 static Array *langinit=0;
@@ -136,7 +136,7 @@ void lang_show_symbol(char* (*fnc)())
    codegen_show_symbol = fnc;
 }
 
-void lang_show_node(char *(*fnc)())
+void lang_show_node(void (*fnc)())
 {
    codegen_show_node = fnc;
 }
@@ -11,7 +11,7 @@ void lang_end_eqn( void (*fnc)()  );
 void lang_end_file( void (*fnc)()  );
 void lang_end_func( char* (*fnc)() );
 void lang_show_symbol( char* (*fnc)() );
-void lang_show_node( char* (*fnc)() );
+void lang_show_node( void (*fnc)() );
 void lang_show_eq( void (*fnc)());
 void lang_write_file( void (*fnc)());
 void lang_wrap_write(void (*fnc)());
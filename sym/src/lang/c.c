@@ -0,0 +1,1051 @@
+/*--------------------------------------------------------------------*
+ * c.c
+ *--------------------------------------------------------------------*
+.. ### c
+..
+.. Write the equations of a G-Cubed model as a C source file that can
+.. be compiled into a shared library and called from Python.
+..
+.. + Variables are mapped into the same MSGPROC vectors, at the same
+..   offsets, as the python target.
+ *--------------------------------------------------------------------*
+ *
+ *  The C file defines one entry point,
+ *
+ *     evaluate(x1r, j1r, z1r, zer, yjr, yxr, exo, exz, par,
+ *              x1l, j1l, zel, z1l)
+ *
+ *  taking the right side vectors and parameters and filling in the
+ *  left side vectors, with the arguments in the order used by
+ *  gcubed's BaseEquations.  Every equation of the model is
+ *  evaluated once, in the order the python target writes them.
+ *  j1r isn't used by any equation and is only there to keep the
+ *  argument list the same as gcubed's.
+ *
+ *  The equations are split, in order, among static functions of a
+ *  hundred or so equations each, which take the same arguments as
+ *  evaluate so that the equations read exactly like the python
+ *  target's without "self.".  The file also defines
+ *
+ *     vector_length(name)   number of elements in a vector, or -1
+ *     equation_count()      number of scalar equations
+ *
+ *  With -cse, the equations of each block that fall in the same
+ *  function share their common subexpressions.  These are written
+ *  as constants in a brace-enclosed scope ahead of the equations.
+ *  With -simplify, equations whose right sides reduce to a number
+ *  are written as a table of left side elements and values, which
+ *  evaluate copies into place before calling the parts.
+ *
+ *  With -hoist, subexpressions of parameters and numbers alone are
+ *  replaced by elements of a static vector of derived constants,
+ *  derived, which the parts take as an extra argument named pre.
+ *  It is filled by a second entry point,
+ *
+ *     precompute_parameters(par)
+ *     parameters_ready()    1 once precompute_parameters has run
+ *
+ *  which must be called whenever the parameters change and before
+ *  evaluate.  The loader's evaluate raises an error if it hasn't.
+ *  Every derived constant is computed on each call, whether or not
+ *  the equations using it are of interest.
+ *
+ *  The makefile's %.so rule builds the shared library.  A Python
+ *  module named after the output file with a "_ctypes" suffix is
+ *  written alongside it; its NativeEquations class loads the library
+ *  and evaluates the model for any object with the vectors as
+ *  attributes, such as an instance of the python target's Equations.
+ *--------------------------------------------------------------------*/
+
+#include "../codegen.h"
+#include "../cse.h"
+#include "../eqns.h"
+#include "../error.h"
+#include "../lang.h"
+#include "../options.h"
+#include "../outfile.h"
+#include "../output.h"
+#include "../sets.h"
+#include "../str.h"
+#include "../sym.h"
+#include "../symtable.h"
+#include "../xmalloc.h"
+#include "msgvec.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define myDEBUG 1
+
+#define now(arg) (cur->type == arg)
+
+//
+//  Flag for checking local variable objects for corruption
+//
+
+#define CVAROBJ 5001
+
+//
+//  Subscript origin for output array references.  Must match the
+//  python target.
+//
+
+#define C_ORIGIN 0
+
+//
+//  Most equations written to one function.  Compilers take far
+//  longer over a few huge functions than many small ones.
+//
+
+#define C_PART_EQNS 100
+
+//
+//  Internal variables.  The equations are written to a series of
+//  functions, or parts; C_part is the number of the current one
+//  and C_parteqns the number of equations written to it.
+//
+
+static int C_block = 1;
+static int C_scalar = 1;
+static int C_part = 0;
+static int C_parteqns = 0;
+
+//
+//  Python module holding the ctypes loader
+//
+
+static FILE *c_loader;
+
+//
+//  Equations held back for -cse until the rest of their block, or
+//  the part of it in the current function, has been seen: the left
+//  side of each, one per line, and its right side from cse_add.
+//
+
+static Strbuf c_lhs = SB_INIT;
+static int *c_roots = 0;
+static int c_nroots = 0;
+static int c_maxroots = 0;
+
+//
+//  Entries of the table of constant equations for -simplify, and
+//  their number
+//
+
+static Strbuf c_consts = SB_INIT;
+static int c_nconsts = 0;
+
+//
+//  MSGPROC vectors
+//
+
+static int vecinfo[UNK + 1];
+static char *vecname[UNK + 1];
+
+//
+//  Arguments of evaluate, in order: the right side vectors and then
+//  the left side ones.  Each is given with the MSGPROC vector whose
+//  length it has, or NUL for j1r, which no equation uses.
+//
+
+static char *argname[] =
+    {"x1r", "j1r", "z1r", "zer", "yjr", "yxr", "exo", "exz", "par",
+     "x1l", "j1l", "zel", "z1l", 0};
+
+static int argvec[] =
+    {X1R, NUL, Z1R, ZER, YJR, YXR, EXO, EXZ, PAR,
+     X1L, J1L, ZEL, Z1L};
+
+#define C_NINPUTS 9
+
+//
+//  Define the variable object and the registry used to find it
+//
+
+struct variable
+{
+   int obj;         // fidelity check
+   char *str;       // variable's name
+   char *type;      // variable's type
+   int vecid[6];    // vector id number for each context
+   int vecoff[6];   // offset from start of vector
+};
+
+typedef struct variable Variable;
+static void *v_reg = 0;
+
+//----------------------------------------------------------------------//
+//  Function prototypes
+//----------------------------------------------------------------------//
+
+static void msg_error(char *, char *);
+static int veclength(int);
+static void flush_eqns(void);
+static void add_const(char *, int, int);
+static void next_part(void);
+static void write_args(int);
+
+//----------------------------------------------------------------------//
+//  msg_error()
+//
+//  Print an error message and crash, noting that the problem was
+//  with the C back end.
+//----------------------------------------------------------------------//
+
+static void msg_error(char *fmt, char *str)
+{
+   show_error("Fatal Error Writing C File", fmt, str);
+}
+
+//----------------------------------------------------------------------//
+//  veclength()
+//
+//  Number of elements in a vector.  The right side vectors share
+//  their offsets with the left side vector that drives them and
+//  have the same length.
+//----------------------------------------------------------------------//
+
+static int veclength(int id)
+{
+   switch (id)
+   {
+   case NUL:
+      return 0;
+   case Z1R:
+      id = Z1L;
+      break;
+   case YJR:
+      id = J1L;
+      break;
+   case ZER:
+   case EXZ:
+      id = ZEL;
+      break;
+   case YXR:
+   case X1R:
+      id = X1L;
+      break;
+   default:
+      break;
+   }
+   return vecinfo[id] - C_ORIGIN;
+}
+
+//----------------------------------------------------------------------//
+//  add_const()
+//
+//  Add an equation with a constant right side to the table.  Its
+//  left side, 'len' characters at 'lhs', is an element of one of the
+//  left side vectors, such as "x1l[700]".
+//----------------------------------------------------------------------//
+
+static void add_const(char *lhs, int len, int root)
+{
+   static Strbuf value = SB_INIT;
+   char buf[64], *end;
+   long loc;
+   int i;
+
+   for (i = C_NINPUTS; argname[i]; i++)
+      if (strncmp(lhs, argname[i], strlen(argname[i])) == 0 && lhs[strlen(argname[i])] == '[')
+         break;
+
+   if (argname[i] == 0)
+      FAULT("Left side is not a left side vector element in add_const");
+
+   loc = strtol(lhs + strlen(argname[i]) + 1, &end, 10);
+   if (*end != ']' || end + 1 != lhs + len)
+      FAULT("Badly formed left side in add_const");
+
+   sb_reset(&value);
+   cse_show(&value, root);
+
+   sprintf(buf, "   {%d, %ld, ", i - C_NINPUTS, loc);
+   sb_add(&c_consts, buf);
+   sb_add(&c_consts, value.str);
+   sb_add(&c_consts, "},\n");
+   c_nconsts++;
+}
+
+//----------------------------------------------------------------------//
+//  flush_eqns()
+//
+//  Write the equations held back for -cse or -simplify, with the
+//  temporaries they share.  Equations that reduce to a number go
+//  in the table instead.
+//----------------------------------------------------------------------//
+
+static void flush_eqns(void)
+{
+   static Strbuf rhs = SB_INIT;
+   char *lhs, *end, *indent;
+   int i, k, ntemps;
+
+   if (c_nroots == 0)
+      return;
+
+   ntemps = cse_end();
+   indent = ntemps ? "      " : "   ";
+
+   if (ntemps)
+      fprintf(code, "   {\n");
+
+   for (k = 1; k <= ntemps; k++)
+   {
+      sb_reset(&rhs);
+      cse_temp(&rhs, k);
+      fprintf(code, "      const double %s = %s;\n", cse_name(k), rhs.str);
+   }
+
+   for (i = 0, lhs = c_lhs.str; i < c_nroots; i++, lhs = end + 1)
+   {
+      end = strchr(lhs, '\n');
+      if (do_simplify && cse_constant(c_roots[i]))
+      {
+         add_const(lhs, (int)(end - lhs), c_roots[i]);
+         continue;
+      }
+      sb_reset(&rhs);
+      cse_show(&rhs, c_roots[i]);
+      fprintf(code, "%s%.*s = %s;\n", indent, (int)(end - lhs), lhs, rhs.str);
+   }
+
+   if (ntemps)
+      fprintf(code, "   }\n");
+
+   sb_reset(&c_lhs);
+   c_nroots = 0;
+}
+
+//----------------------------------------------------------------------//
+//  next_part()
+//
+//  Finish the current function, if any, and start the next.
+//----------------------------------------------------------------------//
+
+static void next_part(void)
+{
+   flush_eqns();
+
+   if (C_part)
+      fprintf(code, "}\n");
+
+   C_part++;
+   C_parteqns = 0;
+   fprintf(code, "\nstatic void part_%d(", C_part);
+   write_args(1);
+   if (do_hoist)
+      fprintf(code, ", const double *pre");
+   fprintf(code, ")\n{\n");
+}
+
+//----------------------------------------------------------------------//
+//  write_args()
+//
+//  Write the argument list of evaluate, as declarations if decl is
+//  set and otherwise as the names alone.
+//----------------------------------------------------------------------//
+
+static void write_args(int decl)
+{
+   int i;
+
+   for (i = 0; argname[i]; i++)
+   {
+      if (i)
+         fprintf(code, ", ");
+      if (decl)
+         fprintf(code, "%sdouble *", i < C_NINPUTS ? "const " : "");
+      fprintf(code, "%s", argname[i]);
+   }
+}
+
+//----------------------------------------------------------------------//
+//
+//  Begin processing the file
+//
+//----------------------------------------------------------------------//
+
+void C_begin_file(char *basename)
+{
+   char *fname, *libname;
+   int i;
+
+   for (i = NUL; i <= UNK; i++)
+      vecinfo[i] = C_ORIGIN;
+
+   vecname[NUL] = "";
+   vecname[Z1L] = "z1l";
+   vecname[ZEL] = "zel";
+   vecname[J1L] = "j1l";
+   vecname[X1L] = "x1l";
+   vecname[Z1R] = "z1r";
+   vecname[ZER] = "zer";
+   vecname[YJR] = "yjr";
+   vecname[YXR] = "yxr";
+   vecname[EXO] = "exo";
+   vecname[EXZ] = "exz";
+   vecname[PAR] = "par";
+   vecname[X1R] = "x1r";
+   vecname[UNK] = "";
+
+   fprintf(code, "/*\n");
+   fprintf(code, " *  G-Cubed model equations.  Build a shared library with\n");
+   fprintf(code, " *  \"make <name>.so\" using sym's makefile and load it with\n");
+   fprintf(code, " *  the NativeEquations class in the matching _ctypes.py file.\n");
+   fprintf(code, " */\n\n");
+   fprintf(code, "#include <math.h>\n");
+   fprintf(code, "#include <string.h>\n\n");
+   fprintf(code, "#ifdef _WIN32\n");
+   fprintf(code, "#define EXPORT __declspec(dllexport)\n");
+   fprintf(code, "#else\n");
+   fprintf(code, "#define EXPORT\n");
+   fprintf(code, "#endif\n\n");
+
+   //
+   //  the loader is named after the output file and looks for the
+   //  library next to itself
+   //
+
+   fname = concat(2, basename, "_ctypes.py");
+   c_loader = outfile_open(fname);
+   if (c_loader == 0)
+      msg_error("Could not create file: %s", fname);
+   free(fname);
+
+   libname = basename;
+   for (fname = basename; *fname; fname++)
+      if (*fname == '/' || *fname == '\\')
+         libname = fname + 1;
+
+   fprintf(c_loader, "\"\"\"\n");
+   fprintf(c_loader, "Load the compiled model equations written by sym's C target.\n");
+   fprintf(c_loader, "\"\"\"\n\n");
+   fprintf(c_loader, "import ctypes\n");
+   fprintf(c_loader, "import os\n");
+   fprintf(c_loader, "import sys\n\n");
+   fprintf(c_loader, "VECTORS = (");
+   for (i = 0; argname[i]; i++)
+      fprintf(c_loader, "%s\"%s\"", i ? ", " : "", argname[i]);
+   fprintf(c_loader, ")\n\n");
+   fprintf(c_loader, "LIBRARY = \"%s\" + (\".dll\" if sys.platform == \"win32\" else \".so\")\n", libname);
+   fprintf(c_loader, "\n\n");
+   fprintf(c_loader, "class NativeEquations:\n");
+   fprintf(c_loader, "    \"\"\"\n");
+   fprintf(c_loader, "    Evaluate every model equation at once in the compiled library.\n");
+   fprintf(c_loader, "    The vectors must be contiguous arrays of float64 at least as\n");
+   fprintf(c_loader, "    long as the library expects, and the left side vectors must be\n");
+   fprintf(c_loader, "    writable.\n");
+   fprintf(c_loader, "    \"\"\"\n\n");
+   fprintf(c_loader, "    def __init__(self, library=None):\n");
+   fprintf(c_loader, "        if library is None:\n");
+   fprintf(c_loader, "            library = os.path.join(os.path.dirname(os.path.abspath(__file__)), LIBRARY)\n");
+   fprintf(c_loader, "        self.lib = ctypes.CDLL(library)\n");
+   fprintf(c_loader, "        self.lib.vector_length.argtypes = [ctypes.c_char_p]\n");
+   fprintf(c_loader, "        self.lib.vector_length.restype = ctypes.c_int\n");
+   fprintf(c_loader, "        self.lib.equation_count.restype = ctypes.c_int\n");
+   fprintf(c_loader, "        self.lib.evaluate.restype = None\n");
+   if (do_hoist)
+   {
+      fprintf(c_loader, "        self.lib.precompute_parameters.restype = None\n");
+      fprintf(c_loader, "        self.lib.parameters_ready.restype = ctypes.c_int\n");
+   }
+   fprintf(c_loader, "        self.lengths = {name: self.lib.vector_length(name.encode()) for name in VECTORS}\n");
+   fprintf(c_loader, "        self.equation_count = self.lib.equation_count()\n\n");
+   fprintf(c_loader, "    def _pointer(self, name, equations):\n");
+   fprintf(c_loader, "        n = self.lengths[name]\n");
+   fprintf(c_loader, "        if n == 0:\n");
+   fprintf(c_loader, "            return None\n");
+   fprintf(c_loader, "        vector = getattr(equations, name)\n");
+   fprintf(c_loader, "        view = memoryview(vector)\n");
+   fprintf(c_loader, "        if view.format != \"d\" or not view.c_contiguous:\n");
+   fprintf(c_loader, "            raise TypeError(f\"{name} must be a contiguous array of float64\")\n");
+   fprintf(c_loader, "        if len(view) < n:\n");
+   fprintf(c_loader, "            raise ValueError(f\"{name} has {len(view)} elements but the equations use {n}\")\n");
+   fprintf(c_loader, "        return (ctypes.c_double * n).from_buffer(vector)\n\n");
+   fprintf(c_loader, "    def evaluate(self, equations):\n");
+   fprintf(c_loader, "        \"\"\"\n");
+   fprintf(c_loader, "        Evaluate the equations using the vectors of an object such as\n");
+   fprintf(c_loader, "        an Equations instance, updating its left side vectors in place.\n");
+   fprintf(c_loader, "        \"\"\"\n");
+   if (do_hoist)
+   {
+      fprintf(c_loader, "        if not self.lib.parameters_ready():\n");
+      fprintf(c_loader, "            raise RuntimeError(\"call precompute_parameters before evaluate\")\n");
+   }
+   fprintf(c_loader, "        self.lib.evaluate(*[self._pointer(name, equations) for name in VECTORS])\n");
+
+   if (do_hoist)
+   {
+      cse_hoist("pre");
+      fprintf(c_loader, "\n    def precompute_parameters(self, equations):\n");
+      fprintf(c_loader, "        \"\"\"\n");
+      fprintf(c_loader, "        Compute the derived constants from the parameters of an object\n");
+      fprintf(c_loader, "        such as an Equations instance.  Call whenever the parameters\n");
+      fprintf(c_loader, "        change and before evaluate.  Every constant is computed, so a\n");
+      fprintf(c_loader, "        parameter outside the domain of any of them gives a nan or inf\n");
+      fprintf(c_loader, "        that reaches every equation using that constant.\n");
+      fprintf(c_loader, "        \"\"\"\n");
+      fprintf(c_loader, "        self.lib.precompute_parameters(self._pointer(\"par\", equations))\n");
+   }
+}
+
+//----------------------------------------------------------------------//
+//
+//  End processing the file
+//
+//----------------------------------------------------------------------//
+
+void C_end_file()
+{
+   int i, n, ecount, vcount;
+   int ucount;
+   void *cur;
+   char *err;
+
+   ecount = C_scalar - 1;
+
+   flush_eqns();
+   if (C_part)
+      fprintf(code, "}\n");
+
+   fprintf(code, "\nstatic const char *vector_names[] = {");
+   for (i = 0; argname[i]; i++)
+      fprintf(code, "\"%s\", ", argname[i]);
+   fprintf(code, "0};\n");
+
+   fprintf(code, "static const int vector_lengths[] = {");
+   for (i = 0; argname[i]; i++)
+      fprintf(code, "%d, ", veclength(argvec[i]));
+   fprintf(code, "0};\n\n");
+
+   fprintf(code, "EXPORT int vector_length(const char *name)\n{\n");
+   fprintf(code, "   int i;\n");
+   fprintf(code, "   for (i = 0; vector_names[i]; i++)\n");
+   fprintf(code, "      if (strcmp(name, vector_names[i]) == 0)\n");
+   fprintf(code, "         return vector_lengths[i];\n");
+   fprintf(code, "   return -1;\n}\n\n");
+
+   fprintf(code, "EXPORT int equation_count(void)\n{\n");
+   fprintf(code, "   return %d;\n}\n\n", ecount);
+
+   if (c_nconsts)
+   {
+      fprintf(code, "static const struct\n{\n");
+      fprintf(code, "   int vector;\n");
+      fprintf(code, "   long index;\n");
+      fprintf(code, "   double value;\n");
+      fprintf(code, "} constants[%d] = {\n", c_nconsts);
+      fprintf(code, "%s", c_consts.str);
+      fprintf(code, "};\n\n");
+   }
+
+   //
+   //  derived constants, with at least one element to keep the
+   //  array legal
+   //
+
+   if (do_hoist)
+   {
+      n = cse_derived();
+      fprintf(code, "static double derived[%d];\n", n ? n : 1);
+      fprintf(code, "static int derived_ready = 0;\n\n");
+      fprintf(code, "EXPORT void precompute_parameters(const double *par)\n{\n");
+      for (i = 0; i < n; i++)
+         fprintf(code, "   derived[%d] = %s;\n", i, cse_definition(i));
+      fprintf(code, "   derived_ready = 1;\n");
+      fprintf(code, "}\n\n");
+      fprintf(code, "EXPORT int parameters_ready(void)\n{\n");
+      fprintf(code, "   return derived_ready;\n}\n\n");
+   }
+
+   fprintf(code, "EXPORT void evaluate(");
+   write_args(1);
+   fprintf(code, ")\n{\n");
+   if (c_nconsts)
+   {
+      fprintf(code, "   double *left[] = {");
+      for (i = C_NINPUTS; argname[i]; i++)
+         fprintf(code, "%s%s", i > C_NINPUTS ? ", " : "", argname[i]);
+      fprintf(code, "};\n");
+      fprintf(code, "   int k;\n\n");
+      fprintf(code, "   for (k = 0; k < %d; k++)\n", c_nconsts);
+      fprintf(code, "      left[constants[k].vector][constants[k].index] = constants[k].value;\n");
+   }
+   for (i = 1; i <= C_part; i++)
+   {
+      fprintf(code, "   part_%d(", i);
+      write_args(0);
+      fprintf(code, "%s);\n", do_hoist ? ", derived" : "");
+   }
+   fprintf(code, "}\n");
+
+   outfile_close(c_loader);
+
+   vcount = vecinfo[Z1L] + vecinfo[ZEL] + vecinfo[J1L] + vecinfo[X1L] - 4 * C_ORIGIN;
+
+   fprintf(info, "\nLength of MSGPROC Vectors:\n\n");
+   for (i = NUL + 1; i < UNK; i++)
+      fprintf(info, "   %s has %d elements\n", vecname[i], veclength(i));
+
+   //
+   //  count unused endogenous variables
+   //
+
+   ucount = 0;
+   for (cur = firstsymbol(var); cur; cur = nextsymbol(cur))
+      if (ismember("end", symattrib(cur)) && !isused(cur))
+         ucount += symsize(cur);
+
+   fprintf(info, "\n");
+   fprintf(info, "Equation Count: %d\n", ecount);
+   fprintf(info, "Endogenous Variables, Used:   %d\n", vcount - ucount);
+   fprintf(info, "Endogenous Variables, Total:  %d\n", vcount);
+
+   if (cse_used())
+      cse_report(info);
+
+   //
+   //  crash loudly if there's a mismatch
+   //
+
+   if (ecount != vcount - ucount)
+   {
+      err = "Counts of equations and endogenous variables do not match.";
+      fprintf(info, "\nFatal Error:\n   %s\n", err);
+      msg_error("%s", err);
+   }
+}
+
+//----------------------------------------------------------------------//
+//  C_declare
+//
+//  Add a new variable or parameter to the internal list and reserve
+//  space for it in the MSGPROC vectors, exactly as the python target
+//  does.
+//----------------------------------------------------------------------//
+
+void C_declare(void *sym)
+{
+   char *name;
+   Variable *newvar;
+   List *attlist;
+   char *curtype;
+   int i, found, vi;
+
+   validate(sym, SYMBOBJ, "C_declare");
+
+   if (istype(sym, set))
+      return;
+
+   if (!isident(sym))
+      FAULT("Invalid symbol type passed to C_declare");
+
+   name = symname(sym);
+
+   if (symsize(sym) < 1)
+      FAULT("Symbol has no element count in C_declare");
+
+   newvar = (Variable *)malloc(sizeof(Variable));
+   newvar->obj = CVAROBJ;
+   newvar->str = name;
+
+   //
+   //  find the variable's type; there must be exactly one.
+   //  parameters use the par entry.
+   //
+
+   found = 0;
+   vi = 0;
+
+   attlist = symattrib(sym);
+
+   for (i = 0; (curtype = msgvec_types[i].type); i++)
+   {
+      if (istype(sym, par) && strcmp(curtype, "par") == 0)
+      {
+         found = 1;
+         vi = i;
+         break;
+      }
+
+      if (istype(sym, var) && ismember(curtype, attlist))
+      {
+         if (found)
+            msg_error("Multiple variable types for variable: %s", name);
+         found = 1;
+         vi = i;
+      }
+   }
+
+   if (istype(sym, var) && found == 0)
+      msg_error("No type declared for variable %s", name);
+
+   if (istype(sym, par) && found == 0)
+      FAULT("Failed to find parameter in vlist in C_declare");
+
+   newvar->type = msgvec_types[vi].type;
+
+   msgvec_reserve(&msgvec_types[vi], symsize(sym), vecinfo, newvar->vecid, newvar->vecoff);
+
+   freelist(attlist);
+
+   if (v_reg == 0)
+      v_reg = msgvec_newregistry();
+
+   msgvec_register(v_reg, name, newvar);
+}
+
+//----------------------------------------------------------------------//
+//
+//  Begin an equation block
+//
+//----------------------------------------------------------------------//
+
+void C_begin_block(void *eq)
+{
+   if (islvalue(eq) == 0)
+      msg_error("%s", "LHS of an equation is not a variable");
+
+   flush_eqns();
+   if (C_part == 0 || C_parteqns == C_PART_EQNS)
+      next_part();
+
+   fprintf(code, "   // Equation block %d\n", C_block);
+
+   C_block++;
+   C_scalar += eqncount(eq);
+}
+
+//----------------------------------------------------------------------//
+//
+//  Show a symbol as an element of its MSGPROC vector
+//
+//----------------------------------------------------------------------//
+
+char *C_show_symbol(char *str, List *sublist, Context context)
+{
+   Variable *var;
+   char buf[1024], *ptr;
+   int sel, vecid;
+   long loc;
+
+   if (v_reg == 0)
+      FAULT("Variable list is blank in C_show_symbol");
+
+   var = (Variable *)msgvec_find(v_reg, str);
+   validate(var, CVAROBJ, "C_show_symbol");
+
+   sel = msgvec_select(str, var->type, var->vecid, context, msg_error);
+   vecid = var->vecid[sel];
+   loc = sub_ravel(str, sublist, var->vecoff[sel]);
+
+   sprintf(buf, "%s[%ld]", vecname[vecid], loc);
+
+   ptr = strdup(buf);
+   if (ptr == 0)
+      FAULT("Could not allocate memory in C_show_symbol");
+
+   if (DBG)
+      printf("C_show_symbol: %s\n", ptr);
+
+   return ptr;
+}
+
+//----------------------------------------------------------------------//
+//
+//  Write an equation as an assignment statement, or with -cse hold
+//  it back until flush_eqns
+//
+//----------------------------------------------------------------------//
+
+void C_show_eq(void *eq, List *setlist, List *sublist)
+{
+   static Strbuf all = SB_INIT;
+   Node *getlhs(), *getrhs();
+   int *bigger;
+
+   if (C_parteqns == C_PART_EQNS)
+      next_part();
+   C_parteqns++;
+
+   if (cse_used())
+   {
+      if (c_nroots == 0)
+         cse_begin("t");
+
+      codegen_show_node(&c_lhs, nul, getlhs(eq), setlist, sublist);
+      sb_add(&c_lhs, "\n");
+
+      if (c_nroots == c_maxroots)
+      {
+         c_maxroots = c_maxroots ? 2 * c_maxroots : 256;
+         bigger = (int *)xmalloc(c_maxroots * sizeof(int));
+         if (c_nroots)
+            memcpy(bigger, c_roots, c_nroots * sizeof(int));
+         if (c_roots)
+            xfree(c_roots);
+         c_roots = bigger;
+      }
+      c_roots[c_nroots++] = cse_add(getrhs(eq), setlist, sublist);
+
+      xarena_reset(XA_EQUATION);
+      return;
+   }
+
+   sb_reset(&all);
+   sb_add(&all, "   ");
+   codegen_show_node(&all, nul, getlhs(eq), setlist, sublist);
+   sb_add(&all, " = ");
+   codegen_show_node(&all, nul, getrhs(eq), setlist, sublist);
+
+   fprintf(code, "%s;\n", all.str);
+   xarena_reset(XA_EQUATION);
+}
+
+/*--------------------------------------------------------------------*
+ *  show_node
+ *
+ *  Generate the node recursively, appending it to a string builder
+ *  from left to right.  The same as the python target's except that
+ *  powers are written with pow() and whole numbers get a decimal
+ *  point so that C never does integer arithmetic with them.
+ *--------------------------------------------------------------------*/
+void C_show_node(Strbuf *out, Nodetype prevtype, Node *cur, List *setlist, List *sublist)
+{
+   int parens, wrap_right;
+   List *augsets, *augsubs, *sumover;
+   char *endfunc;
+   char *lstr;
+   char *lpar, *rpar;
+   char *op, *thisop;
+   int isfunc;
+   Context mycontext;
+
+   if (cur == 0)
+      return;
+
+   mycontext.lhs = cur->lhs;
+   mycontext.dt = cur->dt;
+   mycontext.tsub = 0;
+
+   validate(cur, NODEOBJ, "show_node");
+   validate(setlist, LISTOBJ, "show_block for setlist");
+   validate(sublist, LISTOBJ, "show_block for sublist");
+
+   //
+   //  decide whether the current node should be wrapped with
+   //  parentheses, based on the type of the node one step
+   //  higher in the parse tree.  powers are function calls so
+   //  never need them.
+   //
+
+   parens = 0;
+   switch (prevtype)
+   {
+   case nul:
+   case add:
+   case sub:
+      if (now(neg))
+         parens = 1;
+      break;
+
+   case mul:
+      if (now(add) || now(sub))
+         parens = 1;
+      if (now(dvd) || now(neg))
+         parens = 1;
+      break;
+
+   case neg:
+      parens = 1;
+      if (now(nam) || now(num) || now(mul))
+         parens = 0;
+      if (now(log) || now(exp) || now(pow))
+         parens = 0;
+      if (now(lag) || now(led))
+         parens = 0;
+      if (now(sum) || now(prd))
+         parens = 0;
+      break;
+
+   case dvd:
+      parens = 1;
+      if (now(nam) || now(num) || now(pow))
+         parens = 0;
+      if (now(sum) || now(prd))
+         parens = 0;
+      if (now(lag) || now(led))
+         parens = 0;
+      if (now(log) || now(exp))
+         parens = 0;
+      break;
+
+   case pow:
+   case log:
+   case exp:
+   case lag:
+   case led:
+   case sum:
+   case prd:
+   case nam:
+   case num:
+   case equ:
+   case dom:
+      break;
+
+   default:
+      FAULT("Invalid state reached in show_node");
+   }
+
+   //
+   //  case 1: a few straightforward items
+   //
+
+   switch (cur->type)
+   {
+   case nam:
+      sb_take(out, show_symbol(cur->str, cur->domain, setlist, sublist, mycontext));
+      return;
+
+   case num:
+      sb_add(out, cur->str);
+      if (strspn(cur->str, "0123456789") == strlen(cur->str))
+         sb_add(out, ".0");
+      return;
+
+   case lag:
+   case led:
+      codegen_show_node(out, cur->type, cur->r, setlist, sublist);
+      return;
+
+   case dom:
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      return;
+
+   case lst:
+      FAULT("Unexpected lst state in show_node");
+
+   default:
+      break;
+   }
+
+   //
+   //  case 2: sum and product, always in scalar form
+   //
+
+   if (cur->type == sum || cur->type == prd)
+   {
+      Item *ele;
+
+      lstr = (cur->l)->str;
+
+      augsets = tmpsequence(XA_EQUATION);
+      catlist(augsets, setlist);
+      addlist(augsets, lstr);
+
+      op = (cur->type == prd) ? "*" : "+";
+      lpar = (cur->type == prd) ? "(" : "";
+      rpar = (cur->type == prd) ? ")" : "";
+
+      sb_add(out, "(");
+      thisop = " ";
+
+      sumover = setmembers(lstr);
+      augsubs = tmpsequence(XA_EQUATION);
+      catlist(augsubs, sublist);
+      addlist(augsubs, sumover->n ? sumover->first->str : "");
+
+      for (ele = sumover->first; ele; ele = ele->next)
+      {
+         setitem(augsubs, augsubs->n - 1, ele);
+
+         sb_add(out, " ");
+         sb_add(out, thisop);
+         sb_add(out, lpar);
+         codegen_show_node(out, cur->type, cur->r, augsets, augsubs);
+         sb_add(out, rpar);
+
+         thisop = op;
+      }
+
+      if (sumover->n == 0)
+         sb_add(out, cur->type == prd ? "1.0" : "0.0");
+
+      sb_add(out, ")");
+      return;
+   }
+
+   //
+   //  case 3: everything else
+   //
+
+   isfunc = now(log) || now(exp) || now(pow);
+
+   lpar = (parens && isfunc == 0) ? "(" : "";
+   rpar = (parens && isfunc == 0) ? ")" : "";
+
+   wrap_right = 0;
+   if (cur->type == sub)
+      if (cur->r->type == add || cur->r->type == sub)
+         wrap_right = 1;
+
+   sb_add(out, lpar);
+
+   switch (cur->type)
+   {
+   case log:
+   case exp:
+      sb_take(out, codegen_begin_func(cur->str, 0));
+      endfunc = codegen_end_func();
+      op = "";
+      break;
+
+   case pow:
+      sb_add(out, "pow(");
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      endfunc = strdup(")");
+      op = ", ";
+      break;
+
+   default:
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      endfunc = 0;
+      op = cur->str;
+   }
+
+   sb_add(out, op);
+   if (wrap_right)
+      sb_add(out, "(");
+
+   codegen_show_node(out, cur->type, cur->r, setlist, sublist);
+
+   if (wrap_right)
+      sb_add(out, ")");
+   sb_add(out, rpar);
+   if (endfunc)
+      sb_take(out, endfunc);
+}
+
+//----------------------------------------------------------------------//
+//
+//  Connect up the public routines.
+//
+//----------------------------------------------------------------------//
+
+void C_setup(void)
+{
+   lang_begin_file(C_begin_file);
+   lang_end_file(C_end_file);
+   lang_declare(C_declare);
+   lang_begin_block(C_begin_block);
+   lang_show_symbol(C_show_symbol);
+   lang_show_eq(C_show_eq);
+   lang_show_node(C_show_node);
+
+   set_eqn_scalar();
+   set_sum_scalar();
+}
+
+char *C_version = "$Revision: 1 $";
@@ -15,6 +15,7 @@
 #include "../error.h"
 #include "../lang.h"
 #include "../options.h"
+#include "../outfile.h"
 #include "../output.h"
 #include "../str.h"
 #include "../sym.h"
@@ -133,7 +134,7 @@ void DB_begin_file(char *basename)
    if( do_scalars )
       {
       fname  = concat(2,basename,"_scalars.csv");
-      fh_sca = fopen(fname,"w");
+      fh_sca = outfile_open(fname);
       if( fh_sca == 0 )
          fatal_error("Could not create file: %s",fname);
       free( fname );
@@ -160,7 +161,7 @@ void DB_end_file()
    
    if( scalar_dict == 0 ) 
       {
-      fclose( fh_sca );
+      outfile_close( fh_sca );
       return;
       }
 
@@ -191,7 +192,7 @@ void DB_end_file()
    if( unused )
       printf("warning: %d scalars are unused\n",unused);
 
-   fclose( fh_sca );
+   outfile_close( fh_sca );
 }
 
 
@@ -100,11 +100,13 @@
 #include "../error.h"
 #include "../lang.h"
 #include "../options.h"
+#include "../outfile.h"
 #include "../output.h"
 #include "../sets.h"
 #include "../str.h"
 #include "../sym.h"
 #include "../symtable.h"
+#include "msgvec.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -146,58 +148,9 @@ FILE *optmap;
 //  MSGPROC vectors
 //
 
-#define NUL  0
-#define Z1L  1
-#define ZEL  2
-#define J1L  3
-#define X1L  4
-#define Z1R  5
-#define ZER  6
-#define YJR  7
-#define YXR  8
-#define EXO  9
-#define EXZ 10
-#define PAR 11
-#define X1R 12
-#define UNK 13
-
 static int   vecinfo[UNK+1] ;
 static char *vecname[UNK+1];
 
-//
-//  MSGPROC variable types and mapping into vectors
-//
-//     Output vector names in the vlist array are organized as follows: LHS
-//     name when lagged, LHS name for the contemporaneous value, LHS name when
-//     a lead, RHS name when lagged, RHS name for contemporaneous value, RHS
-//     name when a lead.  
-//     
-//     A null value indicates a semantic error: that type of variable is not
-//     allowed in the corresponding context (eg, lead(exog) = something).
-//
-//     Order of vector names: left-lag, left-cur, left-lead, 
-//     right-lag, right-cur, right-lead.
-//     
-
-struct vartype_info 
-   {
-   char *type;
-   int  vecid[6];
-   };
-
-struct vartype_info vlist[] =
-   {
-   { "end",   0, Z1L,   0,   0, Z1R,   0 },
-   { "ets",   0, ZEL,   0,   0, ZER, EXZ },
-   { "exo",   0,   0,   0,   0, EXO,   0 },
-   { "cos",   0,   0, J1L,   0, YJR,   0 },
-   { "sta",   0,   0, X1L,   0, YXR,   0 },
-   { "stl",   0, X1L,   0, YXR, X1R,   0 },
-   { "par",   0,   0,   0,   0, PAR,   0 },
-// { "ttp",   0, ZEL,   0, YXR, ZER, EXZ },
-   {     0,   0,   0,   0,   0,   0,   0 }
-   };
-
 //
 //  Units
 //
@@ -240,7 +193,7 @@ enum oldform { o_unk, o_err, o_none,
                o_agcc, o_gdo };
 
 //
-//  Define the variable object and initialize the linked list
+//  Define the variable object and the registry used to find it
 //
 
 struct variable
@@ -259,11 +212,10 @@ struct variable
    int  of_d;              // position of dest subscript
    int  of_o;              // position of orig subscript
    int  varsnum;           // first element number in VARS list
-   struct variable *next;  // next variable
    };
 
 typedef struct variable Variable;
-static Variable *v_head=0;
+static void *v_reg=0;
 
 
 //----------------------------------------------------------------------//
@@ -431,79 +383,29 @@ void write_vars(Variable *thisvar, List *setlist, char *desc )
 
 char *get_msgname(char *str, List *sublist, Context context)
 {
-   int sel=1;
+   int sel;
    int vecid;
-   int check;
    char buf[1024],*ptr;
    Variable *var;
-   List *numsubs;
    
-   if( v_head == 0 )
+   if( v_reg == 0 )
       FAULT("Variable list is blank in get_msgname");
 
-   for( var = v_head ; var ; var=var->next )
-      {
-      validate( var, MSGVAROBJ, "get_msgname" );
-
-      check = strcasecmp(str,var->str);
-      if( check == 0 )break;
-      if( check <  0 )
-         FAULT("Name not in variable list in get_msgname");
-      }
-
-   if( var==0 )
-      FAULT("Name not in variable list in get_msgname");
-
-   //
-   //  check that lead and lag structure is OK for msgproc
-   //
-   
-   if( context.dt < -1 )
-      msg_error("%s","lag(lag(var)) cannot be used with msgproc");
-
-   if( context.dt >  1 )
-      msg_error("%s","lead(lead(var)) cannot be used with msgproc");
+   var = (Variable *) msgvec_find(v_reg,str);
+   validate( var, MSGVAROBJ, "get_msgname" );
 
    //
    //  given the context, look up the MSGPROC vector id
    //
 
-   sel += context.dt;
-   if( context.lhs == 0 )sel += 3;
-
+   sel   = msgvec_select(str,var->type,var->vecid,context,msg_error);
    vecid = var->vecid[sel];
-   
-   //
-   //  if vecid is zero, this type of variable is not allowed
-   //  in the current context.  figure out what the problem was
-   //  and print an appropriate message.
-   //
-
-   if( vecid==0 )
-      {
-      char *side;
-      switch( sel )
-         {
-         case 0: side = "LHS in lag()"               ; break;
-         case 1: side = "LHS without lag() or lead()"; break;
-         case 2: side = "LHS in lead()"              ; break;
-         case 3: side = "RHS in lag()"               ; break;
-         case 4: side = "RHS without lag() or lead()"; break;
-         case 5: side = "RHS in lead()"              ; break;
-         }
-      sprintf(buf,"%s\n   Type '%s' on %s",str,var->type,side);
-      msg_error("Invalid context for variable %s",buf);
-      }
       
    //
    //  context is OK; now convert the subscripts
    //
 
-   numsubs = sub_offset( str, sublist, var->vecoff[sel] );
-
-   sprintf(buf,"%s[%s]",vecname[vecid],slprint(numsubs));
-   
-   freelist(numsubs);
+   sprintf(buf,"%s[%ld]",vecname[vecid],sub_ravel(str,sublist,var->vecoff[sel]));
 
    ptr = strdup(buf);
    if( ptr == 0 )FAULT("Could not allocate memory in get_msgname");
@@ -720,25 +622,25 @@ void MSGPROC_begin_file(char *basename)
    char *fname;
    
    fname  = concat(2,basename,"_varmap.csv");
-   varmap = fopen(fname,"w");
+   varmap = outfile_open(fname);
    if( varmap == 0 )
       msg_error("Could not create file: %s",fname);
    free( fname );
    
    fname  = concat(2,basename,"_optmap.csv");
-   optmap = fopen(fname,"w");
+   optmap = outfile_open(fname);
    if( optmap == 0 )
       msg_error("Could not create file: %s",fname);
    free( fname );
    
    fname   = concat(2,basename,"_varinfo.csv");
-   varinfo = fopen(fname,"w");
+   varinfo = outfile_open(fname);
    if( varinfo == 0 )
       msg_error("Could not create file: %s",fname);
    free( fname );
 
    fname = concat(2,basename,"_vars.csv");
-   vars  = fopen(fname,"w");
+   vars  = outfile_open(fname);
    if( vars == 0 )
       msg_error("Could not create file: %s",fname);
    free( fname );
@@ -782,10 +684,10 @@ void MSGPROC_end_file()
 
    fprintf(code,"\n}\n");
 
-   fclose( varmap  );
-   fclose( varinfo );
-   fclose( vars    );
-   fclose( optmap  );
+   outfile_close( varmap  );
+   outfile_close( varinfo );
+   outfile_close( vars    );
+   outfile_close( optmap  );
 
    ecount = MSGPROC_scalar-1;
    vcount = vecinfo[Z1L]+vecinfo[ZEL]+vecinfo[J1L]+vecinfo[X1L]
@@ -844,14 +746,12 @@ void MSGPROC_declare(void *sym)
 {
    char     *name;
    Variable *newvar;
-   Variable *cur,*nxt;
    List     *attlist;
    List     *vallist;
    char     *curtype,setlist[1024],*desc;
-   int      vecid,start,do_inc;
-   int      my_Z1L, my_J1L, my_ZEL, my_X1L;
+   int      vecid;
    
-   int i,j,check,found,count,vi;
+   int i,j,found,count,vi;
    validate( sym, SYMBOBJ, "MSGPROC_declare" );
 
    if( istype(sym,set) )return;
@@ -870,7 +770,6 @@ void MSGPROC_declare(void *sym)
    newvar = (Variable *) malloc( sizeof(Variable) );
    newvar->obj  = MSGVAROBJ;
    newvar->str  = name;
-   newvar->next = 0;
 
    //
    //  figure out how to write the old-style variable name in 
@@ -891,7 +790,7 @@ void MSGPROC_declare(void *sym)
       
    attlist = symattrib(sym);
 
-   for (i = 0; (curtype = vlist[i].type); i++)
+   for (i = 0; (curtype = msgvec_types[i].type); i++)
    {
       if( *curtype == 0 )
          FAULT("Corrupted vlist in MSGPROC_declare");
@@ -917,7 +816,7 @@ void MSGPROC_declare(void *sym)
    if( istype(sym,par) && found==0 )
       FAULT("Failed to find parameter in vlist in MSGPROC_declare");
       
-   newvar->type = vlist[vi].type;
+   newvar->type = msgvec_types[vi].type;
 
    //
    //  if this is a variable, figure out its units
@@ -943,105 +842,10 @@ void MSGPROC_declare(void *sym)
   
    //
    //  get the current offset into each vector and then reserve space
-   //  for all of this variable's elements.  use my_* variables to synchronize
-   //  subscripts between vectors; set them to -1 initially to allow error
-   //  checks.
+   //  for all of this variable's elements.
    //
 
-   my_Z1L = -1;
-   my_J1L = -1;
-   my_ZEL = -1;
-   my_X1L = -1;
-
-   for( j=0 ; j<6 ; j++ )
-      {
-      vecid = vlist[vi].vecid[j];
-      newvar->vecid[j] = vecid;
-      
-      if( vecid==0 )
-         {
-         newvar->vecoff[j] = 0;
-         continue;
-         }
-         
-      //  look up this vecid in the vecinfo table
-
-      if( vecid <= NUL || vecid >= UNK )
-         FAULT("Unrecognized vector id in MSGPROC_declare");
-
-      //  figure out which counter to use.  this is a bit tricky because
-      //  we need to synchronize subscripts across certain sets of vectors.
-
-      start  = vecinfo[vecid];
-      do_inc = 1;
-
-      switch( vecid ) 
-         {
-         // 
-         // Z1L drives Z1R
-         // 
-         case Z1L: 
-            my_Z1L = start ; 
-            break;
-            
-         case Z1R: 
-            if( my_Z1L < 0 )FAULT("Z1R without Z1L");
-            start  = my_Z1L ; 
-            do_inc = 0;
-            break;
-
-         // 
-         // J1L drives YJR
-         // 
-         case J1L:
-            my_J1L = start;
-            break;
-            
-         case YJR:
-            if( my_J1L < 0 )FAULT("YJR without J1L");
-            start  = my_J1L ; 
-            do_inc = 0;
-            break;
-
-         //
-         // ZEL drives ZER and EXZ
-         //  
-         case ZEL:
-            my_ZEL = start;
-            break;
-            
-         case ZER:
-         case EXZ:
-            if( my_ZEL < 0 )FAULT("ZER or EXZ without ZEL");
-            start  = my_ZEL;
-            do_inc = 0;
-            break;
-
-         //
-         // X1L drives YXR and X1R
-         //
-         case X1L:
-            my_X1L = start;
-            break;
-
-         case YXR:
-         case X1R:
-            if( my_X1L < 0 )FAULT("YXR or X1R without X1L");
-            start  = my_X1L;
-            do_inc = 0;
-            break;
-
-         //
-         // everything else drives itself
-         // 
-         default:
-            break;
-         }
-         
-      newvar->vecoff[j] = start ;
-      if( do_inc )vecinfo[vecid] += count;
-
-      }
+   msgvec_reserve( &msgvec_types[vi], count, vecinfo, newvar->vecid, newvar->vecoff );
 
    //
    //  entry is now complete
@@ -1057,7 +861,7 @@ void MSGPROC_declare(void *sym)
 
    if( DBG )
       {
-      printf("MSGPROC_declare: %s, type %s, has %d elements -> ",name,vlist[vi].type,count);
+      printf("MSGPROC_declare: %s, type %s, has %d elements -> ",name,newvar->type,count);
       for( j=0 ; j<6 ; j++ )
          {
          vecid = newvar->vecid[j];
@@ -1084,57 +888,13 @@ void MSGPROC_declare(void *sym)
    free(desc);
 
    //
-   //  insert it into the list in alphabetical order
+   //  add it to the registry
    //
 
-   //  case 1: list is empty
-   
-   if( v_head == 0 ) 
-      {
-      v_head = newvar;
-      write_varmap(newvar,vallist);
-      freelist(vallist);
-      return;
-      }
-
-   cur = v_head;
-   check = strcasecmp(name,cur->str);
-
-   if( check == 0 )
-      FAULT("Multiple definitions of variable in MSGPROC_declare");
-
-   //  case 2: insert before first existing entry
-
-   if( check < 0 ) 
-      {
-      newvar->next = v_head;
-      v_head = newvar;
-      write_varmap(newvar,vallist);
-      freelist(vallist);
-      return;
-      }
-
-   //  case 3: anywhere else except the end
-
-   for( nxt=cur->next ; nxt ; nxt=nxt->next )
-      {
-      check = strcasecmp(name,nxt->str);
-      if( check == 0 )
-         FAULT("Multiple definitions of variable in MSGPROC_declare");
-      if( check  < 0 )
-         {
-         newvar->next = nxt;
-         cur->next = newvar;
-         write_varmap(newvar,vallist);
-         freelist(vallist);
-         return;
-         }
-      cur=nxt; 
-      }
-
-   //  case 4: append after last element
+   if( v_reg == 0 )
+      v_reg = msgvec_newregistry();
 
-   cur->next = newvar;
+   msgvec_register(v_reg,name,newvar);
    write_varmap(newvar,vallist);
    freelist(vallist);
 }
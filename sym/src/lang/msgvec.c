@@ -0,0 +1,225 @@
+/*-------------------------------------------------------------------*
+ *  msgvec.c
+ *
+ *  Mapping of model variables into the MSGPROC vectors, shared by
+ *  the msgproc and python language modules.  Each variable type
+ *  uses a particular vector in each of the six contexts in which a
+ *  variable can appear, and each variable gets a block of elements
+ *  in every vector it uses.  Some vectors share offsets so that a
+ *  variable's elements line up across them.
+ *
+ *  The language modules keep their variables in a registry hashed
+ *  by name, so finding a variable takes the same time however many
+ *  have been declared.
+ *-------------------------------------------------------------------*/
+
+#include "msgvec.h"
+
+#include "../dict.h"
+#include "../error.h"
+#include <stdio.h>
+
+//
+//  Variable types.  A zero vector id means the type can't be used
+//  in that context (eg, lead(exog) = something).
+//
+
+Msgtype msgvec_types[] =
+   {
+   { "end",   0, Z1L,   0,   0, Z1R,   0 },
+   { "ets",   0, ZEL,   0,   0, ZER, EXZ },
+   { "exo",   0,   0,   0,   0, EXO,   0 },
+   { "cos",   0,   0, J1L,   0, YJR,   0 },
+   { "sta",   0,   0, X1L,   0, YXR,   0 },
+   { "stl",   0, X1L,   0, YXR, X1R,   0 },
+   { "par",   0,   0,   0,   0, PAR,   0 },
+// { "ttp",   0, ZEL,   0, YXR, ZER, EXZ },
+   {     0,   0,   0,   0,   0,   0,   0 }
+   };
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  msgvec_reserve
+ *
+ *  Set the vector ids and offsets for a variable of type t with
+ *  count elements, and reserve space for it by advancing the next
+ *  free offset of each vector in vecinfo.  Z1L drives Z1R, J1L
+ *  drives YJR, ZEL drives ZER and EXZ, and X1L drives YXR and X1R:
+ *  the driven vectors use the same offsets and reserve nothing of
+ *  their own.
+ *-------------------------------------------------------------------*/
+void msgvec_reserve( Msgtype *t, int count, int *vecinfo, int *vecid, int *vecoff )
+{
+   int my_Z1L, my_J1L, my_ZEL, my_X1L;
+   int j,id,start,do_inc;
+
+   //
+   //  use my_* variables to synchronize subscripts between vectors;
+   //  set them to -1 initially to allow error checks.
+   //
+
+   my_Z1L = -1;
+   my_J1L = -1;
+   my_ZEL = -1;
+   my_X1L = -1;
+
+   for( j=0 ; j<6 ; j++ )
+      {
+      id = t->vecid[j];
+      vecid[j] = id;
+
+      if( id==0 )
+         {
+         vecoff[j] = 0;
+         continue;
+         }
+
+      if( id <= NUL || id >= UNK )
+         FAULT("Unrecognized vector id in msgvec_reserve");
+
+      start  = vecinfo[id];
+      do_inc = 1;
+
+      switch( id )
+         {
+         case Z1L:
+            my_Z1L = start;
+            break;
+
+         case Z1R:
+            if( my_Z1L < 0 )FAULT("Z1R without Z1L");
+            start  = my_Z1L;
+            do_inc = 0;
+            break;
+
+         case J1L:
+            my_J1L = start;
+            break;
+
+         case YJR:
+            if( my_J1L < 0 )FAULT("YJR without J1L");
+            start  = my_J1L;
+            do_inc = 0;
+            break;
+
+         case ZEL:
+            my_ZEL = start;
+            break;
+
+         case ZER:
+         case EXZ:
+            if( my_ZEL < 0 )FAULT("ZER or EXZ without ZEL");
+            start  = my_ZEL;
+            do_inc = 0;
+            break;
+
+         case X1L:
+            my_X1L = start;
+            break;
+
+         case YXR:
+         case X1R:
+            if( my_X1L < 0 )FAULT("YXR or X1R without X1L");
+            start  = my_X1L;
+            do_inc = 0;
+            break;
+
+         default:
+            break;
+         }
+
+      vecoff[j] = start;
+      if( do_inc )vecinfo[id] += count;
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  msgvec_select
+ *
+ *  Return which of the six contexts a reference to a variable is
+ *  in, reporting an error through err if its type isn't allowed
+ *  there.
+ *-------------------------------------------------------------------*/
+int msgvec_select( char *name, char *type, int *vecid, Context context, Msgerr err )
+{
+   char buf[1024],*side;
+   int sel;
+
+   //
+   //  check that lead and lag structure is OK for msgproc
+   //
+
+   if( context.dt < -1 )
+      err("%s","lag(lag(var)) cannot be used with msgproc");
+
+   if( context.dt >  1 )
+      err("%s","lead(lead(var)) cannot be used with msgproc");
+
+   sel = 1 + context.dt;
+   if( context.lhs == 0 )sel += 3;
+
+   if( vecid[sel] )
+      return sel;
+
+   //
+   //  this type of variable is not allowed in the current context.
+   //  figure out what the problem was and print an appropriate
+   //  message.
+   //
+
+   switch( sel )
+      {
+      case 0:  side = "LHS in lag()"               ; break;
+      case 1:  side = "LHS without lag() or lead()"; break;
+      case 2:  side = "LHS in lead()"              ; break;
+      case 3:  side = "RHS in lag()"               ; break;
+      case 4:  side = "RHS without lag() or lead()"; break;
+      default: side = "RHS in lead()"              ; break;
+      }
+   sprintf(buf,"%s\n   Type '%s' on %s",name,type,side);
+   err("Invalid context for variable %s",buf);
+
+   return sel;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  msgvec_newregistry
+ *-------------------------------------------------------------------*/
+void *msgvec_newregistry( void )
+{
+   return newdict(1000);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  msgvec_register
+ *
+ *  Add a variable to a registry.  Names are compared without
+ *  regard to case and may only be registered once.
+ *-------------------------------------------------------------------*/
+void msgvec_register( void *reg, char *name, void *var )
+{
+   if( getdict(reg,name) )
+      FAULT("Multiple definitions of variable in msgvec_register");
+   putdict(reg,name,var);
+}
+
+
+/*-------------------------------------------------------------------*
+ *  msgvec_find
+ *-------------------------------------------------------------------*/
+void *msgvec_find( void *reg, char *name )
+{
+   void *var;
+
+   var = getdict(reg,name);
+   if( var == 0 )
+      FAULT("Name not in variable list in msgvec_find");
+
+   return var;
+}
@@ -0,0 +1,63 @@
+/* msgvec.h
+ *
+ * Header file for the MSGPROC vector layout shared by the msgproc
+ * and python language modules.
+ */
+
+#ifndef MSGVEC_H
+#define MSGVEC_H
+
+#include "../output.h"
+
+//
+//  MSGPROC vectors
+//
+
+#define NUL  0
+#define Z1L  1
+#define ZEL  2
+#define J1L  3
+#define X1L  4
+#define Z1R  5
+#define ZER  6
+#define YJR  7
+#define YXR  8
+#define EXO  9
+#define EXZ 10
+#define PAR 11
+#define X1R 12
+#define UNK 13
+
+//
+//  A variable type and the vector it uses in each of the six
+//  contexts: left-lag, left-cur, left-lead, right-lag, right-cur
+//  and right-lead.  The list ends with a null type.
+//
+
+typedef struct
+   {
+   char *type;
+   int  vecid[6];
+   }
+   Msgtype;
+
+extern Msgtype msgvec_types[];
+
+//
+//  Error routine of the calling language module
+//
+
+typedef void (*Msgerr)(char*, char*);
+
+//
+//  Function prototypes
+//
+
+void  msgvec_reserve(Msgtype *t, int count, int *vecinfo, int *vecid, int *vecoff);
+int   msgvec_select(char *name, char *type, int *vecid, Context context, Msgerr err);
+
+void* msgvec_newregistry(void);
+void  msgvec_register(void *reg, char *name, void *var);
+void* msgvec_find(void *reg, char *name);
+
+#endif /* MSGVEC_H */
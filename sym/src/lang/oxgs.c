@@ -21,6 +21,7 @@
 #include "../error.h"
 #include "../lang.h"
 #include "../options.h"
+#include "../outfile.h"
 #include "../output.h"
 #include "../str.h"
 #include "../sym.h"
@@ -423,12 +424,12 @@ void OxGS_begin_file(char *basename)
    char *fname_decl,*fname_init;
    
    fname_decl = concat(2,basename,"_decl.h");
-   incfile = fopen(fname_decl,"w");
+   incfile = outfile_open(fname_decl);
    if( incfile==0 )
       oxgs_error("Could not create include file: %s",fname_decl);
    
    fname_init = concat(2,basename,"_init.h");
-   initfile = fopen(fname_init,"w");
+   initfile = outfile_open(fname_init);
    if( initfile==0 )
       oxgs_error("Could not create include file: %s",fname_init);
    
@@ -523,8 +524,8 @@ void OxGS_end_file()
    fprintf(info,"Total Equation Count: %d\n",OxGS_scalar);
    fprintf(info,"Total Endogenous Variables: %d\n",OxGS_endog);
 
-   fclose(incfile);
-   fclose(initfile);
+   outfile_close(incfile);
+   outfile_close(initfile);
 }
 
 //----------------------------------------------------------------------//
@@ -641,7 +642,7 @@ char *OxGS_show_symbol(char *str, List *sublist, Context context)
       lastlhs = e;
 
       fprintf(code,"lhs = %s ;\n",ptr);
-      return "rhs";
+      return strdup("rhs");
       }
      
    return ptr;
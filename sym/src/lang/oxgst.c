@@ -24,7 +24,10 @@
 #include "../eqns.h"
 #include "../options.h"
 #include "../cart.h"
+#include "../codegen.h"
+#include "../cse.h"
 #include "../lang.h"
+#include "../outfile.h"
 #include "../output.h"
 #include "../sets.h"
 #include "../str.h"
@@ -192,15 +195,15 @@ static List *OxGST_modtime(char *str, List *sublist, Context context)
    //
 
    found = 0;
-   newsubs = duplist(sublist);
-   for( ele=newsubs->first ; ele ; ele=ele->next )
-      if( isequal(ele->str,context.tsub) )
+   newsubs = newsequence();
+   for( ele=sublist->first ; ele ; ele=ele->next )
+      if( found == 0 && isequal(ele->str,context.tsub) )
          {
-         free( ele->str );
-         ele->str = strdup( timesubs[t] );
+         addlist( newsubs, timesubs[t] );
          found = 1;
-         break;
          }
+      else
+         addlist( newsubs, ele->str );
 
    if( found == 0 )
       OxGST_error( "Internal error: failed to update lead or lag subscript on %s", str );
@@ -649,17 +652,17 @@ void OxGST_begin_file(char *basename)
    char *fname_csvin,*fname_csvout;
    
    fname_decl = concat(2,basename,"_decl.h");
-   incfile = fopen(fname_decl,"w");
+   incfile = outfile_open(fname_decl);
    if( incfile==0 )
       OxGST_error("Could not create include file: %s",fname_decl);
    
    fname_init = concat(2,basename,"_init.h");
-   initfile = fopen(fname_init,"w");
+   initfile = outfile_open(fname_init);
    if( initfile==0 )
       OxGST_error("Could not create include file: %s",fname_init);
    
    fname_csv = concat(2,basename,"_tmp.csv");
-   csvfile = fopen(fname_csv,"w");
+   csvfile = outfile_open(fname_csv);
    if( csvfile==0 )
       OxGST_error("Could not create template csv file: %s",fname_csv);
 
@@ -787,8 +790,11 @@ void OxGST_end_file()
    fprintf(info,"Total Equation Count: %d\n",OxGST_scalar);
    fprintf(info,"Total Endogenous Variables: %d\n",OxGST_endog);
 
-   fclose(incfile);
-   fclose(initfile);
+   if( cse_used() )cse_report(info);
+
+   outfile_close(incfile);
+   outfile_close(initfile);
+   outfile_close(csvfile);
 }
 
 //----------------------------------------------------------------------//
@@ -869,6 +875,78 @@ void OxGST_end_eqn(void *eq)
 }
 
 
+//----------------------------------------------------------------------//
+//
+//  Write a scalar equation.  With -cse, subexpressions used more
+//  than once in it are declared as local variables in a block
+//  around the equation.  They can't be shared between equations
+//  because mode 1 updates each variable as soon as its equation
+//  has been evaluated.  With -simplify, the right side is
+//  simplified first.
+//
+//----------------------------------------------------------------------//
+
+void OxGST_show_eq(void *eq, List *setlist, List *sublist)
+{
+   static Strbuf all   = SB_INIT;
+   static Strbuf temps = SB_INIT;
+   void Default_show_eq();
+   Node *getlhs(),*getrhs();
+   char *head,*tail;
+   int root,ntemps,k;
+
+   if( !cse_used() )
+      {
+      Default_show_eq(eq,setlist,sublist);
+      return;
+      }
+
+   sb_reset(&all);
+   codegen_show_node(&all,nul,getlhs(eq),setlist,sublist);
+   sb_add(&all," = ");
+
+   cse_begin("_t");
+   root   = cse_add(getrhs(eq),setlist,sublist);
+   ntemps = cse_end();
+   cse_show(&all,root);
+
+   if( ntemps )
+      {
+      sb_reset(&temps);
+      sb_add(&temps,"{\n");
+      for( k=1 ; k <= ntemps ; k++ )
+         {
+         sb_add(&temps,"decl ");
+         sb_add(&temps,cse_name(k));
+         sb_add(&temps," = ");
+         cse_temp(&temps,k);
+         sb_add(&temps," ;\n");
+         }
+      sb_insert(&all,0,temps.str);
+      }
+
+   codegen_begin_eqn(eq);
+
+   if( get_line_length() == 0 || all.len <= get_line_length() )
+      fprintf(code,"%s",all.str);
+   else
+      {
+      for( head=all.str ; (tail=strchr(head,'\n')) ; head=tail )
+         {
+         *tail++ = '\0';
+         codegen_wrap_write(head,1,0);
+         }
+      codegen_wrap_write(head,0,0);
+      }
+
+   xarena_reset(XA_EQUATION);
+   codegen_end_eqn(eq);
+
+   if( ntemps )
+      fprintf(code,"}\n\n");
+}
+
+
 //----------------------------------------------------------------------//
 //
 //  Show a symbol
@@ -905,7 +983,7 @@ char *OxGST_show_symbol(char *str, List *sublist, Context context)
       lastlhs = e;
 
       fprintf(code,"lhs = %s ;\n",ptr);
-      return "rhs";
+      return strdup("rhs");
       }
      
    return ptr;
@@ -927,6 +1005,7 @@ void OxGST_setup(void)
    lang_begin_eqn  ( OxGST_begin_eqn   ); 
    lang_end_eqn    ( OxGST_end_eqn     ); 
    lang_show_symbol( OxGST_show_symbol );
+   lang_show_eq    ( OxGST_show_eq     );
 
    set_eqn_scalar();
    set_eqn_lvalue();
@@ -25,6 +25,7 @@
 #include "../error.h"
 #include "../lang.h"
 #include "../options.h"
+#include "../outfile.h"
 #include "../output.h"
 #include "../str.h"
 #include "../sym.h"
@@ -128,7 +129,7 @@ char *oxn_mkname(char *base, List *subs)
 //----------------------------------------------------------------------//
 void oxn_declcode(Variable *v)      
 {
-   List *cur,*numsubs,*setlist;
+   List *cur,*setlist;
    char *msg;
    char *fullname;
 
@@ -149,9 +150,7 @@ void oxn_declcode(Variable *v)
 
       if( v->isguess )
          {
-         numsubs = sub_offset( v->str, cur, v->off );
-         fprintf(code,"   %s = guess[%s] ;\n",fullname,(numsubs->first)->str);
-         freelist(numsubs);
+         fprintf(code,"   %s = guess[%ld] ;\n",fullname,sub_ravel(v->str,cur,v->off));
          }
 
       free(fullname);
@@ -373,12 +372,12 @@ void OxNewton_begin_file(char *basename)
    char *fname_decl,*fname_init;
    
    fname_decl = concat(2,basename,"_decl.h");
-   incfile = fopen(fname_decl,"w");
+   incfile = outfile_open(fname_decl);
    if( incfile==0 )
       oxn_error("Could not create include file: %s",fname_decl);
    
    fname_init = concat(2,basename,"_init.h");
-   initfile = fopen(fname_init,"w");
+   initfile = outfile_open(fname_init);
    if( initfile==0 )
       oxn_error("Could not create include file: %s",fname_init);
    
@@ -419,8 +418,8 @@ void OxNewton_end_file()
    fprintf(info,"Number of Miss Equations: %d\n",OxNewton_miss);
    fprintf(info,"Number of Guess Variables: %d\n",OxNewton_guess);
 
-   fclose(incfile);
-   fclose(initfile);
+   outfile_close(incfile);
+   outfile_close(initfile);
 }
 
 //----------------------------------------------------------------------//
@@ -96,17 +96,23 @@
  *--------------------------------------------------------------------*/
 
 #include "../cart.h"
+#include "../cse.h"
+#include "../deriv.h"
 #include "../eqns.h"
 #include "../error.h"
 #include "../lang.h"
 #include "../options.h"
+#include "../outfile.h"
 #include "../output.h"
 #include "../sets.h"
+#include "../sparsity.h"
 #include "../str.h"
 #include "../sym.h"
 #include "../symtable.h"
 #include "../codegen.h"
+#include "../workers.h"
 #include "../xmalloc.h"
+#include "msgvec.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -133,6 +139,12 @@ extern char *strdup();
 // GCS 2022-11-22 Changed from 1 to 0 to alter array indexing to Python conventions.
 #define PYTHON_ORIGIN 0
 
+//
+//  Fewest scalar equations worth giving to a worker process
+//
+
+#define PYTHON_JOB_EQNS 2000
+
 //
 //  Internal variables
 //
@@ -154,60 +166,96 @@ FILE *python_optmap;
 FILE *python_eqnmap;
 static int writingEquations = 0;
 
+// Scratch stream of the vector elements used by each equation, and
+// the file the sparsity matrix built from them is written to.  The
+// elements used by the equation being written are collected in refs;
+// the first is its left side.
+static FILE *python_rows;
+FILE *python_sparsity;
+static Spref *refs = 0;
+static int nrefs = 0;
+static int maxrefs = 0;
+
+// Positions of the partial derivatives written with -jacobian.
+FILE *python_jacobian;
+static int writingPartials = 0;
+
+// Positions of the linear coefficients and the linearity of each
+// equation, written with -linear.
+FILE *python_linear;
+FILE *python_linearity;
+
+// Positions the vector elements would have had without -prune.
+FILE *python_prunemap;
+
+// Scratch stream of the subexpression counts from each job for -cse
+// and -simplify.
+static FILE *python_cse;
+
 //
-//  MSGPROC vectors
+//  Equation blocks to be written, in order, and the first block
+//  of each job.  'block' is the number given to the block and
+//  'scalar' the number of its first scalar equation.
 //
 
-#define NUL 0
-#define Z1L 1
-#define ZEL 2
-#define J1L 3
-#define X1L 4
-#define Z1R 5
-#define ZER 6
-#define YJR 7
-#define YXR 8
-#define EXO 9
-#define EXZ 10
-#define PAR 11
-#define X1R 12
-#define UNK 13
+typedef struct
+{
+   void *eq;
+   int block;
+   int scalar;
+} Eqblock;
 
-static int vecinfo[UNK + 1];
-static char *vecname[UNK + 1];
+typedef struct
+{
+   Eqblock *blocks;
+   int nblocks;
+   int *start;
+} Eqjobs;
 
 //
-//  MSGPROC variable types and mapping into vectors
+//  Equations of the current block saved by show_eq when the -numpy
+//  option is used.  'text' holds the scalar functions exactly as
+//  they would otherwise have been written.  'form' is the first
+//  equation with each vector subscript replaced by a reference to
+//  row r of the block's index table, and 'index' holds the
+//  subscripts, 'nrefs' to an equation.  'same' is cleared if an
+//  equation doesn't match the form, and the block is then written
+//  one scalar function at a time as usual.
 //
-//     Output vector names in the vlist array are organized as follows: LHS
-//     name when lagged, LHS name for the contemporaneous value, LHS name when
-//     a lead, RHS name when lagged, RHS name for contemporaneous value, RHS
-//     name when a lead.
+
+static Strbuf nb_text = SB_INIT;
+static Strbuf nb_form = SB_INIT;
+static Strbuf nb_this = SB_INIT;
+static long *nb_index = 0;
+static int nb_size = 0;
+static int nb_used = 0;
+static int nb_nrefs = 0;
+static int nb_neqns = 0;
+static int nb_same = 1;
+static Strbuf nb_names = SB_INIT;
+
 //
-//     A null value indicates a semantic error: that type of variable is not
-//     allowed in the corresponding context (eg, lead(exog) = something).
+//  Partial derivative functions of the current block saved by
+//  show_eq when the -jacobian option is used, and the names of
+//  the equations they belong to.
 //
-//     Order of vector names: left-lag, left-cur, left-lead,
-//     right-lag, right-cur, right-lead.
+
+static Strbuf jb_text = SB_INIT;
+static Strbuf jb_names = SB_INIT;
+
+//
+//  Linear coefficients of the current block saved by show_eq when
+//  the -linear option is used.
 //
 
-struct vartype_info
-{
-   char *type;
-   int vecid[6];
-};
+static Strbuf lb_text = SB_INIT;
 
-static struct vartype_info vlist[] =
-    {
-        {"end", 0, Z1L, 0, 0, Z1R, 0},
-        {"ets", 0, ZEL, 0, 0, ZER, EXZ},
-        {"exo", 0, 0, 0, 0, EXO, 0},
-        {"cos", 0, 0, J1L, 0, YJR, 0},
-        {"sta", 0, 0, X1L, 0, YXR, 0},
-        {"stl", 0, X1L, 0, YXR, X1R, 0},
-        {"par", 0, 0, 0, 0, PAR, 0},
-        // { "ttp",   0, ZEL,   0, YXR, ZER, EXZ },
-        {0, 0, 0, 0, 0, 0, 0}};
+//
+//  MSGPROC vectors
+//
+
+static int vecinfo[UNK + 1];
+static char *vecname[UNK + 1];
 
 //
 //  Units
@@ -263,7 +311,7 @@ enum oldform
 };
 
 //
-//  Define the variable object and initialize the linked list
+//  Define the variable object and the registry used to find it
 //
 
 struct variable
@@ -282,11 +330,10 @@ struct variable
    int of_d;              // position of dest subscript
    int of_o;              // position of orig subscript
    int varsnum;           // first element number in VARS list
-   struct variable *next; // next variable
 };
 
 typedef struct variable Variable;
-static Variable *v_head = 0;
+static void *v_reg = 0;
 
 //----------------------------------------------------------------------//
 //  Function prototypes
@@ -295,8 +342,17 @@ static Variable *v_head = 0;
 static char *get_msgname(char *, List *, Context);
 static void msg_error(char *, char *);
 static void write_pythonname(FILE *, Variable *, List *);
-static char *str_replace(char *orig, char *rep, char *with);
-static char *msgname_to_eqnname(char *msgname);
+static void msgname_to_eqnname(Strbuf *, char *, int);
+static void numpy_begin(void);
+static void numpy_save(char *, char *);
+static void numpy_end(int);
+static void jacobian_begin(void);
+static void jacobian_save(char *, char *, void *, List *, List *);
+static void jacobian_end(int);
+static void linear_begin(void);
+static void linear_save(char *, void *, List *, List *);
+static void linear_end(int);
+static void write_prunemap(char *);
 
 //----------------------------------------------------------------------//
 //  msg_error()
@@ -315,19 +371,20 @@ void msg_error(char *fmt, char *str)
 //  write_varmap()
 //
 //  Write information about a variable or parameter to the varmap
-//  file.  The real work is done by cart_build(), cart_first() and
-//  cart_next(), which create and step through the cartesian product
-//  of the subscript sets.
+//  file.  The real work is done by a cart iterator, which steps
+//  through the cartesian product of the subscript sets once for
+//  each of the variable's vectors.
 //----------------------------------------------------------------------//
 
 static void write_varmap(Variable *thisvar, List *setlist)
 {
    Context mycontext;
+   Cart *tuples;
    List *cur;
    char *subs, *name;
    int j, n;
 
-   cart_build(setlist);
+   tuples = cart_open(setlist);
 
    for (j = 0; j < 6; j++)
       if (thisvar->vecid[j])
@@ -342,8 +399,10 @@ static void write_varmap(Variable *thisvar, List *setlist)
 
          n = thisvar->varsnum;
 
-         for (cur = cart_first(); cur; cur = cart_next())
+         cart_rewind(tuples);
+         while (cart_step(tuples))
          {
+            cur = cart_subs(tuples);
             name = get_msgname(thisvar->str, cur, mycontext);
             subs = strchr(name, ']');
             *subs = '\0';
@@ -371,22 +430,22 @@ static void write_varmap(Variable *thisvar, List *setlist)
             free(name);
          }
       }
+
+   cart_close(tuples);
 }
 
 //----------------------------------------------------------------------//
 //  write_vars()
 //
 //  Write information about a variable to the vars.csv file.  Driven
-//  by cart_build().
+//  by a cart iterator.
 //----------------------------------------------------------------------//
 
 static void write_vars(Variable *thisvar, List *setlist, char *desc)
 {
-   List *cur;
-   Item *sub;
+   Cart *tuples;
    char *region;
    int region_index;
-   int sub_index;
    int i;
 
    //
@@ -425,27 +484,25 @@ static void write_vars(Variable *thisvar, List *setlist, char *desc)
    // do the actual work ...
    //
 
-   cart_build(setlist);
+   tuples = cart_open(setlist);
 
    thisvar->varsnum = MSGPROC_vars;
 
-   for (cur = cart_first(); cur; cur = cart_next())
+   while (cart_step(tuples))
    {
       fprintf(python_vars, "%d,", MSGPROC_vars++);
-      fprintf(python_vars, "\"%s(%s)\",", thisvar->str, slprint(cur));
+      fprintf(python_vars, "\"%s(%s)\",", thisvar->str, slprint(cart_subs(tuples)));
       fprintf(python_vars, "\"%s\",", desc);
       fprintf(python_vars, "\"%s\",", thisvar->unit);
 
       if (region_index >= 0)
-      {
-         for (sub = cur->first, sub_index = 0; sub_index < region_index; sub_index++, sub = sub->next)
-            ;
-         region = sub->str;
-      }
+         region = cart_sub(tuples, region_index);
       fprintf(python_vars, "\"%s\",", region);
 
       fprintf(python_vars, "\n");
    }
+
+   cart_close(tuples);
 }
 
 //----------------------------------------------------------------------//
@@ -457,106 +514,60 @@ static void write_vars(Variable *thisvar, List *setlist, char *desc)
 
 static char *get_msgname(char *str, List *sublist, Context context)
 {
-   int sel = 1;
+   int sel;
    int vecid;
-   int check;
    char buf[1024], *ptr;
    Variable *var;
-   List *numsubs;
+   long loc;
 
-   if (v_head == 0)
+   if (v_reg == 0)
       FAULT("Variable list is blank in get_msgname");
 
-   for (var = v_head; var; var = var->next)
-   {
-      validate(var, PYTHONVAROBJ, "get_msgname");
-
-      check = strcasecmp(str, var->str);
-      if (check == 0)
-         break;
-      if (check < 0)
-         FAULT("Name not in variable list in get_msgname");
-   }
-
-   if (var == 0)
-      FAULT("Name not in variable list in get_msgname");
-
-   //
-   //  check that lead and lag structure is OK for msgproc
-   //
-
-   if (context.dt < -1)
-      msg_error("%s", "lag(lag(var)) cannot be used with msgproc");
-
-   if (context.dt > 1)
-      msg_error("%s", "lead(lead(var)) cannot be used with msgproc");
+   var = (Variable *)msgvec_find(v_reg, str);
+   validate(var, PYTHONVAROBJ, "get_msgname");
 
    //
    //  given the context, look up the MSGPROC vector id
    //
 
-   sel += context.dt;
-   if (context.lhs == 0)
-      sel += 3;
-
+   sel = msgvec_select(str, var->type, var->vecid, context, msg_error);
    vecid = var->vecid[sel];
 
-   //
-   //  if vecid is zero, this type of variable is not allowed
-   //  in the current context.  figure out what the problem was
-   //  and print an appropriate message.
-   //
-
-   if (vecid == 0)
-   {
-      char *side;
-      switch (sel)
-      {
-      case 0:
-         side = "LHS in lag()";
-         break;
-      case 1:
-         side = "LHS without lag() or lead()";
-         break;
-      case 2:
-         side = "LHS in lead()";
-         break;
-      case 3:
-         side = "RHS in lag()";
-         break;
-      case 4:
-         side = "RHS without lag() or lead()";
-         break;
-      case 5:
-         side = "RHS in lead()";
-         break;
-      }
-      sprintf(buf, "%s\n   Type '%s' on %s", str, var->type, side);
-      msg_error("Invalid context for variable %s", buf);
-   }
-
    //
    //  context is OK; now convert the subscripts
    //
 
-   numsubs = sub_offset(str, sublist, var->vecoff[sel]);
+   loc = sub_ravel(str, sublist, var->vecoff[sel]);
 
    if (writingEquations)
    {
-      sprintf(buf, "self.%s[%s]", vecname[vecid], slprint(numsubs));
+      sprintf(buf, "self.%s[%ld]", vecname[vecid], loc);
    }
       else
    {
-      sprintf(buf, "%s[%s]", vecname[vecid], slprint(numsubs));
+      sprintf(buf, "%s[%ld]", vecname[vecid], loc);
    }
 
-   if (writingEquations) 
+   if (writingEquations && !writingPartials)
    {
-      fprintf(python_eqnmap, "%s,%s\n", vecname[vecid], slprint(numsubs));
+      fprintf(python_eqnmap, "%s,%ld\n", vecname[vecid], loc);
+      if (nrefs == maxrefs)
+      {
+         Spref *bigger;
+         maxrefs = maxrefs ? 2 * maxrefs : 64;
+         bigger = (Spref *)xmalloc(maxrefs * sizeof(Spref));
+         if (nrefs)
+         {
+            memcpy(bigger, refs, nrefs * sizeof(Spref));
+            xfree(refs);
+         }
+         refs = bigger;
+      }
+      refs[nrefs].vec = vecid;
+      refs[nrefs].idx = loc;
+      nrefs++;
    }
 
-   freelist(numsubs);
-
    ptr = strdup(buf);
    if (ptr == 0)
       FAULT("Could not allocate memory in get_msgname");
@@ -812,35 +823,82 @@ void PYTHON_begin_file(char *basename)
    char *fname;
 
    fname = concat(2, basename, "_varmap.csv");
-   python_varmap = fopen(fname, "w");
+   python_varmap = outfile_open(fname);
    if (python_varmap == 0)
       msg_error("Could not create file: %s", fname);
    free(fname);
 
    fname = concat(2, basename, "_optmap.csv");
-   python_optmap = fopen(fname, "w");
+   python_optmap = outfile_open(fname);
    if (python_optmap == 0)
       msg_error("Could not create file: %s", fname);
    free(fname);
 
    fname = concat(2, basename, "_varinfo.csv");
-   python_varinfo = fopen(fname, "w");
+   python_varinfo = outfile_open(fname);
    if (python_varinfo == 0)
       msg_error("Could not create file: %s", fname);
    free(fname);
 
    fname = concat(2, basename, "_vars.csv");
-   python_vars = fopen(fname, "w");
+   python_vars = outfile_open(fname);
    if (python_vars == 0)
       msg_error("Could not create file: %s", fname);
    free(fname);
 
    fname = concat(2, basename, "_eqnmap.csv");
-   python_eqnmap = fopen(fname, "w");
+   python_eqnmap = outfile_open(fname);
    if (python_eqnmap == 0)
       msg_error("Could not create file: %s", fname);
    free(fname);
 
+   fname = concat(2, basename, "_sparsity.bin");
+   python_sparsity = outfile_open_binary(fname);
+   if (python_sparsity == 0)
+      msg_error("Could not create file: %s", fname);
+   free(fname);
+
+   python_rows = tmpfile();
+   if (python_rows == 0)
+      msg_error("Could not create a temporary file for: %s", "_sparsity.bin");
+
+   if (do_jacobian)
+   {
+      fname = concat(2, basename, "_jacobian.csv");
+      python_jacobian = outfile_open(fname);
+      if (python_jacobian == 0)
+         msg_error("Could not create file: %s", fname);
+      free(fname);
+      fprintf(python_jacobian, "lhs_vec,lhs_idx,rhs_vec,rhs_idx\n");
+   }
+
+   if (do_linear)
+   {
+      fname = concat(2, basename, "_linear.csv");
+      python_linear = outfile_open(fname);
+      if (python_linear == 0)
+         msg_error("Could not create file: %s", fname);
+      free(fname);
+      fprintf(python_linear, "lhs_vec,lhs_idx,rhs_vec,rhs_idx\n");
+
+      fname = concat(2, basename, "_linearity.csv");
+      python_linearity = outfile_open(fname);
+      if (python_linearity == 0)
+         msg_error("Could not create file: %s", fname);
+      free(fname);
+      fprintf(python_linearity, "lhs_vec,lhs_idx,linear,nonlinear\n");
+   }
+
+   if (cse_used())
+   {
+      python_cse = tmpfile();
+      if (python_cse == 0)
+         msg_error("Could not create a temporary file for: %s", "simplification counts");
+   }
+
+   if (do_hoist)
+      cse_hoist("self.pre");
+
    for (i = NUL; i <= UNK; i++)
       vecinfo[i] = PYTHON_ORIGIN;
 
@@ -860,8 +918,16 @@ void PYTHON_begin_file(char *basename)
    vecname[UNK] = "";
 
    fprintf(code, "import numpy as np\n");
-   fprintf(code, "from math import exp\n");
-   fprintf(code, "from math import log\n");
+   if (do_numpy)
+   {
+      fprintf(code, "from numpy import exp\n");
+      fprintf(code, "from numpy import log\n");
+   }
+   else
+   {
+      fprintf(code, "from math import exp\n");
+      fprintf(code, "from math import log\n");
+   }
    fprintf(code, "from gcubed.base_equations import BaseEquations\n");
    fprintf(code, "\n");
    fprintf(code, "\n");
@@ -882,13 +948,66 @@ void PYTHON_end_file()
    void *cur;
    char *err;
 
+   if (do_numpy)
+   {
+      fprintf(code, "\n    def evaluate_blocks(self):\n");
+      for (i = 1; i < MSGPROC_block; i++)
+         fprintf(code, "        self.block_%d()\n", i);
+   }
+
+   if (do_jacobian)
+   {
+      fprintf(code, "\n    def jacobian(self):\n");
+      fprintf(code, "        v = []\n");
+      for (i = 1; i < MSGPROC_block; i++)
+         fprintf(code, "        self.jacobian_block_%d(v)\n", i);
+      fprintf(code, "        return np.array(v)\n");
+   }
+
+   if (do_linear)
+   {
+      fprintf(code, "\n    def linear_coefficients(self):\n");
+      fprintf(code, "        v = []\n");
+      for (i = 1; i < MSGPROC_block; i++)
+         fprintf(code, "        self.linear_block_%d(v)\n", i);
+      fprintf(code, "        return np.array(v)\n");
+   }
+
+   //
+   //  derived constants, which the equations use in place of their
+   //  definitions
+   //
+
+   if (do_hoist)
+   {
+      fprintf(code, "\n    def precompute_parameters(self):\n");
+      fprintf(code, "        \"\"\"Compute the derived constants from the parameters.  Call\n");
+      fprintf(code, "        whenever the parameters change and before the equations.\n");
+      fprintf(code, "        Every constant is computed, so a parameter outside the domain\n");
+      fprintf(code, "        of any of them raises here, even for equations that are never\n");
+      fprintf(code, "        evaluated.\"\"\"\n");
+      fprintf(code, "        pre = [0.0] * %d\n", cse_derived());
+      for (i = 0; i < cse_derived(); i++)
+         fprintf(code, "        pre[%d] = %s\n", i, cse_definition(i));
+      fprintf(code, "        self.pre = %s\n", do_numpy ? "np.array(pre)" : "pre");
+   }
+
    fprintf(code, "\n# End of G-cubed equations class declaration\n");
 
-   fclose(python_varmap);
-   fclose(python_varinfo);
-   fclose(python_vars);
-   fclose(python_optmap);
-   fclose(python_eqnmap);
+   outfile_close(python_varmap);
+   outfile_close(python_varinfo);
+   outfile_close(python_vars);
+   outfile_close(python_optmap);
+   outfile_close(python_eqnmap);
+   sparsity_write(python_rows, python_sparsity, vecname, UNK + 1);
+   outfile_close(python_sparsity);
+   if (do_jacobian)
+      outfile_close(python_jacobian);
+   if (do_linear)
+   {
+      outfile_close(python_linear);
+      outfile_close(python_linearity);
+   }
 
    ecount = MSGPROC_scalar - 1;
    vcount = vecinfo[Z1L] + vecinfo[ZEL] + vecinfo[J1L] + vecinfo[X1L] - 4 * PYTHON_ORIGIN;
@@ -923,6 +1042,12 @@ void PYTHON_end_file()
    fprintf(info, "Endogenous Variables, Used:   %d\n", vcount - ucount);
    fprintf(info, "Endogenous Variables, Total:  %d\n", vcount);
 
+   if (cse_used())
+   {
+      cse_load(python_cse);
+      cse_report(info);
+   }
+
    //
    //  crash loudly if there's a mismatch
    //
@@ -946,14 +1071,12 @@ void PYTHON_declare(void *sym)
 {
    char *name;
    Variable *newvar;
-   Variable *cur, *nxt;
    List *attlist;
    List *vallist;
    char *curtype, setlist[1024], *desc;
-   int vecid, start, do_inc;
-   int my_Z1L, my_J1L, my_ZEL, my_X1L;
+   int vecid;
 
-   int i, j, check, found, count, vi;
+   int i, j, found, count, vi;
    validate(sym, SYMBOBJ, "PYTHON_declare");
 
    if (istype(sym, set))
@@ -973,7 +1096,6 @@ void PYTHON_declare(void *sym)
    newvar = (Variable *)malloc(sizeof(Variable));
    newvar->obj = PYTHONVAROBJ;
    newvar->str = name;
-   newvar->next = 0;
 
    //
    //  figure out how to write the old-style variable name in
@@ -996,7 +1118,7 @@ void PYTHON_declare(void *sym)
 
    attlist = symattrib(sym);
 
-   for (i = 0; (curtype = vlist[i].type); i++)
+   for (i = 0; (curtype = msgvec_types[i].type); i++)
    {
       if (*curtype == 0)
          FAULT("Corrupted vlist in Python_declare");
@@ -1023,7 +1145,7 @@ void PYTHON_declare(void *sym)
    if (istype(sym, par) && found == 0)
       FAULT("Failed to find parameter in vlist in PYTHON_declare");
 
-   newvar->type = vlist[vi].type;
+   newvar->type = msgvec_types[vi].type;
 
    //
    //  if this is a variable, figure out its units
@@ -1049,109 +1171,10 @@ void PYTHON_declare(void *sym)
 
    //
    //  get the current offset into each vector and then reserve space
-   //  for all of this variable's elements.  use my_* variables to synchronize
-   //  subscripts between vectors; set them to -1 initially to allow error
-   //  checks.
+   //  for all of this variable's elements.
    //
 
-   my_Z1L = -1;
-   my_J1L = -1;
-   my_ZEL = -1;
-   my_X1L = -1;
-
-   for (j = 0; j < 6; j++)
-   {
-      vecid = vlist[vi].vecid[j];
-      newvar->vecid[j] = vecid;
-
-      if (vecid == 0)
-      {
-         newvar->vecoff[j] = 0;
-         continue;
-      }
-
-      //  look up this vecid in the vecinfo table
-
-      if (vecid <= NUL || vecid >= UNK)
-         FAULT("Unrecognized vector id in PYTHON_declare");
-
-      //  figure out which counter to use.  this is a bit tricky because
-      //  we need to synchronize subscripts across certain sets of vectors.
-
-      start = vecinfo[vecid];
-      do_inc = 1;
-
-      switch (vecid)
-      {
-      //
-      // Z1L drives Z1R
-      //
-      case Z1L:
-         my_Z1L = start;
-         break;
-
-      case Z1R:
-         if (my_Z1L < 0)
-            FAULT("Z1R without Z1L");
-         start = my_Z1L;
-         do_inc = 0;
-         break;
-
-      //
-      // J1L drives YJR
-      //
-      case J1L:
-         my_J1L = start;
-         break;
-
-      case YJR:
-         if (my_J1L < 0)
-            FAULT("YJR without J1L");
-         start = my_J1L;
-         do_inc = 0;
-         break;
-
-      //
-      // ZEL drives ZER and EXZ
-      //
-      case ZEL:
-         my_ZEL = start;
-         break;
-
-      case ZER:
-      case EXZ:
-         if (my_ZEL < 0)
-            FAULT("ZER or EXZ without ZEL");
-         start = my_ZEL;
-         do_inc = 0;
-         break;
-
-      //
-      // X1L drives YXR and X1R
-      //
-      case X1L:
-         my_X1L = start;
-         break;
-
-      case YXR:
-      case X1R:
-         if (my_X1L < 0)
-            FAULT("YXR or X1R without X1L");
-         start = my_X1L;
-         do_inc = 0;
-         break;
-
-      //
-      // everything else drives itself
-      //
-      default:
-         break;
-      }
-
-      newvar->vecoff[j] = start;
-      if (do_inc)
-         vecinfo[vecid] += count;
-   }
+   msgvec_reserve(&msgvec_types[vi], count, vecinfo, newvar->vecid, newvar->vecoff);
 
    //
    //  entry is now complete
@@ -1167,7 +1190,7 @@ void PYTHON_declare(void *sym)
 
    if (DBG)
    {
-      printf("PYTHON_declare: %s, type %s, has %d elements -> ", name, vlist[vi].type, count);
+      printf("PYTHON_declare: %s, type %s, has %d elements -> ", name, newvar->type, count);
       for (j = 0; j < 6; j++)
       {
          vecid = newvar->vecid[j];
@@ -1194,57 +1217,13 @@ void PYTHON_declare(void *sym)
    free(desc);
 
    //
-   //  insert it into the list in alphabetical order
+   //  add it to the registry
    //
 
-   //  case 1: list is empty
-
-   if (v_head == 0)
-   {
-      v_head = newvar;
-      write_varmap(newvar, vallist);
-      freelist(vallist);
-      return;
-   }
-
-   cur = v_head;
-   check = strcasecmp(name, cur->str);
+   if (v_reg == 0)
+      v_reg = msgvec_newregistry();
 
-   if (check == 0)
-      FAULT("Multiple definitions of variable in PYTHON_declare");
-
-   //  case 2: insert before first existing entry
-
-   if (check < 0)
-   {
-      newvar->next = v_head;
-      v_head = newvar;
-      write_varmap(newvar, vallist);
-      freelist(vallist);
-      return;
-   }
-
-   //  case 3: anywhere else except the end
-
-   for (nxt = cur->next; nxt; nxt = nxt->next)
-   {
-      check = strcasecmp(name, nxt->str);
-      if (check == 0)
-         FAULT("Multiple definitions of variable in PYTHON_declare");
-      if (check < 0)
-      {
-         newvar->next = nxt;
-         cur->next = newvar;
-         write_varmap(newvar, vallist);
-         freelist(vallist);
-         return;
-      }
-      cur = nxt;
-   }
-
-   //  case 4: append after last element
-
-   cur->next = newvar;
+   msgvec_register(v_reg, name, newvar);
    write_varmap(newvar, vallist);
    freelist(vallist);
 }
@@ -1383,6 +1362,96 @@ void PYTHON_wrap_write(char *line, int addcr, int commaok)
    free(dup);
 }
 
+/*--------------------------------------------------------------------*
+ *  write_blocks
+ *
+ *  Write one job's run of equation blocks.  The job starts from
+ *  the block and scalar equation numbers it would have reached if
+ *  the earlier blocks had just been written.
+ *--------------------------------------------------------------------*/
+static void write_blocks(int job, FILE **streams, void *arg)
+{
+   Eqjobs *eqjobs;
+   void *eq;
+   List *eqnsets(), *eqsets;
+   int eqncount();
+   int i, s;
+
+   eqjobs = (Eqjobs *)arg;
+
+   code = streams[0];
+   python_eqnmap = streams[1];
+   python_rows = streams[2];
+   s = 3;
+   if (do_jacobian)
+      python_jacobian = streams[s++];
+   if (do_linear)
+   {
+      python_linear = streams[s++];
+      python_linearity = streams[s++];
+   }
+   if (cse_used())
+      python_cse = streams[s++];
+
+   i = eqjobs->start[job];
+   if (i < eqjobs->nblocks)
+   {
+      MSGPROC_block = eqjobs->blocks[i].block;
+      MSGPROC_scalar = eqjobs->blocks[i].scalar;
+   }
+
+   for (; i < eqjobs->start[job + 1]; i++)
+   {
+      List *sublist;
+
+      eq = eqjobs->blocks[i].eq;
+      eqsets = eqnsets(eq);
+
+      codegen_begin_block(eq);
+
+      if (do_numpy)
+         numpy_begin();
+      if (do_jacobian)
+         jacobian_begin();
+      if (do_linear)
+         linear_begin();
+
+      if (is_eqn_vector())
+      {
+         sublist = newsequence();
+         codegen_show_eq(eq, eqsets, sublist);
+         freelist(sublist);
+      }
+      else
+      {
+         Cart *tuples;
+         int neqns;
+         neqns = eqncount(eq);
+         tuples = cart_open(eqsets);
+         while (cart_step(tuples))
+         {
+            codegen_show_eq(eq, eqsets, cart_subs(tuples));
+            neqns--;
+         }
+         cart_close(tuples);
+         if (neqns)
+            FAULT("Incorrect number of equations written. Using # with a time set?");
+      }
+
+      if (do_numpy)
+         numpy_end(MSGPROC_block - 1);
+      if (do_jacobian)
+         jacobian_end(MSGPROC_block - 1);
+      if (do_linear)
+         linear_end(MSGPROC_block - 1);
+
+      eqsets = freelist(eqsets);
+   }
+
+   if (cse_used())
+      cse_save(python_cse);
+}
+
 /*--------------------------------------------------------------------*
  *  write_file
  *
@@ -1392,8 +1461,11 @@ void PYTHON_write_file(char *basename)
 {
    void *sym;
    void *eq;
-   List *eqnsets(), *eqsets;
    int eqncount();
+   Eqblock *blocks;
+   Eqjobs eqjobs;
+   FILE *streams[7];
+   int nblocks, nscalar, njobs, nstreams, *start, i, j;
 
    if (DBG)
       printf("write_file\n");
@@ -1442,6 +1514,9 @@ void PYTHON_write_file(char *basename)
    for (sym = firstsymbol(var); sym; sym = nextsymbol(sym))
       codegen_declare(sym);
 
+   if (do_prune)
+      write_prunemap(basename);
+
    if (DBG)
       xcheck("after declares");
 
@@ -1451,40 +1526,83 @@ void PYTHON_write_file(char *basename)
    //  to write a prefix and suffix to each equation, but the
    //  the main equation-writing is done by by show_eq.
    //
+   //  The blocks are split into runs of about the same number
+   //  of scalar equations and each run is written by its own
+   //  worker.  The output is the same as writing them in order.
+   //
 
+   nblocks = 0;
    for (eq = firsteqn(); eq; eq = nexteqn(eq))
-   {
-      List *sublist;
+      nblocks++;
+
+   blocks = (Eqblock *)xmalloc((nblocks + 1) * sizeof(Eqblock));
+   blocks[0].block = MSGPROC_block;
+   blocks[0].scalar = MSGPROC_scalar;
 
+   nblocks = 0;
+   nscalar = 0;
+   for (eq = firsteqn(); eq; eq = nexteqn(eq))
+   {
       if (hasundec(eq) || !istimeok(eq))
          continue;
+      blocks[nblocks].eq = eq;
+      blocks[nblocks].block = MSGPROC_block + nblocks;
+      blocks[nblocks].scalar = MSGPROC_scalar + nscalar;
+      nscalar += eqncount(eq);
+      nblocks++;
+   }
 
-      eqsets = eqnsets(eq);
-
-      codegen_begin_block(eq);
+   njobs = jobs > 0 ? jobs : workers_limit();
+   if (jobs <= 0 && njobs > nscalar / PYTHON_JOB_EQNS)
+      njobs = nscalar / PYTHON_JOB_EQNS;
+   if (njobs > nblocks)
+      njobs = nblocks;
+   if (njobs < 1 || DBG)
+      njobs = 1;
 
-      if (is_eqn_vector())
-      {
-         sublist = newsequence();
-         codegen_show_eq(eq, eqsets, sublist);
-         freelist(sublist);
-      }
-      else
-      {
-         int neqns;
-         neqns = eqncount(eq);
-         cart_build(eqsets);
-         while ((sublist = cart_next()))
-         {
-            codegen_show_eq(eq, eqsets, sublist);
-            neqns--;
-         }
-         if (neqns)
-            FAULT("Incorrect number of equations written. Using # with a time set?");
-      }
+   //
+   //  derived constants are numbered across the whole model
+   //
 
-      eqsets = freelist(eqsets);
+   if (do_hoist)
+      njobs = 1;
+
+   start = (int *)xmalloc((njobs + 1) * sizeof(int));
+   for (i = 0, j = 0; i < nblocks; i++)
+      while (j < njobs && (long)(blocks[i].scalar - blocks[0].scalar) * njobs >= (long)j * nscalar)
+         start[j++] = i;
+   while (j <= njobs)
+      start[j++] = nblocks;
+
+   eqjobs.blocks = blocks;
+   eqjobs.nblocks = nblocks;
+   eqjobs.start = start;
+
+   streams[0] = code;
+   streams[1] = python_eqnmap;
+   streams[2] = python_rows;
+   nstreams = 3;
+   if (do_jacobian)
+      streams[nstreams++] = python_jacobian;
+   if (do_linear)
+   {
+      streams[nstreams++] = python_linear;
+      streams[nstreams++] = python_linearity;
    }
+   if (cse_used())
+      streams[nstreams++] = python_cse;
+   workers_run(njobs, write_blocks, &eqjobs, streams, nstreams);
+
+   //
+   //  Leave the counters where writing the blocks in this process
+   //  would have left them
+   //
+
+   MSGPROC_block = blocks[0].block + nblocks;
+   MSGPROC_scalar = blocks[0].scalar + nscalar;
+
+   xfree(start);
+   xfree(blocks);
 
    if (DBG)
       xcheck("after equations");
@@ -1497,55 +1615,98 @@ void PYTHON_write_file(char *basename)
    if (DBG)
       xcheck("after end_file");
 
-   fclose(code);
-   fclose(info);
+   outfile_close(code);
+   outfile_close(info);
 }
 
 /*--------------------------------------------------------------------*
  *  show_eq
  *
  *  Generate and print a scalar equation by recursively descending
- *  through the node tree.
+ *  through the node tree.  With -cse, subexpressions used more than
+ *  once are assigned to local variables ahead of the equation, and
+ *  with -simplify the right side is simplified first.
  *--------------------------------------------------------------------*/
 void PYTHON_show_eq(void *eq, List *setlist, List *sublist)
 {
+   static Strbuf all = SB_INIT;
+   static Strbuf fname = SB_INIT;
+   static Strbuf temps = SB_INIT;
    Node *getlhs(), *getrhs();
-   char *lstr, *rstr, *all;
    char *head, *tail;
+   int lend, root, ntemps, k;
 
    writingEquations = 1;
+   nrefs = 0;
+
+   sb_reset(&all);
+   sb_add(&all, "        ");
+   codegen_show_node(&all, nul, getlhs(eq), setlist, sublist);
+   lend = all.len;
+   if (nrefs != 1)
+      FAULT("Left side is not a single vector element in show_eq");
+   sb_add(&all, is_eqn_normalized() ? " - (" : " = ");
+   ntemps = 0;
+   if (cse_used())
+   {
+      cse_begin("t");
+      root = cse_add(getrhs(eq), setlist, sublist);
+      ntemps = cse_end();
+      cse_show(&all, root);
+   }
+   else
+      codegen_show_node(&all, nul, getrhs(eq), setlist, sublist);
+   if (is_eqn_normalized())
+      sb_add(&all, ")");
 
-   lstr = codegen_show_node(nul, getlhs(eq), setlist, sublist);
-   rstr = codegen_show_node(nul, getrhs(eq), setlist, sublist);
-   
+   sparsity_row(python_rows, &refs[0], &refs[1], nrefs - 1);
 
-   codegen_begin_eqn(eq);
+   msgname_to_eqnname(&fname, all.str + 8, lend - 8);
 
-   char *functionName = msgname_to_eqnname(lstr);
-   fprintf(code, "    def %s:\n", functionName);
-   free(functionName);
+   if (do_jacobian)
+      jacobian_save(fname.str, all.str + 8, eq, setlist, sublist);
 
-   if (is_eqn_normalized())
-           all = concat(5, "        ",lstr, " - (", rstr, ")");
-   else 
-      all = concat(4, "        ",lstr, " = ", rstr);
+   if (ntemps)
+   {
+      sb_reset(&temps);
+      for (k = 1; k <= ntemps; k++)
+      {
+         sb_add(&temps, "        ");
+         sb_add(&temps, cse_name(k));
+         sb_add(&temps, " = ");
+         cse_temp(&temps, k);
+         sb_add(&temps, "\n");
+      }
+      sb_insert(&all, 0, temps.str);
+   }
+
+   if (do_linear)
+      linear_save(all.str + (ntemps ? temps.len : 0) + 8, eq, setlist, sublist);
+
+   if (do_numpy)
+   {
+      numpy_save(fname.str, all.str);
+      xarena_reset(XA_EQUATION);
+      writingEquations = 0;
+      return;
+   }
 
-   free(lstr);
-   free(rstr);
+   codegen_begin_eqn(eq);
+   fprintf(code, "    def %s:\n", fname.str);
 
    if (get_line_length() == 0)
    {
-      fprintf(code, "%s", all);
-      free(all);
+      fprintf(code, "%s", all.str);
+      xarena_reset(XA_EQUATION);
       codegen_end_eqn(eq);
       return;
    }
 
-   if (strlen(all) <= get_line_length())
-      fprintf(code, "%s", all);
+   if (all.len <= get_line_length())
+      fprintf(code, "%s", all.str);
    else
    {
-      for (head = all; (tail = strchr(head, '\n')); head = tail)
+      for (head = all.str; (tail = strchr(head, '\n')); head = tail)
       {
          *tail++ = '\0';
          codegen_wrap_write(head, 1, 0);
@@ -1553,97 +1714,407 @@ void PYTHON_show_eq(void *eq, List *setlist, List *sublist)
       codegen_wrap_write(head, 0, 0);
    }
 
-   free(all);
+   xarena_reset(XA_EQUATION);
    codegen_end_eqn(eq);
    writingEquations = 0;
 
 }
 
-char *str_replace(char *orig, char *rep, char *with)
+//----------------------------------------------------------------------//
+//  msgname_to_eqnname()
+//
+//  Build the name of an equation's function from the first 'len'
+//  characters of its left side: drop "self." and turn "x[n]" into
+//  "x_n(self)".
+//----------------------------------------------------------------------//
+
+static void msgname_to_eqnname(Strbuf *out, char *msgname, int len)
 {
-   char *result;  // the return string
-   char *ins;     // the next insert point
-   char *tmp;     // varies
-   int len_rep;   // length of rep (the string to remove)
-   int len_with;  // length of with (the string to replace rep with)
-   int len_front; // distance between rep and end of last rep
-   int count;     // number of replacements
-
-   // sanity checks and initialization
-   if (!orig || !rep)
-      return NULL;
-   len_rep = strlen(rep);
-   if (len_rep == 0)
-      return NULL; // empty rep causes infinite loop during count
-   if (!with)
-      with = "";
-   len_with = strlen(with);
-
-   // count the number of replacements needed
-   ins = orig;
-   for (count = 0; (tmp = strstr(ins, rep)); ++count)
+   char *c, *end, one[2];
+
+   sb_reset(out);
+   one[1] = '\0';
+
+   for (c = msgname, end = msgname + len; c < end; c++)
    {
-      ins = tmp + len_rep;
+      if (end - c >= 5 && strncmp(c, "self.", 5) == 0)
+      {
+         c += 4;
+         continue;
+      }
+      if (*c == '[')
+         sb_add(out, "_");
+      else if (*c == ']')
+         sb_add(out, "(self)");
+      else
+      {
+         one[0] = *c;
+         sb_add(out, one);
+      }
    }
+}
+
+//----------------------------------------------------------------------//
+//  numpy_begin()
+//
+//  Start saving the equations of a block for the -numpy option.
+//----------------------------------------------------------------------//
+
+static void numpy_begin(void)
+{
+   sb_reset(&nb_text);
+   sb_reset(&nb_names);
+   nb_used = 0;
+   nb_nrefs = 0;
+   nb_neqns = 0;
+   nb_same = 1;
+}
+
+//----------------------------------------------------------------------//
+//  numpy_save()
+//
+//  Save an equation of the current block and work out its form.
+//  Vector subscripts look like "self.z1r[120]"; each is replaced
+//  by "i[r, k]", where r counts the subscripts in the equation, and
+//  its value is added to the index table.
+//----------------------------------------------------------------------//
+
+static void numpy_save(char *fname, char *eqn)
+{
+   Strbuf *form;
+   char *c, *d, *e, save;
+   long *bigger;
+   char buf[32];
+   int r;
+
+   //
+   //  the scalar function exactly as show_eq would have written it
+   //
+
+   sb_add(&nb_text, "\n    def ");
+   sb_add(&nb_text, fname);
+   sb_add(&nb_text, ":\n");
+   sb_add(&nb_text, eqn);
+   sb_add(&nb_text, "\n");
 
-   tmp = result = malloc(strlen(orig) + (len_with - len_rep) * count + 1);
+   sb_add(&nb_names, fname);
+   sb_add(&nb_names, "\n");
+
+   nb_neqns++;
+   if (nb_same == 0)
+      return;
 
-   if (!result)
-      return NULL;
+   form = nb_neqns == 1 ? &nb_form : &nb_this;
+   sb_reset(form);
 
-   // first time through the loop, all the variable are set correctly
-   // from here on,
-   //    tmp points to the end of the result string
-   //    ins points to the next occurrence of rep in orig
-   //    orig points to the remainder of orig after "end of rep"
-   while (count--)
+   r = 0;
+   for (c = eqn; (d = strstr(c, "self.")); c = d)
    {
-      ins = strstr(orig, rep);
-      len_front = ins - orig;
-      tmp = strncpy(tmp, orig, len_front) + len_front;
-      tmp = strcpy(tmp, with) + len_with;
-      orig += len_front + len_rep; // move to next "end of rep"
+      for (d += 5; isalnum((unsigned char)*d) || *d == '_'; d++)
+         ;
+      if (*d != '[' || !isdigit((unsigned char)d[1]))
+         continue;
+      for (e = d + 1; isdigit((unsigned char)*e); e++)
+         ;
+      if (*e != ']')
+         continue;
+
+      if (nb_used == nb_size)
+      {
+         nb_size = nb_size ? 2 * nb_size : 4096;
+         bigger = (long *)xmalloc(nb_size * sizeof(long));
+         if (nb_used)
+            memcpy(bigger, nb_index, nb_used * sizeof(long));
+         if (nb_index)
+            xfree(nb_index);
+         nb_index = bigger;
+      }
+      nb_index[nb_used++] = strtol(d + 1, 0, 10);
+
+      save = d[1];
+      d[1] = '\0';
+      sb_add(form, c);
+      d[1] = save;
+
+      sprintf(buf, "i[%d, k]", r++);
+      sb_add(form, buf);
+      d = e;
    }
-   strcpy(tmp, orig);
-   return result;
+   sb_add(form, c);
+
+   if (nb_neqns == 1)
+      nb_nrefs = r;
+   else if (r != nb_nrefs || strcmp(nb_this.str, nb_form.str) != 0)
+      nb_same = 0;
 }
 
-// static char *msgname_to_eqnname(char *msgname)
-// {
-//    char *step1 = str_replace(msgname, "[", "_");
-//    char *step2 = str_replace(step2, "]", "()");
-//    free(step1);
-//    return step2;
-// }
+//----------------------------------------------------------------------//
+//  numpy_end()
+//
+//  Write the saved block.  If every equation has the same form, the
+//  block becomes one function that gathers its right side vectors
+//  through the index table and scatters the results to the left
+//  side vector in a single statement.  Calling it with k set to an
+//  equation's position in the block evaluates just that equation,
+//  which is how the usual per-equation functions are kept as thin
+//  wrappers.  Otherwise the scalar functions are written as usual
+//  and the block function calls each of them.
+//----------------------------------------------------------------------//
 
-static char *msgname_to_eqnname(char *msgname)
+static void numpy_end(int blk)
 {
+   char *name, *end;
+   int r, e, n;
+
+   if (nb_neqns == 0)
+   {
+      fprintf(code, "\n    def block_%d(self):\n        pass\n", blk);
+      return;
+   }
+
+   if (nb_same == 0)
+   {
+      fprintf(code, "%s", nb_text.str);
+      fprintf(code, "\n    def block_%d(self):\n", blk);
+      for (name = nb_names.str; (end = strchr(name, '(')); name = strchr(end, '\n') + 1)
+         fprintf(code, "        self.%.*s()\n", (int)(end - name), name);
+      return;
+   }
+
+   //
+   //  the index table has a row for each subscript in the form and
+   //  a column for each equation
+   //
+
+   fprintf(code, "\n    _block_%d = np.array([\n", blk);
+   for (r = 0; r < nb_nrefs; r++)
+   {
+      fprintf(code, "        [");
+      for (e = 0, n = 0; e < nb_neqns; e++)
+      {
+         if (e)
+            fprintf(code, n % 16 ? ", " : ",\n         ");
+         fprintf(code, "%ld", nb_index[e * nb_nrefs + r]);
+         n++;
+      }
+      fprintf(code, "],\n");
+   }
+   fprintf(code, "    ])\n");
 
-   char *step1 = str_replace(msgname, "self.", "");
-   char *step2 = str_replace(step1, "[", "_");
-   char *step3 = str_replace(step2, "]", "(self)");
-   free(step1);
-   free(step2);
-   return step3;
+   fprintf(code, "\n    def block_%d(self, k=slice(None)):\n", blk);
+   fprintf(code, "        i = self._block_%d\n", blk);
+   fprintf(code, "%s\n", nb_form.str);
+
+   for (name = nb_names.str, e = 0; (end = strchr(name, '\n')); name = end + 1, e++)
+      fprintf(code, "\n    def %.*s:\n        self.block_%d(%d)\n", (int)(end - name), name, blk, e);
 }
 
-    /*--------------------------------------------------------------------*
-     *  show_node
-     *
-     *  Generate the node recursively.  This allocates and frees a
-     *  lot of small chunks of memory as it constructs nodes from the
-     *  bottom up.  Avoids having any fixed buffer sizes but is a
-     *  bit tedious as a result.
-     *--------------------------------------------------------------------*/
-    char *
-    PYTHON_show_node(Nodetype prevtype, Node *cur, List *setlist, List *sublist)
+//----------------------------------------------------------------------//
+//  jacobian_begin()
+//
+//  Start saving the partial derivative functions of a block for the
+//  -jacobian option.
+//----------------------------------------------------------------------//
+
+static void jacobian_begin(void)
+{
+   sb_reset(&jb_text);
+   sb_reset(&jb_names);
+}
+
+//----------------------------------------------------------------------//
+//  jacobian_save()
+//
+//  Differentiate an equation with respect to each of the vector
+//  elements on its right side.  The partials are returned as a list
+//  by a function named after the equation with a "jac_" prefix,
+//  and for each one a line giving the vector and element of the
+//  left side and of the variable is written to the jacobian file.
+//  'lhs' is the equation's left side as written by show_eq.
+//----------------------------------------------------------------------//
+
+static void jacobian_save(char *fname, char *lhs, void *eq, List *setlist, List *sublist)
+{
+   Node *getrhs();
+   char lvec[16], rvec[16], buf[32], *c, *end;
+   long lidx, ridx;
+   int k, n;
+
+   if (sscanf(lhs, "self.%15[a-z0-9][%ld]", lvec, &lidx) != 2)
+      FAULT("Unexpected left side in jacobian_save");
+
+   writingPartials = 1;
+   deriv_eqn(getrhs(eq), setlist, sublist);
+   writingPartials = 0;
+
+   sb_add(&jb_names, fname);
+   sb_add(&jb_names, "\n");
+
+   sb_add(&jb_text, "\n    def jac_");
+   sb_add(&jb_text, fname);
+   sb_add(&jb_text, ":\n");
+
+   for (c = deriv_temps(), n = 1; (end = strchr(c, '\n')); c = end + 1, n++)
+   {
+      *end = '\0';
+      sprintf(buf, "        d%d = ", n);
+      sb_add(&jb_text, buf);
+      sb_add(&jb_text, c);
+      sb_add(&jb_text, "\n");
+      *end = '\n';
+   }
+
+   sb_add(&jb_text, "        return [");
+   for (k = 0; k < deriv_count(); k++)
+   {
+      if (sscanf(deriv_wrt(k), "self.%15[a-z0-9][%ld]", rvec, &ridx) != 2)
+         FAULT("Unexpected variable in jacobian_save");
+      fprintf(python_jacobian, "%s,%ld,%s,%ld\n", lvec, lidx, rvec, ridx);
+
+      if (k)
+         sb_add(&jb_text, ", ");
+      sb_add(&jb_text, deriv_partial(k));
+   }
+   sb_add(&jb_text, "]\n");
+}
+
+//----------------------------------------------------------------------//
+//  jacobian_end()
+//
+//  Write the saved partial derivative functions of a block and a
+//  function adding their values, in the order given in the jacobian
+//  file, to the end of a list.
+//----------------------------------------------------------------------//
+
+static void jacobian_end(int blk)
+{
+   char *name, *end;
+
+   fprintf(code, "%s", jb_text.str);
+   fprintf(code, "\n    def jacobian_block_%d(self, v):\n", blk);
+
+   if (jb_names.len == 0)
+      fprintf(code, "        pass\n");
+
+   for (name = jb_names.str; (end = strchr(name, '(')); name = strchr(end, '\n') + 1)
+      fprintf(code, "        v.extend(self.jac_%.*s())\n", (int)(end - name), name);
+}
+
+//----------------------------------------------------------------------//
+//  linear_begin()
+//
+//  Start saving the linear coefficients of a block for the -linear
+//  option.
+//----------------------------------------------------------------------//
+
+static void linear_begin(void)
+{
+   sb_reset(&lb_text);
+}
+
+//----------------------------------------------------------------------//
+//  linear_save()
+//
+//  Split an equation into linear terms.  A line giving the vector
+//  and element of the left side and of the variable is written to
+//  the linear file for each term, with the vector and element left
+//  blank for the constant, and the coefficients are added to the
+//  block's function in the same order.  A line giving the vectors
+//  used linearly and nonlinearly is written to the linearity file.
+//  'lhs' is the equation's left side as written by show_eq.
+//----------------------------------------------------------------------//
+
+static void linear_save(char *lhs, void *eq, List *setlist, List *sublist)
+{
+   static Strbuf vecs = SB_INIT;
+   Node *getrhs();
+   char lvec[16], rvec[16], key[20], *c;
+   long lidx, ridx;
+   int k, n;
+
+   if (sscanf(lhs, "self.%15[a-z0-9][%ld]", lvec, &lidx) != 2)
+      FAULT("Unexpected left side in linear_save");
+
+   writingPartials = 1;
+   n = cse_linear(getrhs(eq), setlist, sublist);
+   writingPartials = 0;
+
+   sb_reset(&vecs);
+   sb_add(&vecs, " ");
+
+   if (n)
+      sb_add(&lb_text, "        v.extend([");
+
+   for (k = 0; k < n; k++)
+   {
+      if (*cse_lin_wrt(k) == '\0')
+         fprintf(python_linear, "%s,%ld,,\n", lvec, lidx);
+      else
+      {
+         if (sscanf(cse_lin_wrt(k), "self.%15[a-z0-9][%ld]", rvec, &ridx) != 2)
+            FAULT("Unexpected variable in linear_save");
+         fprintf(python_linear, "%s,%ld,%s,%ld\n", lvec, lidx, rvec, ridx);
+         sprintf(key, " %s ", rvec);
+         if (strstr(vecs.str, key) == 0)
+            sb_add(&vecs, key + 1);
+      }
+
+      if (k)
+         sb_add(&lb_text, ", ");
+      cse_lin_coef(&lb_text, k);
+   }
+
+   if (n)
+      sb_add(&lb_text, "])\n");
+
+   //
+   //  vectors as space-separated lists without "self."
+   //
+
+   fprintf(python_linearity, "%s,%ld,%.*s,", lvec, lidx, vecs.len > 1 ? vecs.len - 2 : 0, vecs.str + 1);
+   for (c = cse_lin_nonlinear(), k = 0; *c; c = strchr(c, ' ') + 1, k++)
+   {
+      if (strncmp(c, "self.", 5) == 0)
+         c += 5;
+      fprintf(python_linearity, "%s%.*s", k ? " " : "", (int)strcspn(c, " "), c);
+   }
+   fprintf(python_linearity, "\n");
+}
+
+//----------------------------------------------------------------------//
+//  linear_end()
+//
+//  Write the function adding the saved linear coefficients of a
+//  block, in the order given in the linear file, to the end of a
+//  list.
+//----------------------------------------------------------------------//
+
+static void linear_end(int blk)
+{
+   fprintf(code, "\n    def linear_block_%d(self, v):\n", blk);
+
+   if (lb_text.len == 0)
+      fprintf(code, "        pass\n");
+   else
+      fprintf(code, "%s", lb_text.str);
+}
+
+/*--------------------------------------------------------------------*
+ *  show_node
+ *
+ *  Generate the node recursively, appending it to a string builder
+ *  from left to right.  Strings from show_symbol and the function
+ *  hooks are copied in and released with xrelease.  Subscript lists
+ *  for sums come from the equation arena, which show_eq resets once
+ *  the equation has been written.
+ *--------------------------------------------------------------------*/
+void PYTHON_show_node(Strbuf *out, Nodetype prevtype, Node *cur, List *setlist, List *sublist)
 {
 
    int parens, wrap_right;
-   char *buf, *newbuf;
    List *augsets, *augsubs, *sumover;
-   char *beginfunc, *endfunc;
-   char *lstr, *rstr, *cr;
+   char *endfunc;
+   char *lstr;
    char *lpar, *rpar;
    char *op, *thisop;
    int isfunc;
@@ -1651,7 +2122,7 @@ static char *msgname_to_eqnname(char *msgname)
    Context mycontext;
 
    if (cur == 0)
-      return strdup("");
+      return;
 
    mycontext.lhs = cur->lhs;
    mycontext.dt = cur->dt;
@@ -1754,14 +2225,17 @@ static char *msgname_to_eqnname(char *msgname)
    switch (cur->type)
    {
    case nam:
-      return show_symbol(cur->str, cur->domain, setlist, sublist, mycontext);
+      sb_take(out, show_symbol(cur->str, cur->domain, setlist, sublist, mycontext));
+      return;
 
    case lag:
    case led:
-      return codegen_show_node(cur->type, cur->r, setlist, sublist);
+      codegen_show_node(out, cur->type, cur->r, setlist, sublist);
+      return;
 
    case dom:
-      return codegen_show_node(cur->type, cur->l, setlist, sublist);
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      return;
 
    case lst:
       FAULT("Unexpected lst state in show_node");
@@ -1784,7 +2258,7 @@ static char *msgname_to_eqnname(char *msgname)
 
          lstr = (cur->l)->str;
 
-         augsets = newsequence();
+         augsets = tmpsequence(XA_EQUATION);
          catlist(augsets, setlist);
          addlist(augsets, lstr);
 
@@ -1792,15 +2266,22 @@ static char *msgname_to_eqnname(char *msgname)
          lpar = (cur->type == prd) ? "(" : "";
          rpar = (cur->type == prd) ? ")" : "";
 
-         buf = strdup("(");
+         sb_add(out, "(");
          thisop = " ";
 
-         sumover = setelements(lstr);
+         //
+         //  the subscripts for each term differ only in the last
+         //  one, which is replaced in place for each element
+         //
+
+         sumover = setmembers(lstr);
+         augsubs = tmpsequence(XA_EQUATION);
+         catlist(augsubs, sublist);
+         addlist(augsubs, sumover->n ? sumover->first->str : "");
+
          for (ele = sumover->first; ele; ele = ele->next)
          {
-            augsubs = newsequence();
-            catlist(augsubs, sublist);
-            addlist(augsubs, ele->str);
+            setitem(augsubs, augsubs->n - 1, ele);
 
             if (DBG)
             {
@@ -1808,25 +2289,17 @@ static char *msgname_to_eqnname(char *msgname)
                printf("augsets = %s\n", slprint(augsets));
             }
 
-            rstr = codegen_show_node(cur->type, cur->r, augsets, augsubs);
-            newbuf = concat(6, buf, " ", thisop, lpar, rstr, rpar);
+            sb_add(out, " ");
+            sb_add(out, thisop);
+            sb_add(out, lpar);
+            codegen_show_node(out, cur->type, cur->r, augsets, augsubs);
+            sb_add(out, rpar);
 
             thisop = op;
-
-            free(buf);
-            free(rstr);
-            freelist(augsubs);
-
-            buf = newbuf;
          }
 
-         newbuf = concat(2, buf, ")");
-         free(buf);
-
-         freelist(augsets);
-         freelist(sumover);
-
-         return newbuf;
+         sb_add(out, ")");
+         return;
       }
 
    //
@@ -1840,79 +2313,69 @@ static char *msgname_to_eqnname(char *msgname)
 
       lstr = (cur->l)->str;
 
-      augsets = newsequence();
+      augsets = tmpsequence(XA_EQUATION);
       catlist(augsets, setlist);
       addlist(augsets, lstr);
 
-      augsubs = newsequence();
+      augsubs = tmpsequence(XA_EQUATION);
       catlist(augsubs, sublist);
       addlist(augsubs, "*");
 
-      beginfunc = codegen_begin_func(cur->str, lstr);
-      rstr = codegen_show_node(cur->type, cur->r, augsets, augsubs);
-      endfunc = codegen_end_func();
-
-      buf = concat(3, beginfunc, rstr, endfunc);
-
-      free(beginfunc);
-      free(rstr);
-      free(endfunc);
-
-      freelist(augsubs);
-      freelist(augsets);
-
-      return buf;
+      sb_take(out, codegen_begin_func(cur->str, lstr));
+      codegen_show_node(out, cur->type, cur->r, augsets, augsubs);
+      sb_take(out, codegen_end_func());
+      return;
    }
 
    //
    //  case 4: everything else
    //
 
+   isfunc = now(log) || now(exp);
+
+   lpar = (parens && isfunc == 0) ? "(" : "";
+   rpar = (parens && isfunc == 0) ? ")" : "";
+
+   wrap_right = 0;
+   if (cur->type == sub)
+      if (cur->r->type == add || cur->r->type == sub)
+         wrap_right = 1;
+
+   sb_add(out, lpar);
+
    switch (cur->type)
    {
    case log:
    case exp:
-      isfunc = 1;
-      lstr = codegen_begin_func(cur->str, 0);
+      sb_take(out, codegen_begin_func(cur->str, 0));
       endfunc = codegen_end_func();
       op = "";
       break;
 
    case pow:
-      isfunc = 0;
-      lstr = codegen_show_node(cur->type, cur->l, setlist, sublist);
-      endfunc = strdup("");
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      endfunc = 0;
       // GCS 2022-12-15 Modified power operator to ** instead of ^
       op = "**";
       break;
 
    default:
-      isfunc = 0;
-      lstr = codegen_show_node(cur->type, cur->l, setlist, sublist);
-      endfunc = strdup("");
+      codegen_show_node(out, cur->type, cur->l, setlist, sublist);
+      endfunc = 0;
       op = cur->str;
    }
 
-   rstr = codegen_show_node(cur->type, cur->r, setlist, sublist);
-
-   lpar = (parens && isfunc == 0) ? "(" : "";
-   rpar = (parens && isfunc == 0) ? ")" : "";
-
-   wrap_right = 0;
-   if (cur->type == sub)
-      if (cur->r->type == add || cur->r->type == sub)
-         wrap_right = 1;
-
+   sb_add(out, op);
    if (wrap_right)
-      buf = concat(8, lpar, lstr, op, "(", rstr, ")", rpar, endfunc);
-   else
-      buf = concat(6, lpar, lstr, op, rstr, rpar, endfunc);
+      sb_add(out, "(");
 
-   free(lstr);
-   free(rstr);
-   free(endfunc);
+   codegen_show_node(out, cur->type, cur->r, setlist, sublist);
 
-   return buf;
+   if (wrap_right)
+      sb_add(out, ")");
+   sb_add(out, rpar);
+   if (endfunc)
+      sb_take(out, endfunc);
 }
 
 //----------------------------------------------------------------------//
@@ -1941,3 +2404,95 @@ void Python_setup(void)
 
 // GCS 2022-11-22 incremented from latest MSGPROC revision.
 char *Python_version = "$Revision: 58 $";
+
+//----------------------------------------------------------------------//
+//
+//  write_prunemap()
+//
+//  With -prune, write each element of the vectors alongside the
+//  position it would have had without pruning.  The original
+//  positions are found by reserving space for every parameter and
+//  variable, dropped or not, in the order they would have been
+//  declared.
+//
+//----------------------------------------------------------------------//
+
+static void write_prunemap(char *basename)
+{
+   Symboltype types[2] = {par, var};
+   int origvec[UNK + 1], vecid[6], vecoff[6];
+   Variable *thisvar;
+   Cart *tuples;
+   List *setlist, *cur;
+   char *fname, *name;
+   void *sym;
+   int i, j, k, t, vi;
+
+   fname = concat(2, basename, "_prunemap.csv");
+   python_prunemap = outfile_open(fname);
+   if (python_prunemap == 0)
+      msg_error("Could not create file: %s", fname);
+   free(fname);
+   fprintf(python_prunemap, "vec,idx,original_idx,name\n");
+
+   for (i = NUL; i <= UNK; i++)
+      origvec[i] = PYTHON_ORIGIN;
+
+   for (t = 0; t < 2; t++)
+      for (sym = firstdeclared(types[t]); sym; sym = nextdeclared(sym))
+      {
+         //
+         //  the type PYTHON_declare would have found
+         //
+
+         vi = -1;
+         for (i = 0; msgvec_types[i].type && vi < 0; i++)
+            if (istype(sym, par) ? strcmp(msgvec_types[i].type, "par") == 0
+                                 : isattrib(sym, msgvec_types[i].type))
+               vi = i;
+         if (vi < 0)
+            continue;
+
+         msgvec_reserve(&msgvec_types[vi], symsize(sym), origvec, vecid, vecoff);
+         if (isdropped(sym))
+            continue;
+
+         //
+         //  each vector the symbol uses, once
+         //
+
+         name = symname(sym);
+         thisvar = (Variable *)msgvec_find(v_reg, name);
+         validate(thisvar, PYTHONVAROBJ, "write_prunemap");
+         free(name);
+
+         setlist = symvalue(sym);
+         tuples = cart_open(setlist);
+
+         for (j = 0; j < 6; j++)
+         {
+            if (thisvar->vecid[j] == 0)
+               continue;
+            for (k = 0; k < j; k++)
+               if (thisvar->vecid[k] == thisvar->vecid[j])
+                  break;
+            if (k < j)
+               continue;
+
+            cart_rewind(tuples);
+            while (cart_step(tuples))
+            {
+               cur = cart_subs(tuples);
+               fprintf(python_prunemap, "%s,%ld,%ld,\"%s(%s)\"\n", vecname[thisvar->vecid[j]],
+                       sub_ravel(thisvar->str, cur, thisvar->vecoff[j]),
+                       sub_ravel(thisvar->str, cur, vecoff[j]),
+                       thisvar->str, slprint(cur));
+            }
+         }
+
+         cart_close(tuples);
+         freelist(setlist);
+      }
+
+   outfile_close(python_prunemap);
+}
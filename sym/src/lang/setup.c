@@ -10,6 +10,7 @@ void Tablo_setup(void);
 void Html_setup(void);
 // GCS 2022-11-22 addition for Python version of GCubed
 void Python_setup(void);
+void C_setup(void);
 
 extern char *Debug_version;
 extern char *Msgproc_version;
@@ -21,6 +22,7 @@ extern char *Tablo_version;
 extern char *Html_version;
 // GCS 2022-11-22 addition for Python version of GCubed
 extern char *Python_version;
+extern char *C_version;
 
 void setup_languages()
 {
@@ -34,4 +36,5 @@ void setup_languages()
    addlang("html", Html_setup, Html_version);
    // GCS 2022-11-22 addition for Python version of GCubed
    addlang("python", Python_setup, Python_version);
+   addlang("c", C_setup, C_version);
 }
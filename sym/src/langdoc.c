@@ -2,6 +2,14 @@
 void langdoc()
 {
    char from_lang[]={"\
+### c\n\
+\n\
+Write the equations of a G-Cubed model as a C source file that can\n\
+be compiled into a shared library and called from Python.\n\
+\n\
++ Variables are mapped into the same MSGPROC vectors, at the same\n\
+  offsets, as the python target.\n\
+\n\
 ### debug\n\
 \n\
 Write out in a format useful for checking equations.\n\
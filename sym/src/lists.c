@@ -3,11 +3,25 @@
  *  Mar 04 (PJW)
  *
  *  Basic routines for managing lists of strings
+ *
+ *  Items are chained through their next pointers so callers can
+ *  walk a list from list->first, but the list also keeps a vector
+ *  of its items in order.  Appending to a sequence is therefore
+ *  constant time and sorted lists are searched by bisection.
+ *
+ *  Item strings are interned and each item also carries the interned
+ *  lower case key for its string, so two items match exactly when
+ *  their keys are the same pointer.
+ *
+ *  A sequence created by tmpsequence() takes all of its memory from
+ *  one of the arenas in xmalloc.c and is released in bulk when the
+ *  arena is reset; freeing it or its items does nothing.
  *--------------------------------------------------------------------*/
 
 #include "lists.h"
 
 #include "error.h"
+#include "intern.h"
 #include "str.h"
 #include "sym.h"
 #include "xmalloc.h"
@@ -16,10 +30,176 @@
 #include <string.h>
 
 #define SLBUFSIZE 8096
+#define LISTMINSIZE 8
 
 static int nlists=0;
 
 
+//
+//  Private methods
+//
+
+/*--------------------------------------------------------------------*
+ * keycmp: compare two interned keys
+ *--------------------------------------------------------------------*/
+#define keycmp(a,b) ( (a)==(b) ? 0 : strcmp(a,b) )
+
+
+/*--------------------------------------------------------------------*
+ * findpos: locate a key in a list
+ *
+ * Returns the zero-based position of the key, or -1 if it is not
+ * present.  For sorted lists, *where is set to the position at
+ * which the key would be inserted.
+ *--------------------------------------------------------------------*/
+static int findpos( List *list, char *key, int *where )
+{
+   int lo,hi,mid,check;
+
+   if( list->sort == 0 )
+      {
+      for( lo=0 ; lo < list->n ; lo++ )
+         if( list->vec[lo]->key == key )return lo;
+      if( where )*where = list->n;
+      return -1;
+      }
+
+   lo = 0;
+   hi = list->n;
+   while( lo < hi )
+      {
+      mid = (lo+hi)/2;
+      check = keycmp(key,list->vec[mid]->key);
+      if( check == 0 )return mid;
+      if( check < 0 )
+         hi = mid;
+      else
+         lo = mid+1;
+      }
+
+   if( where )*where = lo;
+   return -1;
+}
+
+
+/*--------------------------------------------------------------------*
+ * lalloc, lfree: get and release memory for a list
+ *--------------------------------------------------------------------*/
+static void *lalloc( List *list, int size )
+{
+   if( list->arena >= 0 )
+      return xarena( list->arena, size );
+   return xmalloc( size );
+}
+
+static void lfree( List *list, void *ptr )
+{
+   if( list->arena < 0 )
+      xfree( ptr );
+}
+
+
+/*--------------------------------------------------------------------*
+ * reserve: make sure the vector has room for at least n items
+ *--------------------------------------------------------------------*/
+static void reserve( List *list, int n )
+{
+   Item **vec;
+   int size;
+
+   if( n <= list->size )return;
+
+   size = list->size ? list->size : LISTMINSIZE ;
+   while( size < n )
+      size *= 2;
+
+   vec = (Item **) lalloc( list, size*sizeof(Item *) );
+   if( list->n )
+      memcpy( vec, list->vec, list->n*sizeof(Item *) );
+   if( list->vec )
+      lfree( list, list->vec );
+
+   list->vec  = vec;
+   list->size = size;
+}
+
+
+/*--------------------------------------------------------------------*
+ * insertitem: put an item at a given position in a list
+ *--------------------------------------------------------------------*/
+static void insertitem( List *list, Item *item, int pos )
+{
+   reserve( list, list->n+1 );
+
+   if( pos < list->n )
+      memmove( &list->vec[pos+1], &list->vec[pos],
+         (list->n-pos)*sizeof(Item *) );
+
+   list->vec[pos] = item;
+   list->n++;
+
+   item->next = pos+1 < list->n ? list->vec[pos+1] : 0 ;
+   if( pos == 0 )
+      list->first = item;
+   else
+      list->vec[pos-1]->next = item;
+}
+
+
+/*--------------------------------------------------------------------*
+ * relink: rebuild the chain of next pointers from the vector
+ *--------------------------------------------------------------------*/
+static void relink( List *list )
+{
+   int i;
+
+   list->first = list->n ? list->vec[0] : 0 ;
+   for( i=0 ; i < list->n ; i++ )
+      list->vec[i]->next = i+1 < list->n ? list->vec[i+1] : 0 ;
+}
+
+
+/*--------------------------------------------------------------------*
+ *  additem
+ *
+ *  Add a new item to a list, or discard it if the list is sorted
+ *  and already has the same string.
+ *--------------------------------------------------------------------*/
+static void additem( List *list, Item *new )
+{
+   int pos,check;
+
+   if( list->sort == 0 || list->n == 0 )
+      {
+      insertitem( list, new, list->n );
+      return;
+      }
+
+   //
+   //  strings often arrive in order so check the end first
+   //
+
+   check = keycmp( new->key, list->vec[list->n-1]->key );
+   if( check > 0 )
+      {
+      insertitem( list, new, list->n );
+      return;
+      }
+
+   if( check == 0 || findpos(list,new->key,&pos) >= 0 )
+      {
+      lfree( list, new );
+      return;
+      }
+
+   insertitem( list, new, pos );
+}
+
+
+//
+//  Public methods
+//
+
 /*--------------------------------------------------------------------*
  * newlist: create a new list
  *--------------------------------------------------------------------*/
@@ -33,6 +213,9 @@ List *newlist()
    new->n     = 0;
    new->first = 0;
    new->sort  = 1;   
+   new->vec   = 0;
+   new->size  = 0;
+   new->arena = -1;
    return new;
 }
 
@@ -51,49 +234,148 @@ List *newsequence()
 
 
 /*--------------------------------------------------------------------*
- * duplist: copy a list, preserving its characteristics
+ * tmpsequence: create an ordered list that lives in an arena
  *--------------------------------------------------------------------*/
-List *duplist( List *oldlist )
+List *tmpsequence( int arena )
 {
    List *new;
-   validate( oldlist, LISTOBJ, "duplist" );
-   if( oldlist->sort )
-      new = newlist();
-   else
-      new = newsequence();
-   catlist( new, oldlist );
+
+   new = (List *) xarena( arena, sizeof(List) );
+   new->obj   = LISTOBJ;
+   new->id    = ++nlists;
+   new->n     = 0;
+   new->first = 0;
+   new->sort  = 0;   
+   new->vec   = 0;
+   new->size  = 0;
+   new->arena = arena;
    return new;
 }
 
 
 /*--------------------------------------------------------------------*
- * newlistitem: create a new list item
+ * newlistitem: create a new item for a list
  *--------------------------------------------------------------------*/
-Item *newlistitem(string)
-char *string;
+static Item *newlistitem( List *list, char *string )
 {
    Item *new;
-   new = (Item *) xmalloc( sizeof(Item) );
+   new = (Item *) lalloc( list, sizeof(Item) );
    new->obj  = ITEMOBJ;
-   new->str  = strdup( string );
+   new->str  = intern( string );
+   new->key  = internkey( string );
    new->next = 0;
    return new;
 }
 
 
+/*--------------------------------------------------------------------*
+ * copyitem: create a new item with the same string as an old one
+ *--------------------------------------------------------------------*/
+static Item *copyitem( List *list, Item *old )
+{
+   Item *new;
+   new = (Item *) lalloc( list, sizeof(Item) );
+   new->obj  = ITEMOBJ;
+   new->str  = old->str;
+   new->key  = old->key;
+   new->next = 0;
+   return new;
+}
+
+
+/*--------------------------------------------------------------------*
+ * duplist: copy a list, preserving its characteristics
+ *--------------------------------------------------------------------*/
+List *duplist( List *oldlist )
+{
+   List *new;
+   int i;
+
+   validate( oldlist, LISTOBJ, "duplist" );
+   if( oldlist->sort )
+      new = newlist();
+   else
+      new = newsequence();
+
+   //
+   //  the items are already in order so just copy them across
+   //
+
+   reserve( new, oldlist->n );
+   for( i=0 ; i < oldlist->n ; i++ )
+      new->vec[i] = copyitem( new, oldlist->vec[i] );
+   new->n = oldlist->n;
+   relink( new );
+
+   return new;
+}
+
+
 /*--------------------------------------------------------------------*
  * catlist: concatenate lists
+ *
+ * When both lists are sorted they are merged in a single pass.
  *--------------------------------------------------------------------*/
 List *catlist(target,source)
 List *target,*source;
 {
-   Item *item;
+   Item **vec,**a,**b;
+   int i,m,n,k,check;
 
    validate( target, LISTOBJ, "catlist" );
    validate( source, LISTOBJ, "catlist" );
 
-   for( item=source->first ; item ; item=item->next )
-      addlist( target, item->str );
+   m = source->n;
+
+   if( target->sort == 0 || source->sort == 0 || target->n == 0 )
+      {
+      for( i=0 ; i < m ; i++ )
+         additem( target, copyitem(target,source->vec[i]) );
+      return target;
+      }
+
+   if( target == source )return target;
+
+   //
+   //  merge two sorted lists, keeping the target's copy of any
+   //  string that appears in both
+   //
+
+   n   = target->n;
+   a   = target->vec;
+   b   = source->vec;
+   vec = (Item **) lalloc( target, (n+m)*sizeof(Item *) );
+
+   k = 0;
+   while( n && m )
+      {
+      check = keycmp( (*a)->key, (*b)->key );
+      if( check <= 0 )
+         {
+         vec[k++] = *a++;
+         n--;
+         if( check == 0 )
+            {
+            b++;
+            m--;
+            }
+         }
+      else
+         {
+         vec[k++] = copyitem( target, *b++ );
+         m--;
+         }
+      }
+   while( n-- )
+      vec[k++] = *a++;
+   while( m-- )
+      vec[k++] = copyitem( target, *b++ );
+
+   lfree( target, target->vec );
+   target->vec  = vec;
+   target->size = target->n + source->n;
+   target->n    = k;
+   relink( target );
 
    return target;
 }
@@ -106,39 +388,33 @@ void freeitem(list,string)
 List *list;
 char *string;
 {
-   Item *item,*prev;
+   Item *item;
+   char *key;
+   int pos;
 
    validate( list, LISTOBJ, "freeitem" );
 
-   item = list->first;
-
    if( list->n < 1 )
       fatal_error("%s","internal error in freeitem");
 
-   if( isequal(string,item->str) )
-      {
+   key = findkey( string );
+   pos = key ? findpos( list, key, 0 ) : -1 ;
+   if( pos < 0 )
+      fatal_error("%s","internal error in freeitem");
+
+   item = list->vec[pos];
+
+   if( pos == 0 )
       list->first = item->next;
-      free(item->str);
-      xfree(item);
-      list->n--;
-      return;
-      }
-   
-   while( item->next )
-      {
-      prev = item ;
-      item = item->next;
-      if( isequal(string,item->str) )
-         {
-         prev->next = item->next;
-         free(item->str);
-         xfree(item);
-         list->n--;
-         return;
-         }
-      }
+   else
+      list->vec[pos-1]->next = item->next;
 
-   fatal_error("%s","internal error in freeitem");
+   list->n--;
+   if( pos < list->n )
+      memmove( &list->vec[pos], &list->vec[pos+1],
+         (list->n-pos)*sizeof(Item *) );
+
+   lfree( list, item );
 }
 
 
@@ -148,20 +424,19 @@ char *string;
 List *freelist(list)
 List *list;
 {
-   Item *item,*next;
+   int i;
 
    if( list==0 )return 0;
 
    validate( list, LISTOBJ, "freelist" );
 
-   item = list->first;
-   while( item )
-      {
-      next = item->next ;
-      free( item->str );
-      xfree( item );
-      item = next;
-      }
+   if( list->arena >= 0 )return 0;
+
+   for( i=0 ; i < list->n ; i++ )
+      xfree( list->vec[i] );
+
+   if( list->vec )
+      xfree( list->vec );
 
    xfree( list );
 
@@ -180,58 +455,36 @@ List *addlist(list,string)
 List *list;
 char *string;
 {
-   Item *new,*cur,*nxt;
-   int check;
-   
    validate( list, LISTOBJ, "addlist" );
 
-   cur = list->first;
+   additem( list, newlistitem(list,string) );
+   return list;
+}
 
-   if( cur == 0 )
-      {
-      list->first = newlistitem(string);
-      list->n++;
-      return list;
-      }
 
-   if( list->sort == 0 )
-      {
-      while( cur->next )cur=cur->next;
-      cur->next = newlistitem(string);
-      list->n++;
-      return list;
-      }
-      
-   check = strcasecmp(string,cur->str);
-   if( check == 0 )return list;
+/*--------------------------------------------------------------------*
+ *  setitem
+ *
+ *  Replace the string at a given position in a sequence with the
+ *  string held by an item of some other list.  No memory is
+ *  allocated, so a caller can reuse one list for a stream of
+ *  values.
+ *--------------------------------------------------------------------*/
+void setitem(List *list, int pos, Item *from)
+{
+   Item *item;
 
-   if( check  < 0  )
-      {
-      new = newlistitem(string);
-      list->first = new;
-      new->next   = cur;
-      list->n++;
-      return list;
-      }
-   
-   for( nxt=cur->next ; nxt ; nxt=nxt->next )
-      {
-      check = strcasecmp(string,nxt->str);
-      if( check == 0 )return list;
-      if( check  < 0 )
-         {
-         new = newlistitem(string);
-         cur->next = new;
-         new->next = nxt;
-         list->n++;
-         return list;
-         }
-      cur=nxt; 
-      }
-            
-   cur->next = newlistitem(string);
-   list->n++;
-   return list;
+   validate( list, LISTOBJ, "setitem" );
+   validate( from, ITEMOBJ, "setitem" );
+
+   if( list->sort )
+      fatal_error("%s","setitem called on a sorted list");
+   if( pos < 0 || pos >= list->n )
+      fatal_error("%s","invalid position in setitem");
+
+   item = list->vec[pos];
+   item->str = from->str;
+   item->key = from->key;
 }
 
 
@@ -242,15 +495,14 @@ int ismember(string,list)
 char *string;
 List *list;
 {
-   Item *cur;
-   int index;
-   
+   char *key;
+
    validate( list, LISTOBJ, "ismember" );
 
-   for( index=1, cur=list->first ; cur ; index++, cur=cur->next )
-      if( isequal(string,cur->str) )return index;
+   key = findkey( string );
+   if( key == 0 )return 0;
 
-   return 0;
+   return findpos( list, key, 0 ) + 1;
 }
 
 
@@ -317,17 +569,37 @@ List *list;
 List *intersect(List *a, List *b)
 {
    List *result;
-   Item *ai;
+   int i,j,check;
    
    validate( a, LISTOBJ, "intersect" );
    validate( b, LISTOBJ, "intersect" );
    
    result = newlist();
 
-   for( ai=a->first ; ai ; ai=ai->next )
-      if( ismember(ai->str,b) )
-         addlist( result, ai->str );
+   if( a->sort && b->sort )
+      {
+      i = 0;
+      j = 0;
+      while( i < a->n && j < b->n )
+         {
+         check = keycmp( a->vec[i]->key, b->vec[j]->key );
+         if( check == 0 )
+            {
+            insertitem( result, copyitem(result,a->vec[i]), result->n );
+            i++;
+            j++;
+            }
+         else if( check < 0 )
+            i++;
+         else
+            j++;
+         }
+      return result;
+      }
+
+   for( i=0 ; i < a->n ; i++ )
+      if( ismember(a->vec[i]->str,b) )
+         addlist( result, a->vec[i]->str );
 
    return result;
 }
-
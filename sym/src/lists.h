@@ -9,6 +9,7 @@ typedef struct item_struct
    {
    int obj;
    char *str;
+   char *key;                    // str folded to lower case
    struct item_struct *next;
    } 
    Item ;
@@ -24,6 +25,9 @@ typedef struct
    int n ;
    int sort ;
    Item *first ;
+   Item **vec ;                  // items in list order
+   int size ;                    // slots allocated in vec
+   int arena ;                   // arena holding the list, or -1
    } 
    List ;
 
@@ -38,8 +42,10 @@ List* freelist(List*);
 List* intersect(List*,List*);
 List* newlist(void);
 List* newsequence(void);
+List* tmpsequence(int);
 char* slprint(List*);
 int   ismember(char*, List*);
 void  freeitem(List*,char*);
+void  setitem(List*,int,Item*);
 
 #endif /* LISTS_H */
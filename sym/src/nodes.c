@@ -8,6 +8,7 @@
 #include "nodes.h"
 
 #include "error.h"
+#include "intern.h"
 #include "sym.h"
 #include "xmalloc.h"
 #include <stdio.h>
@@ -46,7 +47,7 @@ Node *newnode(Nodetype kind, char *string, Node *left, Node *right)
    new->l      = left;
    new->r      = right;
    new->type   = kind;
-   new->str    = strdup( string );
+   new->str    = intern( string );
    new->domain = 0;
    new->undec  = 0;
    new->lhs    = 0;
@@ -70,7 +71,6 @@ void freenode(Node *cur)
    if( cur->l   )freenode( cur->l );
    if( cur->r   )freenode( cur->r );
 
-   if( cur->str )free( cur->str );
    freelist( cur->domain );
    xfree( cur );
 
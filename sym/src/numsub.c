@@ -49,140 +49,202 @@
  * 
  *  Under offset translation, the 'offset' argument is added to 
  *  the result.
+ *
+ *  The first time an identifier is translated its layout is saved:
+ *  the element index of each of its sets and the stride of each 
+ *  dimension, so later translations are a lookup per subscript and
+ *  a multiply-add.  sub_ravel returns the offset as a number; 
+ *  sub_offset and sub_tuple return lists of strings for callers
+ *  that want them.
  *-------------------------------------------------------------------*/
 
+#include "dict.h"
 #include "error.h"
 #include "lists.h"
+#include "output.h"
 #include "sets.h"
 #include "sym.h"
 #include "symtable.h"
+#include "xmalloc.h"
 #include <stdio.h>
 
-enum substyle { tuples, offsets };
+#define LAYOUTOBJ 2011
+
+typedef struct
+   {
+   int obj;
+   int n;            // number of dimensions
+   void **index;     // element index of each set
+   long *stride;     // distance between consecutive elements
+   } 
+   Layout;
 
-static List *numsub( char*, List*, enum substyle, int );
+static void *layouts=0;
 
 
 /*-------------------------------------------------------------------*
- *  sub_offset
+ *  get_layout
  *
- *  Generate an offset-style subscript.
+ *  Return the layout of an identifier, working it out and saving
+ *  it on first use.  Declarations are complete by the time any
+ *  subscripts are translated, so a layout never changes.
  *-------------------------------------------------------------------*/
-List *sub_offset( char *name, List *subs, int offset )
+static Layout *get_layout( char *name )
 {
-   return numsub(name,subs,offsets,offset);
+   Layout *lay;
+   void *sym;
+   List *sets;
+   Item *set;
+   int i,n;
+
+   if( layouts == 0 )
+      layouts = newdict(256);
+
+   lay = (Layout *) getdict(layouts,name);
+   if( lay )return lay;
+
+   sym = lookup(name);
+   if( isident(sym)==0 )
+      FAULT("Symbol is not an identifier in numsub");
+
+   sets = symvalue(sym);
+   validate( sets, LISTOBJ, "numsub" );
+   n = sets->n;
+
+   lay = (Layout *) xmalloc( sizeof(Layout) );
+   lay->obj    = LAYOUTOBJ;
+   lay->n      = n;
+   lay->index  = (void **) xmalloc( (n+1)*sizeof(void *) );
+   lay->stride = (long *) xmalloc( (n+1)*sizeof(long) );
+
+   //
+   //  storage follows C convention and is row-major: elements at 
+   //  the right vary most rapidly.
+   //
+
+   for( i=0, set=sets->first ; set ; i++, set=set->next )
+      lay->index[i] = setposindex( set->str );
+
+   if( n )
+      {
+      lay->stride[n-1] = 1;
+      for( i=n-1 ; i > 0 ; i-- )
+         lay->stride[i-1] = lay->stride[i]*setsize( sets->vec[i]->str );
+      }
+
+   freelist(sets);
+   putdict(layouts,name,lay);
+
+   return lay;
 }
 
 
 /*-------------------------------------------------------------------*
- *  sub_offset
+ *  position
  *
- *  Generate an offset-style subscript.
+ *  Return the position of a subscript within the set for one
+ *  dimension of a layout.
  *-------------------------------------------------------------------*/
-List *sub_tuple( char *name, List *subs )
+static long position( Layout *lay, int i, char *element )
 {
-   return numsub(name,subs,tuples,0);
+   long n;
+
+   n = (long) getdict( lay->index[i], element );
+   if( n==0 )
+      FAULT("Invalid subscript in numsub");
+
+   return n-1;
 }
 
 
 /*-------------------------------------------------------------------*
- *  numsub
+ *  check_layout
  *
- *  Private routine to do the actual work.
+ *  Get the layout for an identifier and check the subscript count.
  *-------------------------------------------------------------------*/
-static List *numsub( char *name, List *subs, enum substyle style, int offset )
-{   
-   void *sym;
-   List *sets,*result;
-   Item *set,*sub;
-   int i,n,actual[20],max[20],size[20],loc;
-   char buf[10];
-   
-   //
-   //  find the symbol we're writing
-   //
+static Layout *check_layout( char *name, List *subs )
+{
+   Layout *lay;
 
-   sym = lookup(name);
-   if( isident(sym)==0 )
-      FAULT("Symbol is not an identifier in numsub");
-   
-   //
-   //  find number of elements in each set of declaration
-   //
-   
-   sets = symvalue(sym);
-   validate( sets, LISTOBJ, "numsub" );
+   validate( subs, LISTOBJ, "numsub" );
 
-   if( sets->n != subs->n )
+   lay = get_layout(name);
+   if( lay->n != subs->n )
       FAULT("Incorrect number of subscripts for variable in numsub");
 
-   n = sets->n;
+   return lay;
+}
 
-   if( n > 20 )
-      FAULT("Exceeded maximum subscripts (20) in numsub");
 
-   result = newsequence();
+/*-------------------------------------------------------------------*
+ *  sub_ravel
+ *
+ *  Return the offset of an element from the beginning of the 
+ *  variable, plus 'offset'.
+ *-------------------------------------------------------------------*/
+long sub_ravel( char *name, List *subs, long offset )
+{
+   Layout *lay;
+   Item *sub;
+   long loc;
+   int i;
 
-   //
-   //  handle scalars
-   //
-   
-   if( n == 0 )
-      {
-      loc = (style == tuples) ? 0 : offset ;
-      sprintf(buf,"%d",loc);
-      addlist(result,buf);
-      freelist(sets);
-      return result;
-      }
+   lay = check_layout(name,subs);
 
-   //
-   //  step through sets looking up subscripts
-   //
-   
-   set = sets->first;
-   sub = subs->first;
-   for( i=0 ; i < n ; i++ )
-      {
-      max[i]    = setsize( set->str );
-      actual[i] = setindex( set->str, sub->str );
-   
-      if( style == tuples )
-         {
-         sprintf(buf,"%d",actual[i]);
-         addlist(result,buf);
-         }
-         
-      set = set->next;
-      sub = sub->next;
-      }
-   freelist(sets);
+   loc = offset;
+   for( i=0, sub=subs->first ; sub ; i++, sub=sub->next )
+      loc += position(lay,i,sub->str)*lay->stride[i];
 
-   //
-   //  if style is tuples, we're done
-   //
+   return loc;
+}
 
-   if( style == tuples )return result;
 
-   //
-   //  ok, have an array reference that needs to be converted to
-   //  its element (ravel) equivalent.  storage follows C convention
-   //  and is row-major: elements at the right vary most rapidly.
-   //
+/*-------------------------------------------------------------------*
+ *  sub_offset
+ *
+ *  Generate an offset-style subscript.
+ *-------------------------------------------------------------------*/
+List *sub_offset( char *name, List *subs, int offset )
+{
+   List *result;
+   char buf[24];
 
-   size[n-1] = 1;
-   for( i=n-1 ; i > 0 ; i-- )size[i-1] = size[i]*max[i];
-   
-   loc = 0;
-   for( i=0 ; i<n ; i++ )loc += actual[i]*size[i];
-   
-   loc += offset;
+   sprintf(buf,"%ld",sub_ravel(name,subs,offset));
 
-   sprintf(buf,"%d",loc);
+   result = newsequence();
    addlist(result,buf);
-   
    return result;
 }
 
 
+/*-------------------------------------------------------------------*
+ *  sub_tuple
+ *
+ *  Generate a tuple-style subscript.
+ *-------------------------------------------------------------------*/
+List *sub_tuple( char *name, List *subs )
+{
+   Layout *lay;
+   List *result;
+   Item *sub;
+   char buf[24];
+   int i;
+
+   lay = check_layout(name,subs);
 
+   result = newsequence();
+
+   if( lay->n == 0 )
+      {
+      addlist(result,"0");
+      return result;
+      }
+
+   for( i=0, sub=subs->first ; sub ; i++, sub=sub->next )
+      {
+      sprintf(buf,"%ld",position(lay,i,sub->str));
+      addlist(result,buf);
+      }
+
+   return result;
+}
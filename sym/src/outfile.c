@@ -0,0 +1,219 @@
+/*-------------------------------------------------------------------*
+ *  outfile.c
+ *
+ *  Open and close the files sym writes.  Every output file gets a
+ *  large stdio buffer so the many small writes made by the language
+ *  modules reach the system in big blocks.
+ *
+ *  With the -atomic option each file is written under a temporary
+ *  name and only moved into place when it is closed, so a program
+ *  watching for the file never sees it half written.  If the new
+ *  contents are the same as the existing file's, the temporary file
+ *  is dropped instead and the old file is left untouched, keeping
+ *  its modification time.  Temporary files for outputs that were
+ *  never closed, because sym stopped with an error, are removed
+ *  when the program exits.
+ *-------------------------------------------------------------------*/
+
+#include "outfile.h"
+
+#include "error.h"
+#include "str.h"
+#include "sym.h"
+#include "xmalloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OUT_BUFSIZE 65536
+
+typedef struct outfile
+   {
+   FILE *fp;
+   char *name;          // name the file will have when finished
+   char *tmpname;       // name it is written under, or 0
+   char *buf;
+   struct outfile *next;
+   } Outfile;
+
+static Outfile *open_files = 0;
+static int cleanup_set = 0;
+
+//
+//  Private methods
+//
+
+/*-------------------------------------------------------------------*
+ *  samefile
+ *
+ *  Return 1 if two files exist and have the same contents.
+ *-------------------------------------------------------------------*/
+static int samefile( char *name1, char *name2 )
+{
+   FILE *f1,*f2;
+   char buf1[8192],buf2[8192];
+   size_t n1,n2;
+   int same;
+
+   f1 = fopen(name1,"rb");
+   if( f1 == 0 )return 0;
+
+   f2 = fopen(name2,"rb");
+   if( f2 == 0 )
+      {
+      fclose(f1);
+      return 0;
+      }
+
+   same = 1;
+   while( same )
+      {
+      n1 = fread(buf1,1,sizeof(buf1),f1);
+      n2 = fread(buf2,1,sizeof(buf2),f2);
+      if( n1 != n2 || memcmp(buf1,buf2,n1) != 0 )
+         same = 0;
+      else if( n1 == 0 )
+         break;
+      }
+
+   if( ferror(f1) || ferror(f2) )
+      same = 0;
+
+   fclose(f1);
+   fclose(f2);
+   return same;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  discard
+ *
+ *  Called at exit to remove the temporary files of any outputs
+ *  that were never finished.
+ *-------------------------------------------------------------------*/
+static void discard( void )
+{
+   Outfile *cur;
+
+   for( cur=open_files ; cur ; cur=cur->next )
+      if( cur->tmpname )
+         {
+         fclose(cur->fp);
+         remove(cur->tmpname);
+         }
+
+   open_files = 0;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  openfile
+ *
+ *  Open an output file with the given fopen mode.
+ *-------------------------------------------------------------------*/
+static FILE *openfile( char *name, char *mode )
+{
+   Outfile *new;
+
+   new = (Outfile *) xmalloc( sizeof(Outfile) );
+   new->name    = xstrdup(name);
+   new->tmpname = do_atomic ? concat(2,name,".tmp") : 0 ;
+
+   new->fp = fopen( new->tmpname ? new->tmpname : name, mode );
+   if( new->fp == 0 )
+      {
+      xfree(new->name);
+      if( new->tmpname )free(new->tmpname);
+      xfree(new);
+      return 0;
+      }
+
+   new->buf = (char *) xmalloc( OUT_BUFSIZE );
+   setvbuf( new->fp, new->buf, _IOFBF, OUT_BUFSIZE );
+
+   if( new->tmpname && cleanup_set == 0 )
+      {
+      atexit( discard );
+      cleanup_set = 1;
+      }
+
+   new->next  = open_files;
+   open_files = new;
+
+   return new->fp;
+}
+
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  outfile_open
+ *
+ *  Open an output file for writing.  Returns 0 if it can't be
+ *  created, like fopen.
+ *-------------------------------------------------------------------*/
+FILE *outfile_open( char *name )
+{
+   return openfile( name, "w" );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  outfile_open_binary
+ *
+ *  Open an output file for writing bytes that must not be changed
+ *  by line-ending translation.
+ *-------------------------------------------------------------------*/
+FILE *outfile_open_binary( char *name )
+{
+   return openfile( name, "wb" );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  outfile_close
+ *
+ *  Finish an output file.  In atomic mode, move it into place
+ *  unless the contents are unchanged.
+ *-------------------------------------------------------------------*/
+void outfile_close( FILE *fp )
+{
+   Outfile *cur,**prev;
+   int err;
+
+   for( prev=&open_files ; (cur=*prev) ; prev=&cur->next )
+      if( cur->fp == fp )break;
+
+   if( cur == 0 )
+      FAULT("File passed to outfile_close was not opened by outfile_open");
+
+   *prev = cur->next;
+
+   err = fflush(fp) != 0 || ferror(fp) ;
+   if( fclose(fp) != 0 )err = 1;
+   if( err )
+      {
+      if( cur->tmpname )remove(cur->tmpname);
+      fatal_error("Could not write output file %s",cur->name);
+      }
+
+   if( cur->tmpname )
+      {
+      if( samefile(cur->tmpname,cur->name) )
+         remove(cur->tmpname);
+      else if( rename(cur->tmpname,cur->name) != 0 )
+         {
+         //  some systems won't rename over an existing file
+         remove(cur->name);
+         if( rename(cur->tmpname,cur->name) != 0 )
+            fatal_error("Could not replace output file %s",cur->name);
+         }
+      free(cur->tmpname);
+      }
+
+   xfree(cur->buf);
+   xfree(cur->name);
+   xfree(cur);
+}
@@ -0,0 +1,19 @@
+/* outfile.h
+ *
+ * Header file for opening and closing output files.
+ */
+
+#ifndef OUTFILE_H
+#define OUTFILE_H
+
+#include <stdio.h>
+
+//
+//  Function prototypes
+//
+
+FILE* outfile_open(char *name);
+FILE* outfile_open_binary(char *name);
+void  outfile_close(FILE *fp);
+
+#endif /* OUTFILE_H */
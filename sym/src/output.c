@@ -91,7 +91,8 @@ static int linelength=0;
  *  variable set "region" to the first equation set, and then picks out the 
  *  corresponding element of esubs, which is "r1".
  *
- *  The finished list of subscripts for this symbol is stored in vsubs.
+ *  The finished list of subscripts for this symbol is stored in vsubs,
+ *  which comes from the equation arena.
  *
  *--------------------------------------------------------------------*/
  char *show_symbol(char *name,List *vsets,List *esets,List *esubs,Context context)
@@ -129,7 +130,7 @@ static int linelength=0;
    //
 
    isvec = is_eqn_vector();
-   vsubs = newsequence();
+   vsubs = tmpsequence(XA_EQUATION);
    n     = 0;
    
    if( isvec )
@@ -147,7 +148,7 @@ static int linelength=0;
             if( strcasecmp(vset->str,eset->str)==0 || isaliasof(eset->str,vset->str) )
                {
                if( issubset(vset->str,"time") || isaliasof(vset->str,"time") )
-                  context.tsub = strdup(esub->str);
+                  context.tsub = esub->str;
                addlist( vsubs, esub->str );
                n++;
                }
@@ -175,7 +176,6 @@ static int linelength=0;
 
    str = codegen_show_symbol(name,vsubs,context);
 
-   freelist(vsubs);
    return str;
 }
 
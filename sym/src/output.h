@@ -33,6 +33,7 @@ typedef struct
 //  generate subscripts for variables
 //
 
+long  sub_ravel(char*,List*,long);
 List* sub_offset(char*,List*,int);
 List* sub_tuple(char*,List*);
 
@@ -0,0 +1,319 @@
+/*-------------------------------------------------------------------*
+ *  prune.c
+ *
+ *  Drop the parts of a model that a chosen set of variables doesn't
+ *  depend on.  Starting from the target variables, and from the
+ *  states and costates, which the solution needs whatever the
+ *  targets, the equations for each variable are kept and every
+ *  variable used on their right sides is added to the targets in
+ *  turn.  Equations, variables and parameters left out at the end
+ *  are dropped: the equations are taken off the equation list and
+ *  the symbols are passed over by firstsymbol and nextsymbol, so
+ *  the code generators never see them.
+ *
+ *  The work is done a whole variable at a time, keeping every
+ *  equation for a variable if any is needed, so each variable that
+ *  is kept keeps all of its elements and the equations for them.
+ *  Equations whose left side isn't a variable are always kept.
+ *
+ *  A target is either the name of a variable or an attribute, which
+ *  selects every variable with that attribute, and targets are
+ *  separated by commas.
+ *-------------------------------------------------------------------*/
+
+#include "prune.h"
+
+#include "eqns.h"
+#include "error.h"
+#include "lists.h"
+#include "nodes.h"
+#include "output.h"
+#include "str.h"
+#include "sym.h"
+#include "symtable.h"
+#include "xmalloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+//  Attributes of the variables that are always kept: the states
+//  and costates
+//
+
+static char *required[] = { "sta", "stl", "cos", 0 };
+
+//
+//  Private methods
+//
+
+/*-------------------------------------------------------------------*
+ *  uses
+ *
+ *  Add the variables and parameters used in a tree to a list.
+ *-------------------------------------------------------------------*/
+static void uses( Node *cur, List *found )
+{
+   if( cur == 0 )
+      return;
+
+   validate( cur, NODEOBJ, "prune" );
+
+   if( cur->type == nam && isident(lookup(cur->str)) )
+      addlist( found, cur->str );
+
+   uses( cur->l, found );
+   uses( cur->r, found );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  defines
+ *
+ *  Return the variable on the left side of an equation, or 0 if it
+ *  isn't a variable.
+ *-------------------------------------------------------------------*/
+static void *defines( void *eq )
+{
+   Node *cur;
+
+   cur = getlhs( eq );
+   while( cur->type == lag || cur->type == led || cur->type == dom )
+      cur = cur->type == dom ? cur->l : cur->r ;
+
+   if( cur->type != nam || !istype(lookup(cur->str),var) )
+      return 0;
+
+   return lookup( cur->str );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  want
+ *
+ *  Add a variable to the list of those needed.  The list is sorted
+ *  so a variable already on it isn't added again; the queue is the
+ *  same variables in the order they were first needed.
+ *-------------------------------------------------------------------*/
+static void want( void *sym, List *needed, List *queue )
+{
+   int n;
+
+   n = needed->n;
+   addlist( needed, ((Symbol *) sym)->str );
+   if( needed->n > n )
+      addlist( queue, ((Symbol *) sym)->str );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  listdropped
+ *
+ *  Write the dropped symbols of one type to the listing file.
+ *-------------------------------------------------------------------*/
+static void listdropped( Symboltype type, char *title )
+{
+   void *sym;
+   char *name;
+   int n;
+
+   for( sym=firstdeclared(type), n=0 ; sym ; sym=nextdeclared(sym) )
+      if( isdropped(sym) )
+         {
+         if( n++ == 0 )fprintf(info,"\n%s:\n\n",title);
+         name = symname(sym);
+         fprintf(info,"   %s\n",name);
+         free(name);
+         }
+}
+
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  prune_model
+ *
+ *  Drop everything the comma-separated list of targets doesn't
+ *  depend on and summarize what was dropped in the listing file.
+ *-------------------------------------------------------------------*/
+void prune_model( char *targets )
+{
+   List *needed,*queue,*params,**used;
+   void **eqs,**lhs,*sym,*eq;
+   char *buf,*tok;
+   Item *item;
+   int *keep;
+   int i,n,neqs,found;
+   int eqkept,scalars,sckept,vars,varkept,pars,parkept;
+
+   needed = newlist();
+   queue  = newsequence();
+   params = newlist();
+
+   //
+   //  the targets themselves, and the states and costates
+   //
+
+   buf = strdup( targets ? targets : "" );
+   for( tok=strtok(buf,", ") ; tok ; tok=strtok(0,", ") )
+      {
+      sym = lookup( tok );
+      if( istype(sym,var) )
+         {
+         want( sym, needed, queue );
+         continue;
+         }
+
+      found = 0;
+      for( sym=firstsymbol(var) ; sym ; sym=nextsymbol(sym) )
+         if( isattrib(sym,tok) )
+            {
+            want( sym, needed, queue );
+            found = 1;
+            }
+
+      if( !found )
+         fatal_error("Prune target %s is not a variable or an attribute of one\n",tok);
+      }
+
+   for( sym=firstsymbol(var) ; sym ; sym=nextsymbol(sym) )
+      for( i=0 ; required[i] ; i++ )
+         if( isattrib(sym,required[i]) )
+            want( sym, needed, queue );
+
+   //
+   //  the equations that will be written, the variable each one
+   //  defines and the symbols it uses
+   //
+
+   neqs = 0;
+   for( eq=firsteqn() ; eq ; eq=nexteqn(eq) )
+      neqs++;
+
+   eqs  = (void **) xmalloc( (neqs+1)*sizeof(void *) );
+   lhs  = (void **) xmalloc( (neqs+1)*sizeof(void *) );
+   used = (List **) xmalloc( (neqs+1)*sizeof(List *) );
+   keep = (int *) xmalloc( (neqs+1)*sizeof(int) );
+
+   n = 0;
+   for( eq=firsteqn() ; eq ; eq=nexteqn(eq) )
+      {
+      if( hasundec(eq) || !istimeok(eq) )
+         continue;
+      eqs[n]  = eq;
+      lhs[n]  = defines( eq );
+      used[n] = newlist();
+      keep[n] = 0;
+      uses( getrhs(eq), used[n] );
+      n++;
+      }
+   neqs = n;
+
+   //
+   //  equations without a variable on the left are always kept
+   //
+
+   for( i=0 ; i<neqs ; i++ )
+      if( lhs[i] == 0 )
+         {
+         keep[i] = 1;
+         for( item=used[i]->first ; item ; item=item->next )
+            if( istype(lookup(item->str),var) )
+               want( lookup(item->str), needed, queue );
+         }
+
+   //
+   //  work through the queue, which grows as variables are found
+   //
+
+   for( n=0 ; n<queue->n ; n++ )
+      {
+      sym = lookup( queue->vec[n]->str );
+      for( i=0 ; i<neqs ; i++ )
+         {
+         if( keep[i] || lhs[i] != sym )
+            continue;
+         keep[i] = 1;
+         for( item=used[i]->first ; item ; item=item->next )
+            if( istype(lookup(item->str),var) )
+               want( lookup(item->str), needed, queue );
+         }
+      }
+
+   for( i=0 ; i<neqs ; i++ )
+      if( keep[i] )
+         for( item=used[i]->first ; item ; item=item->next )
+            if( istype(lookup(item->str),par) )
+               addlist( params, item->str );
+
+   //
+   //  drop the rest
+   //
+
+   eqkept = scalars = sckept = 0;
+   for( i=0 ; i<neqs ; i++ )
+      {
+      scalars += eqncount(eqs[i]);
+      if( keep[i] )
+         {
+         eqkept++;
+         sckept += eqncount(eqs[i]);
+         }
+      else
+         dropeqn( eqs[i] );
+      }
+
+   if( eqkept == 0 )
+      fatal_error("%s","No equations are left after pruning\n");
+
+   vars = varkept = 0;
+   for( sym=firstsymbol(var) ; sym ; sym=nextsymbol(sym) )
+      {
+      vars++;
+      if( ismember(((Symbol *) sym)->str,needed) )
+         varkept++;
+      else
+         dropsymbol( sym );
+      }
+
+   pars = parkept = 0;
+   for( sym=firstsymbol(par) ; sym ; sym=nextsymbol(sym) )
+      {
+      pars++;
+      if( ismember(((Symbol *) sym)->str,params) )
+         parkept++;
+      else
+         dropsymbol( sym );
+      }
+
+   //
+   //  summarize
+   //
+
+   fprintf(info,"\nPruning:\n\n");
+   fprintf(info,"   Targets:                 %s\n",targets && *targets ? targets : "none");
+   fprintf(info,"   Equations:               %d of %d kept, %d of %d scalar\n",
+      eqkept,neqs,sckept,scalars);
+   fprintf(info,"   Variables:               %d of %d kept\n",varkept,vars);
+   fprintf(info,"   Parameters:              %d of %d kept\n",parkept,pars);
+
+   listdropped( var, "Pruned Variables" );
+   listdropped( par, "Pruned Parameters" );
+
+   //
+   //  tidy up
+   //
+
+   for( i=0 ; i<neqs ; i++ )
+      freelist( used[i] );
+   xfree( eqs );
+   xfree( lhs );
+   xfree( used );
+   xfree( keep );
+   freelist( needed );
+   freelist( queue );
+   freelist( params );
+   free( buf );
+}
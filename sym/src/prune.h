@@ -0,0 +1,16 @@
+/* prune.h
+ *
+ * Header file for dropping the equations, variables and parameters
+ * a chosen set of variables doesn't depend on.
+ */
+
+#ifndef PRUNE_H
+#define PRUNE_H
+
+//
+//  Function prototypes
+//
+
+void prune_model(char *targets);
+
+#endif /* PRUNE_H */
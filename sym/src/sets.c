@@ -7,7 +7,10 @@
 
 #include "sets.h"
 
+#include "bitset.h"
+#include "dict.h"
 #include "error.h"
+#include "intern.h"
 #include "lists.h"
 #include "options.h"
 #include "str.h"
@@ -16,6 +19,7 @@
 #include "wprint.h"
 #include "xmalloc.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define  myDEBUG 0
@@ -30,8 +34,10 @@ extern FILE *info;
 
 struct setinfo
    {
+   int  id;
    char *name;
    List *elements;
+   void *eleindex;
    int  size;
    int  subset;
    int  imp;
@@ -39,6 +45,8 @@ struct setinfo
    char *subsetof;
    char *rootset;
    List *immsups;
+   Bitset *bits;
+   struct setinfo *base;
    struct setinfo *next;
    };
 
@@ -46,10 +54,73 @@ struct setinfo *sethead=0;
 struct setinfo *aliases=0;
 struct setinfo *subsets=0;
 
+//
+//  Hash index of the sets by name.  Each set also carries its own
+//  index mapping element names to their positions, built when the
+//  set is created, so findset(), setsize() and setindex() do not
+//  need to walk any lists.
+//
+
+#define SET_HASHSIZE 256
+
+static void *set_index=0;
+static long n_findset=0;
+static long n_setindex=0;
+
+//
+//  Dense table of relationships between sets, indexed by the id
+//  numbers assigned when sets are created.  Entry [i*nsets+j] holds
+//  flags describing how set i relates to set j.  The table is built
+//  by build_set_relationships(); until then, or if a set is added
+//  afterwards, the queries fall back to computing the answer from
+//  the element lists.
+//
+
+#define REL_SUBSET 0x01   // i is a proper subset or an alias of j
+#define REL_ALIAS  0x02   // i was declared as an alias of j
+#define REL_SAME   0x04   // i and j have identical elements
+
+static struct setinfo **setvec=0;
+static unsigned char *relmat=0;
+static int nsets=0;
+static int rel_built=0;
+
+//
+//  While the table is being built each set's membership is also
+//  held as a bitset over a numbering of every distinct element in
+//  any set, so subset and equality tests compare whole words rather
+//  than looking up elements one at a time.  Sets created after the
+//  table was built have no bitset and use their element index.
+//
+
+static void *all_elements=0;
+static int n_elements=0;
+
 static int issameset(char*,char*);
 
 static int sups_built=0;
 
+
+/*-------------------------------------------------------------------*
+ *  index_elements
+ *
+ *  Build the element index for a set.  Positions are stored 
+ *  offset by one so that a null pointer means "not a member".
+ *-------------------------------------------------------------------*/
+static void *index_elements(List *ele)
+{
+   void *dict;
+   Item *cur;
+   long i;
+
+   dict = newdict( ele->n );
+   for( i=1, cur=ele->first ; cur ; i++, cur=cur->next )
+      if( getdict(dict,cur->str) == 0 )
+         putdict( dict, cur->str, (void *) i );
+
+   return dict;
+}
+
 /*-------------------------------------------------------------------*
  *  newset
  *
@@ -63,8 +134,10 @@ static struct setinfo *newset(char *name, List *ele)
    validate( ele, LISTOBJ, "newset" );
 
    new = (struct setinfo *) xmalloc( sizeof(struct setinfo) );
-   new->name     = name;
+   new->id       = nsets++;
+   new->name     = intern(name);
    new->elements = ele;
+   new->eleindex = index_elements(ele);
    new->size     = ele->n;
    new->subset   = 0;
    new->imp      = 0;
@@ -72,8 +145,19 @@ static struct setinfo *newset(char *name, List *ele)
    new->subsetof = 0;
    new->rootset  = 0;
    new->immsups  = 0;
+   new->bits     = 0;
+   new->base     = 0;
    new->next     = 0;
 
+   rel_built = 0;
+
+   if( set_index==0 )
+      set_index = newdict(SET_HASHSIZE);
+
+   if( getdict(set_index,name) )
+      FAULT("Duplicate set name");
+   putdict( set_index, name, new );
+
    //  first set of all?
    
    if( sethead==0 )
@@ -122,11 +206,10 @@ static struct setinfo *newset(char *name, List *ele)
  *-------------------------------------------------------------------*/
 static struct setinfo *lookupset(char *name)
 {
-   struct setinfo *cur;
-   for( cur=sethead ; cur ; cur=cur->next )
-      if( isequal(name,cur->name) )
-         return cur;
-   return 0;
+   n_findset++;
+   if( set_index==0 )
+      return 0;
+   return (struct setinfo *) getdict(set_index,name);
 }
 
 
@@ -146,6 +229,137 @@ struct setinfo *findset(char *name)
 }
 
 
+/*-------------------------------------------------------------------*
+ *  calc_subset, calc_sameset, calc_base
+ *
+ *  Derive relationships between two sets from their definitions.
+ *  Used to fill the relationship table and as a fallback when the
+ *  table is not available.
+ *-------------------------------------------------------------------*/
+static int calc_subset(struct setinfo *sm, struct setinfo *lg)
+{
+   Item *sm_ele;
+
+   if( sm->aliasof && isequal(sm->aliasof,lg->name) )
+      return 1;
+      
+   if( sm->elements->n >= lg->elements->n )return 0;
+
+   if( sm->bits && lg->bits )
+      return subbitset(sm->bits,lg->bits);
+
+   for( sm_ele = sm->elements->first ; sm_ele ; sm_ele=sm_ele->next )
+      if( getdict( lg->eleindex, sm_ele->str )==0 )
+         return 0;
+
+   return 1;
+}
+
+static int calc_sameset(struct setinfo *s1, struct setinfo *s2)
+{
+   Item *e1;
+
+   if( s1->size != s2->size )return 0;
+
+   if( s1->bits && s2->bits )
+      return subbitset(s1->bits,s2->bits);
+
+   for( e1 = s1->elements->first ; e1 ; e1=e1->next )
+      if( getdict( s2->eleindex, e1->str )==0 )
+         return 0;
+
+   return 1;
+}
+
+static struct setinfo *calc_base(struct setinfo *s)
+{
+   while( s->subsetof )
+      s = findset( s->subsetof );
+   return s;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  build_bitsets
+ *
+ *  Number every distinct element of every set and give each set a
+ *  bitset of the elements it contains.  Any bitsets left from an
+ *  earlier call are replaced since new sets may have added elements.
+ *-------------------------------------------------------------------*/
+static void build_bitsets()
+{
+   struct setinfo *s;
+   Item *e;
+   long pos;
+
+   if( all_elements )freedict(all_elements);
+   all_elements = newdict(nsets);
+   n_elements = 0;
+
+   for( s=sethead ; s ; s=s->next )
+      for( e=s->elements->first ; e ; e=e->next )
+         if( getdict(all_elements,e->str) == 0 )
+            putdict( all_elements, e->str, (void *) (long) ++n_elements );
+
+   for( s=sethead ; s ; s=s->next )
+      {
+      s->bits = freebitset( s->bits );
+      s->bits = newbitset( n_elements );
+      for( e=s->elements->first ; e ; e=e->next )
+         {
+         pos = (long) getdict(all_elements,e->str);
+         putbit( s->bits, pos-1 );
+         }
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  build_relation_table
+ *
+ *  Fill the dense relationship table for all sets that currently 
+ *  exist.  Costs one pass over each pair of sets, after which every
+ *  relationship query is a table lookup.
+ *-------------------------------------------------------------------*/
+static void build_relation_table()
+{
+   struct setinfo *a,*b;
+   unsigned char flags;
+   int i,j;
+
+   if( setvec )xfree( setvec );
+   if( relmat )xfree( relmat );
+
+   setvec = (struct setinfo **) xmalloc( (nsets+1)*sizeof(struct setinfo *) );
+   relmat = (unsigned char *) xmalloc( nsets*nsets+1 );
+
+   for( a=sethead ; a ; a=a->next )
+      setvec[a->id] = a;
+
+   build_bitsets();
+
+   for( i=0 ; i<nsets ; i++ )
+      {
+      a = setvec[i];
+      a->base = calc_base(a);
+      for( j=0 ; j<nsets ; j++ )
+         {
+         b = setvec[j];
+         flags = 0;
+         if( i != j && calc_subset(a,b) )
+            flags |= REL_SUBSET;
+         if( a->aliasof && isequal(a->aliasof,b->name) )
+            flags |= REL_ALIAS;
+         if( calc_sameset(a,b) )
+            flags |= REL_SAME;
+         relmat[i*nsets+j] = flags;
+         }
+      }
+
+   rel_built = 1;
+}
+
+
 /*-------------------------------------------------------------------*
  *  build_time_sets
  *
@@ -361,6 +575,7 @@ static void build_immediate_sups()
 void build_set_relationships()
 {
    void *cur;
+   char *name;
    List *tmplist,*implist,*timesets,*gettimesets();
    Item *ele;
    int count;
@@ -377,7 +592,11 @@ void build_set_relationships()
    //  
    
    for( cur=firstsymbol(set) ; cur ; cur=nextsymbol(cur) )
-      newset( symname(cur), symvalue(cur) );      
+      {
+      name = symname(cur);
+      newset( name, symvalue(cur) );      
+      free( name );
+      }
       
    //
    //  incorporate information about aliases
@@ -403,6 +622,13 @@ void build_set_relationships()
             s->subset   = 1;
             s->subsetof = sub->subsetof;
             }
+
+   //
+   //  tabulate relationships among the declared sets for the 
+   //  checks below
+   //
+
+   build_relation_table();
    
    // 
    //  identical sets are not allowed except as aliases; enforce 
@@ -471,7 +697,7 @@ void build_set_relationships()
             fatal_error("Name used for set and element: %s\n",ele->str);
          if( this->subset )
             continue;
-         if( ismember(ele->str,this->elements) )
+         if( getdict(this->eleindex,ele->str) )
             count++;
          }
       if( count == 1 )
@@ -488,12 +714,19 @@ void build_set_relationships()
       {
       tmplist = newlist();
       addlist( tmplist, ele->str );
-      this = newset( strdup(ele->str), tmplist );
+      this = newset( ele->str, tmplist );
       this->subset = 1;
       this->imp    = 1;
       }
 
    freelist(implist);
+
+   //
+   //  rebuild the relationship table now that the implicit sets
+   //  exist
+   //
+
+   build_relation_table();
 }
 
 
@@ -541,6 +774,19 @@ List *setelements( char *name )
 }
 
 
+/*-------------------------------------------------------------------*
+ *  setmembers()
+ *
+ *  Return the set's own list of elements without copying it.  The
+ *  list belongs to the set and must not be modified or freed by 
+ *  the caller.
+ *-------------------------------------------------------------------*/
+List *setmembers( char *name )
+{
+   return findset(name)->elements;
+}
+
+
 /*-------------------------------------------------------------------*
  *  setsize
  *
@@ -561,11 +807,10 @@ int setsize( char *name )
  *-------------------------------------------------------------------*/
 int setindex( char *setname, char *element )
 {
-   List *elist;
-   int n;
+   long n;
 
-   elist = findset(setname)->elements;
-   n = ismember(element,elist);
+   n_setindex++;
+   n = (long) getdict( findset(setname)->eleindex, element );
    
    if( n==0 )
       FAULT("Invalid subscript in setindex");
@@ -574,6 +819,19 @@ int setindex( char *setname, char *element )
 }
 
 
+/*-------------------------------------------------------------------*
+ *  setposindex
+ *
+ *  Return the element index of a set: a dictionary mapping each 
+ *  element to one plus its position.  Lets a caller that looks up
+ *  many elements of the same set skip finding the set each time.
+ *-------------------------------------------------------------------*/
+void *setposindex( char *setname )
+{
+   return findset(setname)->eleindex;
+}
+
+
 /*-------------------------------------------------------------------*
  *  issubset
  *
@@ -581,29 +839,18 @@ int setindex( char *setname, char *element )
  *-------------------------------------------------------------------*/
 int issubset(char *small, char *large)
 {
-   struct setinfo *sm;
-   List *sm_set,*lg_set;
-   Item *sm_ele;
-   int result;
+   struct setinfo *sm,*lg;
 
    sm = lookupset(small);
    if(sm==0)
       fatal_error("Element is a member of multiple master sets: %s\n",small);
 
-   if( sm->aliasof && isequal(sm->aliasof,large) )
-      return 1;
-      
-   sm_set = sm->elements;
-   lg_set = findset(large)->elements;
-   
-   if( sm_set->n >= lg_set->n )return 0;
+   lg = findset(large);
 
-   result = 1;
-   for( sm_ele = sm_set->first ; sm_ele ; sm_ele=sm_ele->next )
-      if( ismember( sm_ele->str, lg_set )==0 )
-         result = 0;
+   if( rel_built )
+      return (relmat[sm->id*nsets+lg->id] & REL_SUBSET) != 0;
 
-   return result;
+   return calc_subset(sm,lg);
 }
 
 
@@ -617,38 +864,14 @@ static int issameset(one,two)
 char *one,*two;
 {
    struct setinfo *s1,*s2;
-   List *alpha1,*alpha2;
-   Item *e1,*e2;
    
    s1 = findset(one);
    s2 = findset(two);
-   
-   if( s1->size != s2->size )return 0;
-
-   alpha1 = newlist();
-   alpha2 = newlist();
 
-   catlist( alpha1, s1->elements );
-   catlist( alpha2, s2->elements );
-
-   e1 = alpha1->first;
-   e2 = alpha2->first;
-
-   while( e1 )
-      {
-      if( ! isequal(e1->str,e2->str) )
-         {
-         freelist( alpha1 );
-         freelist( alpha2 );
-         return 0;
-         }
-      e1 = e1->next;
-      e2 = e2->next;
-      }
+   if( rel_built )
+      return (relmat[s1->id*nsets+s2->id] & REL_SAME) != 0;
 
-   freelist( alpha1 );
-   freelist( alpha2 );
-   return 1;
+   return calc_sameset(s1,s2);
 }
 
 
@@ -662,8 +885,8 @@ void setalias(char *alias, char *aliasof )
    struct setinfo *new,*last;
    
    new = (struct setinfo *) xmalloc( sizeof(struct setinfo) );
-   new->name    = strdup(alias  );
-   new->aliasof = strdup(aliasof);
+   new->name    = intern(alias  );
+   new->aliasof = intern(aliasof);
    new->next    = 0;
    
    if( aliases==0 )
@@ -684,9 +907,14 @@ void setalias(char *alias, char *aliasof )
  *-------------------------------------------------------------------*/
 int isaliasof(char *set, char *aliasof )
 {
-   char *set_aliasof;
-   set_aliasof = findset(set)->aliasof;
-   if( set_aliasof && isequal(set_aliasof,aliasof) )return 1;
+   struct setinfo *s,*a;
+
+   s = findset(set);
+
+   if( rel_built && (a=lookupset(aliasof)) )
+      return (relmat[s->id*nsets+a->id] & REL_ALIAS) != 0;
+
+   if( s->aliasof && isequal(s->aliasof,aliasof) )return 1;
    return 0;
 }
 
@@ -715,8 +943,8 @@ void setsubset(char *subname, char *supname )
    struct setinfo *new,*last;
    
    new = (struct setinfo *) xmalloc( sizeof(struct setinfo) );
-   new->name     = strdup(subname);
-   new->subsetof = strdup(supname);
+   new->name     = intern(subname);
+   new->subsetof = intern(supname);
    new->next     = 0;
  
    if( subsets==0 )
@@ -763,10 +991,10 @@ char *findbase(char *setname)
    if( s==0 )
       FAULT("failed to find set in findbase");
    
-   if( s->subsetof == 0 )
-      return( strdup(s->name) );
-   
-   return findbase( s->subsetof );
+   if( rel_built )
+      return( strdup(s->base->name) );
+
+   return( strdup(calc_base(s)->name) );
 }
 
 
@@ -792,3 +1020,18 @@ List *find_immediate_sups(char *setname)
    
    return( s->immsups );
 }
+
+
+/*-------------------------------------------------------------------*
+ *  set_stats
+ *
+ *  Print counters describing use of the set table for -stats.
+ *-------------------------------------------------------------------*/
+void set_stats()
+{
+   printf("Set table:\n");
+   printf("   Set lookups:      %ld\n",n_findset);
+   printf("   Element lookups:  %ld\n",n_setindex);
+   if( set_index )
+      dictinfo(set_index);
+}
@@ -10,15 +10,18 @@
 #include "lists.h"
 
 List* setelements(char *);
+List* setmembers(char *);
 int   isaliasof(char*,char*);
 int   isimplicit(char*);
 int   issubset(char*,char*);
 int   setindex(char *,char *);
+void* setposindex(char *);
 int   setsize(char *);
 void  build_set_relationships();
 void  listelements();
 void  setalias(char*,char*);
 void  setsubset(char*,char*);
+void  set_stats(void);
 char* findbase(char*);
 List* find_immediate_sups(char *);
 
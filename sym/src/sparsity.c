@@ -0,0 +1,307 @@
+/*-------------------------------------------------------------------*
+ *  sparsity.c
+ *
+ *  Record which vector elements each scalar equation uses and write
+ *  them out as a compressed sparse row (CSR) matrix: one row per
+ *  equation, in the order the equations were written, and one
+ *  column for each distinct element on its right side.
+ *
+ *  While the equations are being written, sparsity_row appends one
+ *  record per equation to a scratch stream.  Records are only ever
+ *  appended, so the stream can be one of those handed to a worker
+ *  process.  Once every equation has been written, sparsity_write
+ *  reads the records back and writes the matrix.
+ *
+ *  The file is a sequence of little-endian 32-bit signed integers,
+ *  so the whole of it can be read at once with
+ *
+ *     a = numpy.fromfile(name, dtype='<i4')
+ *
+ *  and the sections below picked out of a by position:
+ *
+ *     Words      Contents
+ *     ---------  --------
+ *     1          magic number: the bytes "SCSR"
+ *     1          layout version, currently 1
+ *     1          nvec, the number of vector codes
+ *     1          nrows, the number of equations
+ *     1          nnz, the number of nonzeros
+ *     1          npairs, the number of vector pairs summarized
+ *     nvec       name of each vector code, up to four ASCII
+ *                characters padded with zero bytes
+ *     nrows      vector code of each equation's left side
+ *     nrows      index of each equation's left side
+ *     nrows+1    indptr: the columns of row i are entries indptr[i]
+ *                to indptr[i+1]-1 of the next two sections
+ *     nnz        vector code of each column
+ *     nnz        index of each column
+ *     4*npairs   one entry for each pair of left-side and right-side
+ *                vectors with any nonzeros: the two vector codes,
+ *                the number of rows with nonzeros in the pair and
+ *                the number of nonzeros
+ *
+ *  Within each row the columns are sorted by vector code and then
+ *  by index.  The pair summary is sorted by left-side vector and
+ *  then right-side vector; pairs that don't appear are all zero.
+ *-------------------------------------------------------------------*/
+
+#include "sparsity.h"
+
+#include "error.h"
+#include "xmalloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPARSITY_MAGIC   "SCSR"
+#define SPARSITY_VERSION 1
+
+//
+//  Private methods
+//
+
+/*-------------------------------------------------------------------*
+ *  compare
+ *
+ *  Order references by vector and then by index, for qsort.
+ *-------------------------------------------------------------------*/
+static int compare( const void *a, const void *b )
+{
+   const Spref *x = (const Spref *) a;
+   const Spref *y = (const Spref *) b;
+
+   if( x->vec != y->vec )return x->vec < y->vec ? -1 : 1 ;
+   if( x->idx != y->idx )return x->idx < y->idx ? -1 : 1 ;
+   return 0;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  grow
+ *
+ *  Make room for at least one more element at position n of an
+ *  array, doubling its size when it is full.
+ *-------------------------------------------------------------------*/
+static void *grow( void *old, long n, long *max, int size )
+{
+   void *new;
+
+   if( n < *max )return old;
+
+   *max = *max ? 2*(*max) : 1024 ;
+   new = xmalloc( (int) (*max*size) );
+   if( old )
+      {
+      memcpy( new, old, n*size );
+      xfree( old );
+      }
+   return new;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  put32
+ *
+ *  Write one little-endian 32-bit integer.
+ *-------------------------------------------------------------------*/
+static void put32( FILE *out, long val )
+{
+   unsigned long u;
+
+   if( val > 0x7fffffffL || val < -0x7fffffffL )
+      FAULT("Value too large for the sparsity file");
+
+   u = (unsigned long) val;
+   putc( (int) ( u      & 0xff), out );
+   putc( (int) ((u>> 8) & 0xff), out );
+   putc( (int) ((u>>16) & 0xff), out );
+   putc( (int) ((u>>24) & 0xff), out );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  getrec
+ *
+ *  Read n longs from the scratch stream.  Returns 0 at the end of
+ *  the stream.
+ *-------------------------------------------------------------------*/
+static int getrec( FILE *rows, long *buf, long n )
+{
+   size_t got;
+
+   got = fread( buf, sizeof(long), n, rows );
+   if( got == (size_t) n )return 1;
+   if( got == 0 && feof(rows) )return 0;
+
+   fatal_error("%s","could not read sparsity records");
+   return 0;
+}
+
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  sparsity_row
+ *
+ *  Record an equation whose left side is lhs and whose right side
+ *  uses the n elements in rhs, which may repeat.  The rhs array is
+ *  sorted in place.
+ *-------------------------------------------------------------------*/
+void sparsity_row( FILE *rows, Spref *lhs, Spref *rhs, int n )
+{
+   long rec[3];
+   int i,m;
+
+   qsort( rhs, n, sizeof(Spref), compare );
+
+   for( i=0, m=0 ; i < n ; i++ )
+      if( m == 0 || compare(&rhs[i],&rhs[m-1]) != 0 )
+         rhs[m++] = rhs[i];
+
+   rec[0] = lhs->vec;
+   rec[1] = lhs->idx;
+   rec[2] = m;
+   fwrite( rec, sizeof(long), 3, rows );
+
+   for( i=0 ; i < m ; i++ )
+      {
+      rec[0] = rhs[i].vec;
+      rec[1] = rhs[i].idx;
+      fwrite( rec, sizeof(long), 2, rows );
+      }
+}
+
+
+/*-------------------------------------------------------------------*
+ *  sparsity_write
+ *
+ *  Read back the records of every equation and write the matrix
+ *  to out.  Vector codes run from 0 to nvec-1 and vecnames gives
+ *  the name of each.  The scratch stream is closed.
+ *-------------------------------------------------------------------*/
+void sparsity_write( FILE *rows, FILE *out, char **vecnames, int nvec )
+{
+   long *rowvec,*rowidx,*indptr,*colvec,*colidx;
+   long *pairrows,*pairnnz;
+   long nrows,maxrv,maxri,maxptr,nnz,maxcv,maxci,npairs;
+   long rec[3],k,last;
+   int i,j;
+
+   rowvec = rowidx = indptr = colvec = colidx = 0;
+   nrows = nnz = 0;
+   maxrv = maxri = maxptr = maxcv = maxci = 0;
+
+   pairrows = (long *) xmalloc( nvec*nvec*sizeof(long) );
+   pairnnz  = (long *) xmalloc( nvec*nvec*sizeof(long) );
+   memset( pairrows, 0, nvec*nvec*sizeof(long) );
+   memset( pairnnz,  0, nvec*nvec*sizeof(long) );
+
+   //
+   //  read the rows back and count the nonzeros in each pair
+   //  of vectors
+   //
+
+   if( fflush(rows) || ferror(rows) )
+      fatal_error("%s","could not write sparsity records");
+   rewind( rows );
+
+   indptr = (long *) grow( indptr, 0, &maxptr, sizeof(long) );
+   indptr[0] = 0;
+
+   while( getrec(rows,rec,3) )
+      {
+      if( rec[0] < 0 || rec[0] >= nvec )
+         FAULT("Invalid vector code in sparsity_write");
+
+      rowvec = (long *) grow( rowvec, nrows, &maxrv, sizeof(long) );
+      rowidx = (long *) grow( rowidx, nrows, &maxri, sizeof(long) );
+      rowvec[nrows] = rec[0];
+      rowidx[nrows] = rec[1];
+
+      last = -1;
+      for( k=rec[2] ; k > 0 ; k-- )
+         {
+         if( getrec(rows,rec+1,2) == 0 )
+            fatal_error("%s","incomplete sparsity record");
+         if( rec[1] < 0 || rec[1] >= nvec )
+            FAULT("Invalid vector code in sparsity_write");
+
+         colvec = (long *) grow( colvec, nnz, &maxcv, sizeof(long) );
+         colidx = (long *) grow( colidx, nnz, &maxci, sizeof(long) );
+         colvec[nnz] = rec[1];
+         colidx[nnz] = rec[2];
+         nnz++;
+
+         pairnnz[ rowvec[nrows]*nvec + rec[1] ]++;
+         if( rec[1] != last )
+            pairrows[ rowvec[nrows]*nvec + rec[1] ]++;
+         last = rec[1];
+         }
+
+      nrows++;
+      indptr = (long *) grow( indptr, nrows, &maxptr, sizeof(long) );
+      indptr[nrows] = nnz;
+      }
+
+   fclose( rows );
+
+   npairs = 0;
+   for( k=0 ; k < nvec*nvec ; k++ )
+      if( pairnnz[k] )npairs++;
+
+   //
+   //  header and vector names
+   //
+
+   fwrite( SPARSITY_MAGIC, 1, 4, out );
+   put32( out, SPARSITY_VERSION );
+   put32( out, nvec );
+   put32( out, nrows );
+   put32( out, nnz );
+   put32( out, npairs );
+
+   for( i=0 ; i < nvec ; i++ )
+      {
+      char name[4];
+
+      if( strlen(vecnames[i]) > 4 )
+         FAULT("Vector name too long for the sparsity file");
+      memset( name, 0, 4 );
+      memcpy( name, vecnames[i], strlen(vecnames[i]) );
+      fwrite( name, 1, 4, out );
+      }
+
+   //
+   //  the matrix itself
+   //
+
+   for( k=0 ; k < nrows  ; k++ )put32( out, rowvec[k] );
+   for( k=0 ; k < nrows  ; k++ )put32( out, rowidx[k] );
+   for( k=0 ; k <= nrows ; k++ )put32( out, indptr[k] );
+   for( k=0 ; k < nnz    ; k++ )put32( out, colvec[k] );
+   for( k=0 ; k < nnz    ; k++ )put32( out, colidx[k] );
+
+   //
+   //  summary of the vector pairs
+   //
+
+   for( i=0 ; i < nvec ; i++ )
+      for( j=0 ; j < nvec ; j++ )
+         if( pairnnz[i*nvec+j] )
+            {
+            put32( out, i );
+            put32( out, j );
+            put32( out, pairrows[i*nvec+j] );
+            put32( out, pairnnz[i*nvec+j] );
+            }
+
+   if( rowvec )xfree( rowvec );
+   if( rowidx )xfree( rowidx );
+   if( colvec )xfree( colvec );
+   if( colidx )xfree( colidx );
+   xfree( indptr );
+   xfree( pairrows );
+   xfree( pairnnz );
+}
@@ -0,0 +1,30 @@
+/* sparsity.h
+ *
+ * Header file for writing the sparsity pattern of a model's
+ * equations in compressed sparse row form.
+ */
+
+#ifndef SPARSITY_H
+#define SPARSITY_H
+
+#include <stdio.h>
+
+//
+//  A reference to one element of a vector
+//
+
+typedef struct
+   {
+   int  vec;
+   long idx;
+   }
+   Spref;
+
+//
+//  Function prototypes
+//
+
+void sparsity_row(FILE *rows, Spref *lhs, Spref *rhs, int n);
+void sparsity_write(FILE *rows, FILE *out, char **vecnames, int nvec);
+
+#endif /* SPARSITY_H */
@@ -27,30 +27,34 @@
 char *concat(int n, char *s, ...)
 {
     char *new;
-    va_list ap;
+    va_list ap,aq;
     int i,len;
     
     // measure the strings...
     
     va_start(ap, s);
+    va_copy(aq, ap);
     
     len = strlen(s);
     for( i=1 ; i<n ; i++ )
-        len += strlen( va_arg(ap, char*) );
+        len += strlen( va_arg(aq, char*) );
     
-    va_end(ap);
+    va_end(aq);
     
     // get some space...
     
-    new  = (char *) malloc( len+1 );
+    new = (char *) malloc( len+1 );
     
     // build the new string...
 
-    va_start(ap, s);
-
     strcpy(new,s);
+    len = strlen(s);
     for( i=1 ; i<n ; i++ )
-        strcat(new, va_arg(ap, char*) );
+        {
+        s = va_arg(ap, char*);
+        strcpy(new+len,s);
+        len += strlen(s);
+        }
 
     va_end(ap);
 
@@ -71,3 +75,91 @@ char *strlower( char *oldstr )
    for( c=newstr ; *c ; c++ )*c = tolower(*c);
    return newstr;
 }
+
+//
+//  String builders
+//
+//  A Strbuf is a growable string that text is appended to.  Its 
+//  space is kept when it is reset, so a builder that is reused 
+//  stops allocating once it has grown to the size of the longest
+//  string built in it.  A Strbuf is initialized to SB_INIT and its
+//  string is always terminated.
+//
+
+static void sb_grow( Strbuf *sb, int need )
+{
+   int size;
+
+   if( sb->len + need < sb->size )return;
+
+   size = sb->size ? 2*sb->size : 256 ;
+   while( size <= sb->len + need )
+      size *= 2;
+
+   sb->str  = (char *) realloc( sb->str, size );
+   if( sb->str == 0 )
+      fatal_error("%s","insufficient memory in sb_grow()");
+   sb->size = size;
+}
+
+void sb_reset( Strbuf *sb )
+{
+   sb_grow( sb, 0 );
+   sb->len = 0;
+   sb->str[0] = 0;
+}
+
+void sb_add( Strbuf *sb, char *s )
+{
+   int n;
+
+   n = strlen(s);
+   sb_grow( sb, n );
+   memcpy( sb->str+sb->len, s, n+1 );
+   sb->len += n;
+}
+
+//
+//  sb_take()
+//
+//  Append a string from malloc, concat or an arena and release it.
+//
+
+void sb_take( Strbuf *sb, char *s )
+{
+   sb_add( sb, s );
+   xrelease( s );
+}
+
+//
+//  sb_insert()
+//
+//  Insert a string at a given position, moving what follows it
+//  along.  Returns the position just after the inserted text.
+//
+
+int sb_insert( Strbuf *sb, int pos, char *s )
+{
+   int n;
+
+   if( pos < 0 || pos > sb->len )
+      FAULT("Invalid position in sb_insert");
+
+   n = strlen(s);
+   if( n == 0 )return pos;
+
+   sb_grow( sb, n );
+   memmove( sb->str+pos+n, sb->str+pos, sb->len-pos+1 );
+   memcpy( sb->str+pos, s, n );
+   sb->len += n;
+
+   return pos+n;
+}
+
+void sb_free( Strbuf *sb )
+{
+   if( sb->str )free( sb->str );
+   sb->str  = 0;
+   sb->len  = 0;
+   sb->size = 0;
+}
@@ -1,9 +1,25 @@
 #ifndef STR_H
 #define STR_H
 
+typedef struct
+   {
+   char *str;
+   int len;
+   int size;
+   }
+   Strbuf;
+
+#define SB_INIT {0,0,0}
+
 char *concat(int,char*,...);
 char *strlower(char*);
 
+int   sb_insert(Strbuf*,int,char*);
+void  sb_add(Strbuf*,char*);
+void  sb_free(Strbuf*);
+void  sb_reset(Strbuf*);
+void  sb_take(Strbuf*,char*);
+
 #ifdef __WATCOMC__
 
 #define strcasecmp(a,b) stricmp(a,b)
@@ -11,12 +11,16 @@
 #include "sym.h"
 
 #include "build.h"
+#include "depgraph.h"
 #include "eqns.h"
 #include "error.h"
+#include "intern.h"
 #include "lang.h"
 #include "lists.h"
 #include "nodes.h"
+#include "outfile.h"
 #include "output.h"
+#include "prune.h"
 #include "readfile.h"
 #include "sets.h"
 #include "str.h"
@@ -27,6 +31,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define myDEBUG 0
 
@@ -40,10 +45,22 @@ int only_first = 0;
 int only_last = 0;
 int mergeonly = 0;
 int do_scalars = 0;
+int do_numpy = 0;
+int do_jacobian = 0;
 int do_calc = 0;
+int do_stats = 0;
+int do_atomic = 0;
+int do_cse = 0;
+int do_simplify = 0;
+int do_reduce = 0;
+int do_hoist = 0;
+int do_linear = 0;
+int do_blocks = 0;
+int do_prune = 0;
+int jobs = 0;
 
 char *usage = "sym [options] <language> <symfile> <codefile>";
-char *options = "-version -calc -d -dd -doc -first -last -scalars -syntax -merge_only";
+char *options = "-version -atomic -blocks -calc -cse -d -dd -doc -first -hoist -jacobian -jobs=n -last -linear -numpy -prune=list -reduce -scalars -simplify -stats -syntax -merge_only";
 
 char *doc1 = "\
 Translates models from algebraic form into one of several programming\n\
@@ -65,10 +82,31 @@ The name that should be used for the resulting target-language file. Some\n\
 target languages will involve multiple files that will be based on this\n\
 name. Required.\n\
 \n\
+### Option -atomic\n\
+Write each output file under a temporary name and rename it when\n\
+it is complete, so other programs never see a partly written file.\n\
+Files whose contents have not changed are left untouched.\n\
+\n\
+### Option -blocks\n\
+Matches each scalar equation to the variable on its left side, finds\n\
+the blocks of equations that depend on each other, and writes them in\n\
+an order in which each block only uses variables from the blocks\n\
+before it, to a file whose name ends in _blocks.csv. Each block is\n\
+either a single recursive equation or a set of simultaneous\n\
+equations. The listing file summarizes the blocks.\n\
+\n\
 ### Option -calc\n\
 Turn on calculator mode for target languages that support it. Calculator\n\
 mode is used for non-iterative calculations.\n\
 \n\
+### Option -cse\n\
+Only applies to the c, oxgst and python language targets. Finds\n\
+subexpressions that are used more than once and writes each of them\n\
+just once, as a local temporary. The python and oxgst targets share\n\
+them within each scalar equation and the c target across the\n\
+equations of a block. The listing file reports the expression nodes\n\
+and exp, log and pow calls removed.\n\
+\n\
 ### Option -d\n\
 Turn on the most commonly used debugging messages.\n\
 \n\
@@ -81,18 +119,102 @@ Print this message.\n\
 ### Option -first\n\
 Build a single-year model using only the first year.\n\
 \n\
+### Option -hoist\n\
+Only applies to the c and python language targets. Finds the\n\
+largest subexpressions of each scalar equation that involve only\n\
+parameters and numbers and computes them once, in a function called\n\
+precompute_parameters, into a vector of derived constants that the\n\
+equations use instead. It must be called whenever the parameters\n\
+change and before the equations are evaluated. Identical\n\
+subexpressions anywhere in the model share a derived constant. Every\n\
+derived constant is computed whenever precompute_parameters is\n\
+called, so in the python target a parameter outside the domain of\n\
+one of them, such as log(1-par) with par at 1, makes the whole call\n\
+fail even if no equation using it is ever evaluated. Without -hoist\n\
+the same values only fail in the equations that use them. The\n\
+python target writes the equations in a single process. The listing\n\
+file reports the nodes and calls removed from each evaluation.\n\
+\n\
+### Option -jacobian\n\
+Only applies when the -python language target is used. Writes a\n\
+function for each equation giving the exact partial derivatives\n\
+of its right side with respect to the vector elements it uses,\n\
+and a file listing where each partial belongs.\n\
+\n\
+### Option -jobs=n\n\
+Number of worker processes to use when writing equations for\n\
+target languages that support it. The default is one for each\n\
+processor when the model is large enough to benefit. The output\n\
+is the same however many are used.\n\
+\n\
 ### Option -last\n\
 Build a single-year model using only the last year.\n\
 \n\
+### Option -linear\n\
+Only applies when the -python language target is used. Finds the\n\
+right side vectors each scalar equation uses linearly, with\n\
+coefficients of parameters and numbers alone, and splits the right\n\
+side into those terms, a constant, and an expression in the other\n\
+vectors. A file ending _linearity.csv lists the linear and\n\
+nonlinear vectors of each equation, and one ending _linear.csv the\n\
+position of each coefficient, as a sparse matrix, with a blank\n\
+vector for the constant. The linear_coefficients method returns\n\
+their values for the current parameters in the same order.\n\
+\n\
 ### Option -merge_only\n\
 Combine all included modules and return the resulting file\n\
 without generating any target-language code.\n\
 \n\
+### Option -numpy\n\
+Only applies when the -python language target is used. Writes\n\
+each block of equations as a single function using NumPy index\n\
+arrays, with the usual function for each equation kept as a thin\n\
+wrapper around it.\n\
+\n\
+### Option -prune=list\n\
+Only applies when the -python language target is used. Writes only\n\
+the equations needed to compute the variables in the list, which\n\
+are separated by commas and may be names of variables or attributes\n\
+selecting every variable that has them. States and costates are\n\
+always needed. Following the equations back from there, every\n\
+variable they use is needed too, along with all of its equations.\n\
+Other equations, variables and parameters are dropped and the\n\
+vectors are numbered without them. A file ending _prunemap.csv\n\
+gives the position each remaining vector element would have had\n\
+without pruning, and the listing file reports what was dropped.\n\
+\n\
+### Option -reduce\n\
+Only applies to the c, oxgst and python language targets. Replaces\n\
+exp, log and pow calls with cheaper equivalents in each scalar\n\
+equation: log(exp(x)) becomes x, exp(a)^b becomes exp(a*b),\n\
+exp(a)*exp(b) becomes exp(a+b), exp(a)/exp(b) becomes exp(a-b),\n\
+x/exp(a) becomes x*exp(-a), and whole powers from 2 to 4, or -2 to\n\
+-4, become repeated multiplications. Powers of anything more than\n\
+a name or number are only multiplied out with -cse, which keeps it\n\
+from being evaluated more than once. Results can differ from the\n\
+original in the last bits. The listing file reports the calls\n\
+removed.\n\
+\n\
 ### Option -scalars\n\
 Only applies when the -debug language target is used. Causes\n\
 an additional file to be written showing element-by-element\n\
 declarations and usage of parameters and variables.\n\
 \n\
+### Option -simplify\n\
+Only applies to the c, oxgst and python language targets. Simplifies\n\
+each scalar equation once its subscripts are known: numbers are\n\
+folded together, additions of zero and multiplications, divisions\n\
+and powers by one are dropped, multiplications by zero become zero,\n\
+and terms that are added and subtracted again cancel. Values are\n\
+assumed to be finite. The c target writes equations that reduce to\n\
+a number as a table of values rather than as code. The listing\n\
+file reports the expression nodes removed and the equations that\n\
+became constants.\n\
+\n\
+### Option -stats\n\
+Print counters and timings useful for profiling sym itself,\n\
+such as the number of symbol table lookups.\n\
+\n\
 ### Option -syntax\n\
 Print a short summary of the input syntax, including some\n\
 notes about rules appling to specific target languages.\n\
@@ -107,7 +229,11 @@ List *langvers(void);
 void syntax();
 void parse_command(int, char *[]);
 int isoption(char *, int);
+char *opvalue(int);
 static char *builtby();
+static int islang(char *);
+static void showstats();
+static void marktime(char *);
 
 int main(int argc, char *argv[])
 {
@@ -116,6 +242,7 @@ int main(int argc, char *argv[])
    char *get_version();
    char *sourcefile, *codefile, *listfile;
    char *basename, *ext;
+   char *prune_targets = 0;
    char *lang;
    char *rev;
    char *h1, *h2;
@@ -123,6 +250,7 @@ int main(int argc, char *argv[])
    Item *thislang;
    int do_doc;
    int do_usage;
+   int i;
    char *langdoc();
 
    lang = "debug";
@@ -184,20 +312,50 @@ int main(int argc, char *argv[])
       exit(0);
    }
 
-   if (isoption("calc", 1))
+   if (isoption("atomic", 2))
+      do_atomic = 1;
+   if (isoption("blocks", 2))
+      do_blocks = 1;
+   if (isoption("calc", 2))
       do_calc = 1;
+   if (isoption("cse", 2))
+      do_cse = 1;
+
+   if (isoption("simplify", 2))
+      do_simplify = 1;
+
+   if (isoption("reduce", 2))
+      do_reduce = 1;
+
+   if (isoption("hoist", 2))
+      do_hoist = 1;
    if (isoption("dd", 2))
       debugforce = 1;
    if (isoption("d", 1) && !(isoption("debug", 2) || isoption("dd", 2)))
       debug = 1;
    if (isoption("first", 1))
       only_first = 1;
+   if (isoption("jacobian", 3))
+      do_jacobian = 1;
    if (isoption("last", 1))
       only_last = 1;
+   if (isoption("linear", 3))
+      do_linear = 1;
    if (isoption("merge_only", 1))
       mergeonly = 1;
+   if (isoption("numpy", 2))
+      do_numpy = 1;
+   if ((i = isoption("prune", 2)))
+   {
+      do_prune = 1;
+      prune_targets = opvalue(i - 1);
+   }
    if (isoption("scalars", 2))
       do_scalars = 1;
+   if (isoption("stats", 5))
+      do_stats = 1;
+   if ((i = isoption("jobs", 4)) && opvalue(i - 1))
+      jobs = atoi(opvalue(i - 1));
 
    if (only_first && only_last)
    {
@@ -213,7 +371,7 @@ int main(int argc, char *argv[])
    {
       lang = 0;
       for (thislang = known->first; thislang; thislang = thislang->next)
-         if (isoption(thislang->str, strlen(thislang->str)))
+         if (islang(thislang->str))
             lang = thislang->str;
 
       if (lang == 0)
@@ -225,6 +383,30 @@ int main(int argc, char *argv[])
    if (do_scalars && strcmp(lang, "debug") != 0)
       fatal_error("%s", "Option -scalars is only supported for target debug\n");
 
+   if (do_numpy && strcmp(lang, "python") != 0)
+      fatal_error("%s", "Option -numpy is only supported for target python\n");
+
+   if (do_jacobian && strcmp(lang, "python") != 0)
+      fatal_error("%s", "Option -jacobian is only supported for target python\n");
+
+   if (do_linear && strcmp(lang, "python") != 0)
+      fatal_error("%s", "Option -linear is only supported for target python\n");
+
+   if (do_prune && strcmp(lang, "python") != 0)
+      fatal_error("%s", "Option -prune is only supported for target python\n");
+
+   if (do_cse && strcmp(lang, "c") != 0 && strcmp(lang, "oxgst") != 0 && strcmp(lang, "python") != 0)
+      fatal_error("%s", "Option -cse is only supported for targets c, oxgst and python\n");
+
+   if (do_simplify && strcmp(lang, "c") != 0 && strcmp(lang, "oxgst") != 0 && strcmp(lang, "python") != 0)
+      fatal_error("%s", "Option -simplify is only supported for targets c, oxgst and python\n");
+
+   if (do_reduce && strcmp(lang, "c") != 0 && strcmp(lang, "oxgst") != 0 && strcmp(lang, "python") != 0)
+      fatal_error("%s", "Option -reduce is only supported for targets c, oxgst and python\n");
+
+   if (do_hoist && strcmp(lang, "c") != 0 && strcmp(lang, "python") != 0)
+      fatal_error("%s", "Option -hoist is only supported for targets c and python\n");
+
    //
    //  assemble file names
    //
@@ -249,13 +431,13 @@ int main(int argc, char *argv[])
    //  open the output files; input file will be opened by read_file
    //
 
-   code = fopen(codefile, "w");
+   code = outfile_open(codefile);
    if (code == 0)
       fatal_error("Could not open output code file %s\n", codefile);
 
    if (mergeonly == 0) 
    {
-      info = fopen(listfile, "w");
+      info = outfile_open(listfile);
       if (info == 0)
          fatal_error("Could not open output list file %s\n", listfile);
       fprintf(info, "Run Specifications:\n");
@@ -270,9 +452,13 @@ int main(int argc, char *argv[])
    if (DBG)
       xcheck("init");
 
+   marktime(0);
+   xphase("parse");
+
    read_source(sourcefile);
    if (DBG)
       xcheck("after read");
+   marktime("read_source");
 
    //
    //  exit if merge_only is on
@@ -280,6 +466,7 @@ int main(int argc, char *argv[])
 
    if (mergeonly)
    {
+      outfile_close(code);
       printf("Merged code written to %s\n", codefile);
       exit(0);
    }
@@ -296,6 +483,7 @@ int main(int argc, char *argv[])
    //  identifier context information for each equation
    //
 
+   xphase("analysis");
    build_context();
 
    //
@@ -305,6 +493,7 @@ int main(int argc, char *argv[])
    build_set_relationships();
    if (DBG)
       xcheck("after build sets");
+   marktime("build_set_relationships");
 
    //
    //  check to make sure that no variables or parameters are
@@ -321,6 +510,7 @@ int main(int argc, char *argv[])
    listelements();
    if (DBG)
       xcheck("after listing");
+   marktime("listing");
 
    //
    //  prepare the equations
@@ -329,11 +519,33 @@ int main(int argc, char *argv[])
    check_equations();
    if (DBG)
       xcheck("after check_equations");
+   marktime("check_equations");
+
+   //
+   //  drop whatever the -prune targets don't depend on
+   //
+
+   if (do_prune && error_count() == 0)
+   {
+      prune_model(prune_targets);
+      marktime("prune");
+   }
+
+   //
+   //  find the block structure of the equations
+   //
+
+   if (do_blocks && error_count() == 0)
+   {
+      depgraph_write(basename);
+      marktime("depgraph");
+   }
 
    //
    //  write the code file
    //
 
+   xphase("write");
    if (error_count() == 0 || DBG)
       codegen_write_file(basename);
    else
@@ -341,11 +553,15 @@ int main(int argc, char *argv[])
 
    if (DBG)
       xcheck("after write_file");
+   marktime("write_file");
 
    //
    //  all done
    //
 
+   if (do_stats)
+      showstats();
+
    if (DBG)
    {
       long mem;
@@ -357,6 +573,73 @@ int main(int argc, char *argv[])
    exit(0);
 }
 
+//
+//  marktime()
+//
+//  Record the processor time used since the previous mark under
+//  the given phase name.  A null name just sets the mark.
+//
+
+#define MAXPHASE 16
+
+static char   *phase_name[MAXPHASE];
+static double  phase_secs[MAXPHASE];
+static int     nphase = 0;
+static clock_t phase_mark;
+
+static void marktime(char *name)
+{
+   clock_t now;
+
+   now = clock();
+   if (name && nphase < MAXPHASE)
+   {
+      phase_name[nphase] = name;
+      phase_secs[nphase] = (double)(now - phase_mark) / CLOCKS_PER_SEC;
+      nphase++;
+   }
+   phase_mark = now;
+}
+
+//
+//  showstats()
+//
+//  Print internal counters requested by the -stats option.
+//
+
+static void showstats()
+{
+   int i;
+
+   printf("\nSym statistics:\n\n");
+   printf("Processor time:\n");
+   for (i = 0; i < nphase; i++)
+      printf("   %-24s %8.3f s\n", phase_name[i], phase_secs[i]);
+   symtable_stats();
+   set_stats();
+   intern_stats();
+   xphase_report();
+}
+
+//
+//  islang()
+//
+//  Return 1 if a language was given as an option.  Unlike isoption,
+//  the name has to match exactly so that the c target isn't picked
+//  by options that start with a c, like -calc.
+//
+
+static int islang(char *name)
+{
+   char *opt, *option();
+   int i;
+
+   for (i = 0; (opt = option(i)); i++)
+      if (strcasecmp(opt, name) == 0)
+         return 1;
+   return 0;
+}
+
 //
 //  builtby()
 //
@@ -37,7 +37,19 @@ extern int mergeonly;
 extern int only_first;
 extern int only_last;
 extern int do_scalars;
+extern int do_numpy;
+extern int do_jacobian;
 extern int do_calc;
+extern int do_stats;
+extern int do_atomic;
+extern int do_cse;
+extern int do_simplify;
+extern int do_reduce;
+extern int do_hoist;
+extern int do_linear;
+extern int do_blocks;
+extern int do_prune;
+extern int jobs;
 
 #define DBG ((debug && myDEBUG)||debugforce)
 
@@ -7,7 +7,9 @@
 
 #include "symtable.h"
 
+#include "dict.h"
 #include "error.h"
+#include "intern.h"
 #include "nodes.h"
 #include "options.h"
 #include "sets.h"
@@ -28,10 +30,37 @@
 
 #define NOSIZE -1
 
+//
+//  Expected number of symbols; the hash index grows as needed.
+//
+
+#define ST_HASHSIZE 1024
+
+//
+//  Symbols are kept in a linked list that is sorted alphabetically
+//  for firstsymbol() and nextsymbol(), plus a case-insensitive hash
+//  index used by lookup().  New symbols are appended to the end of 
+//  the list and the list is only resorted when it is next walked,
+//  so both insertion and lookup are constant-time on average.
+//
+//  Symbols dropped by -prune stay in the list and the index, but
+//  firstsymbol() and nextsymbol() pass over them.  firstdeclared()
+//  and nextdeclared() walk every symbol, dropped or not, and are
+//  only for code that needs the model as declared: the list of
+//  pruned symbols and the python target's original vector layout.
+//  Callers must test isdropped() themselves.
+//
+
 Symbol st_head;
 int st_init=0;
 int n_symtab=0;
 
+static void   *st_index=0;
+static Symbol *st_tail=0;
+static int     st_sorted=1;
+static long    st_lookups=0;
+static long    st_found=0;
+
 
 /*-------------------------------------------------------------------*
  *  initsymbol
@@ -44,6 +73,78 @@ static void initsymbol()
    st_head.next = 0;
    st_init      = 1;
    n_symtab     = 0;
+   st_index     = newdict(ST_HASHSIZE);
+   st_tail      = &st_head;
+   st_sorted    = 1;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  sortsymbols
+ *
+ *  Restore alphabetical order to the symbol list after symbols 
+ *  have been appended.  Uses a bottom-up merge sort on the linked 
+ *  list, which is stable and needs no extra storage.
+ *-------------------------------------------------------------------*/
+static void sortsymbols()
+{
+   Symbol *list,*p,*q,*e,*tail=0;
+   int insize,nmerges,psize,qsize,i;
+
+   if( st_sorted )
+      return;
+
+   list = st_head.next;
+   insize = 1;
+
+   while( list )
+      {
+      p = list;
+      list = 0;
+      tail = 0;
+      nmerges = 0;
+
+      while( p )
+         {
+         nmerges++;
+         q = p;
+         psize = 0;
+         for( i=0 ; i<insize && q ; i++ )
+            {
+            psize++;
+            q = q->next;
+            }
+         qsize = insize;
+
+         while( psize > 0 || (qsize > 0 && q) )
+            {
+            if( psize == 0 )
+               { e = q; q = q->next; qsize--; }
+            else if( qsize == 0 || q == 0 )
+               { e = p; p = p->next; psize--; }
+            else if( strcasecmp(p->str,q->str) <= 0 )
+               { e = p; p = p->next; psize--; }
+            else
+               { e = q; q = q->next; qsize--; }
+
+            if( tail )
+               tail->next = e;
+            else
+               list = e;
+            tail = e;
+            }
+         p = q;
+         }
+
+      tail->next = 0;
+      if( nmerges <= 1 )
+         break;
+      insize *= 2;
+      }
+
+   st_head.next = list;
+   st_tail = tail ? tail : &st_head;
+   st_sorted = 1;
 }
 
 
@@ -54,8 +155,7 @@ static void initsymbol()
  *-------------------------------------------------------------------*/
 static Symbol *newsymbol( char *name, Symboltype type)
 {
-   int check;
-   Symbol *new,*cur,*pre;
+   Symbol *new;
 
    if( name==0 )
       FAULT("Null string passed to newsymbol" );
@@ -66,39 +166,38 @@ static Symbol *newsymbol( char *name, Symboltype type)
    if( DBG )
       printf("defining new symbol %s\n",name);
 
-   for( pre = &st_head ; pre ; pre=cur )
-      {
-      cur = pre->next;
-      check = (cur) ? strcasecmp(name,cur->str) : -1 ;
-
-      if( check > 0 )
-         continue;
-
-      if( check == 0 )
-         fatal_error("Multiple definitions of '%s'",name);
-
-      new = (Symbol *) xmalloc( sizeof(Symbol) );
-      new->obj   = SYMBOBJ;
-      new->str   = strdup(name);
-      new->next  = cur;
-      pre->next  = new;
-      new->type  = type;
-      new->desc  = strdup("");
-      new->value = newsequence();
-      new->attr  = newsequence();
-      new->size  = NOSIZE;
-      new->used  = 0;
-      new->leqns = newlist();
-      new->reqns = newlist();
-
-      n_symtab++;
-
-      if( DBG )printf("   ok\n");
-      return new;
-      }
+   if( getdict(st_index,name) )
+      fatal_error("Multiple definitions of '%s'",name);
+
+   new = (Symbol *) xmalloc( sizeof(Symbol) );
+   new->obj   = SYMBOBJ;
+   new->str   = intern(name);
+   new->next  = 0;
+   new->type  = type;
+   new->desc  = strdup("");
+   new->value = newsequence();
+   new->attr  = newsequence();
+   new->size  = NOSIZE;
+   new->used  = 0;
+   new->dropped = 0;
+   new->leqns = newlist();
+   new->reqns = newlist();
 
-      FAULT("Invalid state reached in do_newsymbol");
-      return 0;
+   //
+   //  append it and note whether the list is still in order
+   //
+
+   if( st_tail != &st_head && strcasecmp(name,st_tail->str) < 0 )
+      st_sorted = 0;
+
+   st_tail->next = new;
+   st_tail = new;
+   putdict(st_index,new->str,new);
+
+   n_symtab++;
+
+   if( DBG )printf("   ok\n");
+   return new;
 }
 
 
@@ -126,25 +225,30 @@ void *lookup(char *name)
    if( name==0 )
       FAULT("Null string passed to lookup");
 
-   for( cur = st_head.next ; cur ; cur=cur->next )
-      if( cur->str && isequal(name,cur->str) )
-         return (void*) cur;
+   st_lookups++;
+   cur = (Symbol *) getdict(st_index,name);
+   if( cur )
+      st_found++;
 
-   return 0 ;
+   return (void*) cur;
 }
 
 
 /*-------------------------------------------------------------------*
- *  firstsymbol
+ *  firstdeclared
  *
- *  Find and return the first symbol of a given type.
+ *  Find and return the first symbol of a given type, whether or
+ *  not it has been dropped.  Use firstsymbol() unless dropped
+ *  symbols are wanted.
  *-------------------------------------------------------------------*/
-void *firstsymbol(Symboltype type)
+void *firstdeclared(Symboltype type)
 {
    Symbol *cur;
 
    if( !st_init )
-      FAULT("Symbol table not built before firstsymbol");
+      FAULT("Symbol table not built before firstdeclared");
+
+   sortsymbols();
 
    for( cur=st_head.next ; cur ; cur=cur->next )
       if( type==cur->type )return cur ;
@@ -154,19 +258,20 @@ void *firstsymbol(Symboltype type)
 
 
 /*-------------------------------------------------------------------*
- *  nextsymbol
+ *  nextdeclared
  *
- *  Find and return the next symbol of the same type as the argument
+ *  Find and return the next symbol of the same type as the
+ *  argument, whether or not it has been dropped.
  *-------------------------------------------------------------------*/
-void *nextsymbol(void *cur)
+void *nextdeclared(void *cur)
 {
    Symboltype type;
    Symbol *sym;
 
    if( !st_init )
-      FAULT("Symbol table not built before nextsymbol");
+      FAULT("Symbol table not built before nextdeclared");
 
-   validate( cur, SYMBOBJ, "nextsymbol" );
+   validate( cur, SYMBOBJ, "nextdeclared" );
 
    sym = (Symbol *) cur;
    type = sym->type;
@@ -178,6 +283,48 @@ void *nextsymbol(void *cur)
 }
 
 
+/*-------------------------------------------------------------------*
+ *  firstsymbol
+ *
+ *  Find and return the first symbol of a given type.
+ *-------------------------------------------------------------------*/
+void *firstsymbol(Symboltype type)
+{
+   Symbol *cur;
+
+   if( !st_init )
+      FAULT("Symbol table not built before firstsymbol");
+
+   cur = (Symbol *) firstdeclared(type);
+   while( cur && cur->dropped )
+      cur = (Symbol *) nextdeclared(cur);
+
+   return cur;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  nextsymbol
+ *
+ *  Find and return the next symbol of the same type as the argument
+ *-------------------------------------------------------------------*/
+void *nextsymbol(void *cur)
+{
+   Symbol *sym;
+
+   if( !st_init )
+      FAULT("Symbol table not built before nextsymbol");
+
+   validate( cur, SYMBOBJ, "nextsymbol" );
+
+   sym = (Symbol *) nextdeclared(cur);
+   while( sym && sym->dropped )
+      sym = (Symbol *) nextdeclared(sym);
+
+   return sym;
+}
+
+
 /*-------------------------------------------------------------------*
  *  istype()
  *
@@ -398,6 +545,8 @@ void check_identifiers()
    Item *a,*b;
    int ok;
    
+   sortsymbols();
+
    for( cur = st_head.next ; cur ; cur=cur->next )
       {
       if( cur->type != par && cur->type != var )continue;
@@ -439,6 +588,32 @@ void setused(void *sym, int eq_num, int is_lhs )
 }
 
 
+/*-------------------------------------------------------------------*
+ *  dropsymbol
+ *
+ *  Drop a symbol from the model: it stays in the table but will no
+ *  longer be returned by firstsymbol() and nextsymbol().
+ *-------------------------------------------------------------------*/
+void dropsymbol(void *sym)
+{
+   validate( sym, SYMBOBJ, "dropsymbol" ); 
+   ((Symbol *)sym)->dropped = 1;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  isdropped
+ *
+ *  Check whether a symbol has been dropped from the model.
+ *-------------------------------------------------------------------*/
+int isdropped(void *sym)
+{
+   if( sym==0 )return 0;
+   validate( sym, SYMBOBJ, "isdropped" ); 
+   return ((Symbol *)sym)->dropped ;
+}
+
+
 /*-------------------------------------------------------------------*
  *  isused
  *
@@ -532,3 +707,20 @@ int isrhs(void *sym)
 
 
 
+
+
+/*-------------------------------------------------------------------*
+ *  symtable_stats
+ *
+ *  Print counters describing use of the symbol table.  Used by the
+ *  -stats option to measure the cost of symbol lookups.
+ *-------------------------------------------------------------------*/
+void symtable_stats()
+{
+   printf("Symbol table:\n");
+   printf("   Symbols:          %d\n",n_symtab);
+   printf("   Lookups:          %ld\n",st_lookups);
+   printf("   Lookups found:    %ld\n",st_found);
+   if( st_index )
+      dictinfo(st_index);
+}
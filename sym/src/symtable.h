@@ -23,6 +23,7 @@ struct symbol
    List *attr;
    int size;
    int used;
+   int dropped;
    List *leqns;
    List *reqns;
    struct symbol *next;
@@ -46,14 +47,19 @@ int   isattrib(void*,char*);
 int   isident(void*);
 int   islhs(void*);
 int   isrhs(void*);
+int   isdropped(void*);
 int   istype(void*,Symboltype);
 int   isused(void*);
 int   symsize(void*);
 void  check_identifiers();
+void  dropsymbol(void*);
 void  symdeclare(Symboltype, char*, List*, char*, List *);
+void  symtable_stats(void);
 void  validatetype(void*,Symboltype,char*);
+void* firstdeclared(Symboltype);
 void* firstsymbol(Symboltype);
 void* lookup(char *);
+void* nextdeclared(void*);
 void* nextsymbol(void*);
 
 #endif /* SYMTABLE_H */
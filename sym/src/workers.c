@@ -0,0 +1,166 @@
+/*-------------------------------------------------------------------*
+ *  workers.c
+ *
+ *  Run a batch of independent jobs at the same time and collect
+ *  what they write in job order, exactly as if they had been run
+ *  one after another.
+ *
+ *  Most of the program keeps its state in static variables, so the
+ *  jobs are run in child processes rather than threads: each child
+ *  starts with its own copy of everything built so far and nothing
+ *  it does can disturb the others.  A job may only write to the
+ *  streams it is handed.  Each of those is a temporary file, and
+ *  once every job has finished the files are appended to the real
+ *  output streams, job 0 first.  Any other changes a job makes are
+ *  lost when its process exits, so the caller must work out in
+ *  advance the state each job starts from and the state that the
+ *  last one would have left behind.
+ *
+ *  Where fork() isn't available, or only one job is requested, the
+ *  jobs simply run in order in this process and write directly to
+ *  the output streams.
+ *-------------------------------------------------------------------*/
+
+#include "workers.h"
+
+#include "error.h"
+#include "xmalloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_FORK
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+//
+//  Exit status of a job that ran to completion.  It can't be zero
+//  because fatal_error exits with status zero.
+//
+
+#define WORKER_DONE 42
+
+//
+//  Private methods
+//
+
+/*-------------------------------------------------------------------*
+ *  append
+ *
+ *  Copy a temporary file onto the end of an output stream.
+ *-------------------------------------------------------------------*/
+static void append( FILE *out, FILE *tmp )
+{
+   char buf[8192];
+   size_t n;
+
+   rewind( tmp );
+   while( (n=fread(buf,1,sizeof(buf),tmp)) > 0 )
+      if( fwrite(buf,1,n,out) != n )
+         fatal_error("%s","could not write output in workers_run()");
+
+   if( ferror(tmp) )
+      fatal_error("%s","could not read temporary file in workers_run()");
+}
+
+
+//
+//  Public methods
+//
+
+/*-------------------------------------------------------------------*
+ *  workers_limit
+ *
+ *  Return the number of jobs worth running at once.
+ *-------------------------------------------------------------------*/
+int workers_limit( void )
+{
+#if defined(HAVE_FORK) && defined(_SC_NPROCESSORS_ONLN)
+   long n;
+
+   n = sysconf( _SC_NPROCESSORS_ONLN );
+   return n > 1 ? (int) n : 1 ;
+#else
+   return 1;
+#endif
+}
+
+
+/*-------------------------------------------------------------------*
+ *  workers_run
+ *
+ *  Run fn for jobs 0 to njobs-1.  Each job gets its own set of
+ *  nstreams streams, and when all are done everything written to
+ *  stream s is appended to out[s] in job order.
+ *-------------------------------------------------------------------*/
+void workers_run( int njobs, Workerjob fn, void *arg, FILE **out, int nstreams )
+{
+   int j;
+#ifdef HAVE_FORK
+   FILE **tmp;
+   pid_t *pid;
+   int s,status,failed;
+
+   if( njobs > 1 )
+      {
+      tmp = (FILE **) xmalloc( njobs*nstreams*sizeof(FILE *) );
+      pid = (pid_t *) xmalloc( njobs*sizeof(pid_t) );
+
+      for( j=0 ; j < njobs*nstreams ; j++ )
+         if( (tmp[j]=tmpfile()) == 0 )
+            fatal_error("%s","could not create temporary file in workers_run()");
+
+      //
+      //  anything still buffered would otherwise be written again
+      //  by every child
+      //
+
+      fflush( NULL );
+
+      for( j=0 ; j < njobs ; j++ )
+         {
+         pid[j] = fork();
+         if( pid[j] < 0 )
+            fatal_error("%s","could not start worker process in workers_run()");
+
+         if( pid[j] == 0 )
+            {
+            fn( j, &tmp[j*nstreams], arg );
+            for( s=0 ; s < nstreams ; s++ )
+               if( fflush(tmp[j*nstreams+s]) || ferror(tmp[j*nstreams+s]) )
+                  fatal_error("%s","could not write temporary file in workers_run()");
+            fflush( NULL );
+            _exit( WORKER_DONE );
+            }
+         }
+
+      failed = 0;
+      for( j=0 ; j < njobs ; j++ )
+         {
+         if( waitpid(pid[j],&status,0) != pid[j] )
+            failed++;
+         else if( !WIFEXITED(status) || WEXITSTATUS(status) != WORKER_DONE )
+            failed++;
+         }
+
+      if( failed )
+         fatal_error("%s","a worker process did not finish in workers_run()");
+
+      for( s=0 ; s < nstreams ; s++ )
+         for( j=0 ; j < njobs ; j++ )
+            {
+            append( out[s], tmp[j*nstreams+s] );
+            fclose( tmp[j*nstreams+s] );
+            }
+
+      xfree( pid );
+      xfree( tmp );
+      return;
+      }
+#endif
+
+   for( j=0 ; j < njobs ; j++ )
+      fn( j, out, arg );
+}
@@ -0,0 +1,24 @@
+/* workers.h
+ *
+ * Header file for running independent jobs in worker processes.
+ */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stdio.h>
+
+//
+//  A job is handed its number and the streams it should write to
+//
+
+typedef void (*Workerjob)(int job, FILE **streams, void *arg);
+
+//
+//  Function prototypes
+//
+
+int  workers_limit(void);
+void workers_run(int njobs, Workerjob fn, void *arg, FILE **out, int nstreams);
+
+#endif /* WORKERS_H */
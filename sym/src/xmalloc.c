@@ -3,6 +3,12 @@
  *  9 Apr 90 (PJW)
  *
  *  Careful memory allocation routine to try to control leaks
+ *
+ *  Also provides arenas for short-lived allocations.  Memory taken
+ *  from an arena is never freed individually: the whole arena is
+ *  reset at once when the work it supports is finished, and its
+ *  chunks are kept for reuse.  Allocation statistics are kept for
+ *  each phase of the run as named by xphase().
  *-------------------------------------------------------------------*/
 
 #include "xmalloc.h"
@@ -13,15 +19,65 @@
 
 static long x_alloc=0;
 static long x_check=0;
+static long x_bytes=0;
+static long x_bcheck=0;
 
 void fatal_error(char*,char*);
 
+//
+//  Arenas are lists of chunks; 'cur' is the chunk being filled.
+//  Each new chunk is as big as all the earlier ones together, so
+//  an arena never has more than a few chunks to search in xinarena.
+//
+
+#define XA_CHUNK 65536
+#define XA_ALIGN 8
+#define XA_MAX   1
+
+typedef struct chunk {
+   struct chunk *next;
+   char *base;
+   int size;
+   int used;
+   } Chunk;
+
+typedef struct {
+   char *name;
+   Chunk *first;
+   Chunk *cur;
+   long size;        // total size of all chunks
+   long used;        // bytes handed out since the last reset
+   long high;        // high-water mark for the current phase
+   } Arena;
+
+static Arena arenas[XA_MAX] = {
+   { "equation", 0, 0, 0, 0, 0 }
+   };
+
+//
+//  Per-phase statistics
+//
+
+#define XP_MAX 16
+
+typedef struct {
+   char *name;
+   long allocs;
+   long bytes;
+   long high[XA_MAX];
+   } Phase;
+
+static Phase phases[XP_MAX];
+static int nphases=0;
+
+
 void *xmalloc(int size)
 {
    void *c;
    c = malloc( size );
    if( c==0 ) fatal_error("%s","insufficient memory in xmalloc()");
    x_alloc++;
+   x_bytes += size;
    return c;
 }
 
@@ -44,10 +100,205 @@ void xfree(void *ptr)
 }
 
 
+static Arena *getarena(int which)
+{
+   if( which < 0 || which >= XA_MAX )
+      fatal_error("%s","invalid arena passed to xarena()");
+   return &arenas[which];
+}
+
+
+/*-------------------------------------------------------------------*
+ *  xarena
+ *
+ *  Allocate memory from an arena.
+ *-------------------------------------------------------------------*/
+void *xarena(int which, int size)
+{
+   Arena *a;
+   Chunk *c,*new;
+   void *p;
+
+   a = getarena(which);
+   size = (size + XA_ALIGN-1) & ~(XA_ALIGN-1);
+
+   //
+   //  move along to a chunk with enough room, adding one at the
+   //  end of the list if none of the remaining chunks will do
+   //
+
+   c = a->cur;
+   while( c && c->used + size > c->size )
+      c = c->next;
+
+   if( c == 0 )
+      {
+      new = (Chunk *) malloc( sizeof(Chunk) );
+      if( new==0 ) fatal_error("%s","insufficient memory in xarena()");
+      new->size = a->size > XA_CHUNK ? a->size : XA_CHUNK ;
+      if( new->size < size )new->size = size;
+      new->base = (char *) malloc( new->size );
+      if( new->base==0 ) fatal_error("%s","insufficient memory in xarena()");
+      new->used = 0;
+      new->next = 0;
+      a->size += new->size;
+      if( a->first == 0 )
+         a->first = new;
+      else
+         {
+         for( c=a->cur ? a->cur : a->first ; c->next ; c=c->next );
+         c->next = new;
+         }
+      c = new;
+      }
+
+   a->cur = c;
+   p = c->base + c->used;
+   c->used += size;
+
+   a->used += size;
+   if( a->used > a->high )a->high = a->used;
+
+   return p;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  xarena_reset
+ *
+ *  Release everything allocated from an arena.
+ *-------------------------------------------------------------------*/
+void xarena_reset(int which)
+{
+   Arena *a;
+   Chunk *c;
+
+   a = getarena(which);
+   for( c=a->first ; c ; c=c->next )
+      c->used = 0;
+
+   a->cur  = a->first;
+   a->used = 0;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  xinarena
+ *
+ *  Return 1 if a pointer was allocated from any arena.
+ *-------------------------------------------------------------------*/
+int xinarena(void *ptr)
+{
+   Chunk *c;
+   char *p;
+   int i;
+
+   p = (char *) ptr;
+   for( i=0 ; i < XA_MAX ; i++ )
+      for( c=arenas[i].first ; c ; c=c->next )
+         if( p >= c->base && p < c->base + c->size )return 1;
+
+   return 0;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  xrelease
+ *
+ *  Free a string obtained from malloc, strdup or concat, but leave
+ *  it alone if it came from an arena.  Lets code that builds strings
+ *  in an arena also handle strings produced elsewhere.
+ *-------------------------------------------------------------------*/
+void xrelease(void *ptr)
+{
+   if( ptr==0 ) fatal_error("%s","null pointer passed to xrelease()");
+   if( xinarena(ptr) )return;
+   free( ptr );
+}
+
+
+/*-------------------------------------------------------------------*
+ *  xphase
+ *
+ *  Close the statistics for the current phase and start a new one.
+ *-------------------------------------------------------------------*/
+static long p_alloc=0;
+static long p_bytes=0;
+
+static void close_phase(void)
+{
+   Phase *p;
+   int i;
+
+   if( nphases == 0 )return;
+
+   p = &phases[nphases-1];
+   p->allocs = x_alloc - p_alloc;
+   p->bytes  = x_bytes - p_bytes;
+   for( i=0 ; i < XA_MAX ; i++ )
+      {
+      p->high[i] = arenas[i].high;
+      arenas[i].high = arenas[i].used;
+      }
+}
+
+void xphase(char *name)
+{
+   close_phase();
+
+   if( nphases == XP_MAX )
+      fatal_error("%s","too many phases in xphase()");
+
+   phases[nphases++].name = name;
+   p_alloc = x_alloc;
+   p_bytes = x_bytes;
+}
+
+
+/*-------------------------------------------------------------------*
+ *  xphase_report
+ *
+ *  Print the allocation statistics for each phase so far.
+ *-------------------------------------------------------------------*/
+void xphase_report(void)
+{
+   Phase *p;
+   int i;
+
+   close_phase();
+
+   printf("\nMemory by phase:\n");
+   printf("   %-16s %10s %12s","phase","net allocs","bytes");
+   for( i=0 ; i < XA_MAX ; i++ )
+      printf(" %12s",arenas[i].name);
+   printf("\n");
+   for( p=phases ; p < phases+nphases ; p++ )
+      {
+      printf("   %-16s %10ld %12ld",p->name,p->allocs,p->bytes);
+      for( i=0 ; i < XA_MAX ; i++ )
+         printf(" %12ld",p->high[i]);
+      printf("\n");
+      }
+   printf("   (allocs and bytes are for xmalloc; arena columns give\n");
+   printf("   the most memory in use in each arena at one time)\n");
+}
+
+
 void xcheck(char *where)
 {
-   printf("xcheck at %s: %ld\n",where,x_alloc-x_check);
-   x_check = x_alloc;
+   long high;
+   int i;
+
+   printf("xcheck at %s: %ld allocations, %ld bytes",
+      where,x_alloc-x_check,x_bytes-x_bcheck);
+   for( i=0 ; i < XA_MAX ; i++ )
+      {
+      high = arenas[i].high;
+      if( high )printf(", %s arena %ld",arenas[i].name,high);
+      }
+   printf("\n");
+   x_check  = x_alloc;
+   x_bcheck = x_bytes;
 }
 
 
@@ -63,4 +314,3 @@ void xleak(long mark, char *where)
    printf("Memory leak detected in %s, allocation change was %ld\n",where,x_alloc-mark);
    exit(0);
 }
-
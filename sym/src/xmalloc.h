@@ -7,6 +7,13 @@
 #ifndef XMALLOC_H
 #define XMALLOC_H
 
+//
+//  Arenas for short-lived memory: at present only the strings built
+//  while writing a single scalar equation.
+//
+
+#define XA_EQUATION 0
+
 char* xstrdup(char*);
 long  xmark();
 void  xcheck(char*);
@@ -14,4 +21,11 @@ void  xfree(void*);
 void  xleak(long,char*);
 void* xmalloc(int);
 
+void* xarena(int,int);
+void  xarena_reset(int);
+int   xinarena(void*);
+void  xrelease(void*);
+void  xphase(char*);
+void  xphase_report(void);
+
 #endif /* XMALLOC_H */